@@ -221,13 +221,15 @@ protected:
     //! \param format   the pixel format for the image
     //! \param tiling   the tiling method for the pixels (device optimal vs linear)
     //! \param usage    flags specifying the usage of the image
+    //! \param mipLevels the number of mipmap levels (default 1)
     //! \return the created image
     VkImage _createImage (
         uint32_t wid,
         uint32_t ht,
         VkFormat format,
         VkImageTiling tiling,
-        VkImageUsageFlags usage);
+        VkImageUsageFlags usage,
+        uint32_t mipLevels = 1);
 
     //! \brief A helper function for allocating and binding device memory for an image
     //! \param img    the image to allocate memory for
@@ -236,8 +238,13 @@ protected:
     VkDeviceMemory _allocImageMemory (VkImage img, VkMemoryPropertyFlags props);
 
     //! \brief A helper function for creating a Vulkan image view object for an image
+    //! \param image       the image
+    //! \param format      the pixel format of the image
+    //! \param aspectFlags the aspects of the image that are included in the view
+    //! \param mipLevels   the number of mipmap levels in the image (default 1)
     VkImageView _createImageView (
-        VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
+        VkImage image, VkFormat format, VkImageAspectFlags aspectFlags,
+        uint32_t mipLevels = 1);
 
     //! \brief A helper function for changing the layout of an image
     void _transitionImageLayout (
@@ -0,0 +1,107 @@
+/*! \file cs237-arena.hpp
+ *
+ * Support code for CMSC 23700 Autumn 2022.
+ *
+ * This file defines a simple arena (or bump) allocator.  Objects are allocated
+ * from large blocks of memory and the memory is released all at once when the
+ * arena is destroyed.
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#ifndef _CS237_ARENA_HPP_
+#define _CS237_ARENA_HPP_
+
+#ifndef _CS237_HPP_
+#  error "cs237-arena.hpp should not be included directly"
+#endif
+
+namespace cs237 {
+
+//! An Arena allocates memory by bumping a pointer in its current block.  When
+//! the block is exhausted, a new block is allocated.  The memory returned by
+//! an arena is uninitialized, destructors are not run, and all of the memory is
+//! freed when the arena is destroyed, so arenas should only be used for objects
+//! that do not own other resources.  Arenas are not thread safe.
+class Arena {
+  public:
+
+    //! the default alignment of allocations
+    static const size_t kDefaultAlign = 16;
+
+    //! \brief create an arena
+    //! \param blockSz the size of the arena's first block; if the total size of
+    //!        the allocations is known in advance, then using it here means
+    //!        that all of the allocations will be in one contiguous block.
+    //!        Later blocks are at least this size.
+    explicit Arena (size_t blockSz = 64*1024);
+
+    ~Arena ();
+
+    Arena (Arena const &) = delete;
+    Arena &operator= (Arena const &) = delete;
+
+    //! \brief allocate memory from the arena
+    //! \param nBytes the number of bytes to allocate
+    //! \param align  the required alignment; must be a power of two
+    //! \return a pointer to the uninitialized memory
+    void *alloc (size_t nBytes, size_t align = kDefaultAlign)
+    {
+        uintptr_t p = (reinterpret_cast<uintptr_t>(this->_next) + (align - 1)) & ~(align - 1);
+        if ((this->_next == nullptr) || (p + nBytes > reinterpret_cast<uintptr_t>(this->_limit))) {
+            return this->_allocSlow (nBytes, align);
+        }
+        this->_next = reinterpret_cast<char *>(p + nBytes);
+        return reinterpret_cast<void *>(p);
+    }
+
+    //! \brief allocate an uninitialized array from the arena
+    //! \tparam T     the element type, which should be trivially destructible
+    //! \param n      the number of elements
+    //! \param align  the required alignment of the array
+    //! \return a pointer to the array
+    template <typename T>
+    T *alloc (size_t n, size_t align = alignof(T))
+    {
+        return static_cast<T *>(this->alloc (n * sizeof(T), align));
+    }
+
+    //! \brief release all of the allocations; the arena keeps its most recent
+    //!        block for reuse
+    void reset ();
+
+    //! the total size of the blocks owned by the arena
+    size_t size () const;
+
+    //! the number of blocks owned by the arena
+    size_t numBlocks () const;
+
+  private:
+    //! header for a block of memory
+    struct alignas(kDefaultAlign) Block {
+        Block *next;                    //!< the next (i.e., older) block
+        size_t size;                    //!< the size of the block's data
+        char *data () { return reinterpret_cast<char *>(this + 1); }
+    };
+
+    Block *_blocks;                     //!< the list of blocks (most recent first)
+    char *_next;                        //!< the next free byte in the current block
+    char *_limit;                       //!< the end of the current block
+    size_t _blockSz;                    //!< the minimum size of new blocks
+
+    //! allocate a new block and then allocate from it
+    void *_allocSlow (size_t nBytes, size_t align);
+
+    //! allocate a new block that has at least sz bytes
+    void _newBlock (size_t sz);
+
+};
+
+} // namespace cs237
+
+#endif // !_CS237_ARENA_HPP_
@@ -87,14 +87,52 @@ public:
 class IndexBuffer : public Buffer {
 public:
 
+    //! create an index buffer; the index type is inferred from the size
+    //! \param app      the owning application
+    //! \param nIndices the number of indices in the buffer
+    //! \param sz       the size of the buffer in bytes, which should be either
+    //!                 `2*nIndices` (16-bit indices) or `4*nIndices` (32-bit indices)
     IndexBuffer (Application *app, uint32_t nIndices, size_t sz)
-      : Buffer (app, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, sz), _nIndices(nIndices)
+      : Buffer (app, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, sz), _nIndices(nIndices),
+        _type((sz == nIndices * sizeof(uint16_t)) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32)
     { }
 
+    //! create an index buffer for the given type of indices
+    //! \param app      the owning application
+    //! \param ty       the index type (`VK_INDEX_TYPE_UINT16` or `VK_INDEX_TYPE_UINT32`)
+    //! \param nIndices the number of indices in the buffer
+    IndexBuffer (Application *app, VkIndexType ty, uint32_t nIndices)
+      : Buffer (app, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, nIndices * indexSize(ty)),
+        _nIndices(nIndices), _type(ty)
+    { }
+
+    //! the number of indices in the buffer
     uint32_t nIndices () const { return this->_nIndices; }
 
+    //! the type of the indices, which should be passed to `vkCmdBindIndexBuffer`
+    VkIndexType indexType () const { return this->_type; }
+
+    //! the size in bytes of an index
+    size_t indexSize () const { return indexSize(this->_type); }
+
+    //! the size in bytes of an index of the given type
+    static size_t indexSize (VkIndexType ty)
+    {
+        return (ty == VK_INDEX_TYPE_UINT16) ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+
+    //! \brief return the smallest index type that can be used for a mesh
+    //! \param nVerts the number of vertices in the mesh
+    //! \return `VK_INDEX_TYPE_UINT16` if `nVerts < 65536` and `VK_INDEX_TYPE_UINT32`
+    //!         otherwise
+    static VkIndexType indexTypeFor (uint32_t nVerts)
+    {
+        return (nVerts < 65536) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    }
+
 private:
     uint32_t _nIndices;
+    VkIndexType _type;
 
 };
 
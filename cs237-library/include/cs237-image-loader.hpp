@@ -0,0 +1,75 @@
+/*! \file cs237-image-loader.hpp
+ *
+ * Support code for CMSC 23700 Autumn 2022.
+ *
+ * Asynchronous loading of images from PNG files.
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#ifndef _CS237_IMAGE_LOADER_HPP_
+#define _CS237_IMAGE_LOADER_HPP_
+
+#ifndef _CS237_HPP_
+#error "cs237-image-loader.hpp should not be included directly"
+#endif
+
+#include <map>
+
+namespace cs237 {
+
+//! An ImageLoader decodes 2D images on the worker threads of a thread pool, so
+//! that several images can be decoded in parallel (and in parallel with other
+//! work, such as loading models).  Requests are keyed by the file path; asking
+//! for the same file a second time returns the result of the first request.
+//!
+//! The loader does not own the images that it loads; the caller is responsible
+//! for deleting them (once per file, since requests are shared).
+class ImageLoader {
+public:
+
+    //! \brief create an image loader
+    //! \param pool the thread pool that is used to decode images
+    explicit ImageLoader (ThreadPool &pool = ThreadPool::shared());
+
+    ImageLoader (ImageLoader const &) = delete;
+    ImageLoader &operator= (ImageLoader const &) = delete;
+
+    //! \brief start loading a 2D image from a PNG file
+    //! \param file the name of the PNG file
+    //! \param data true if the image holds data (e.g., a normal map), in which
+    //!        case it is loaded as a `DataImage2D`
+    //! \param flip set to true if the image should be flipped vertically to match
+    //!        OpenGL texture coordinates
+    //! \return a future for the image
+    //!
+    //! If the file has already been requested, then the earlier request is
+    //! returned (and the `data` and `flip` arguments are ignored).
+    std::shared_future<Image2D *> load (std::string const &file, bool data = false, bool flip = true);
+
+    //! \brief wait for an image to finish loading
+    //! \param file the name of the PNG file, which must have been passed to `load`
+    //! \return the image
+    Image2D *get (std::string const &file);
+
+    //! wait for all of the requested images to finish loading
+    void wait ();
+
+    //! the number of distinct files that have been requested
+    size_t numRequests () const;
+
+private:
+    ThreadPool &_pool;                                          //!< the pool that runs the decoders
+    mutable std::mutex _mu;                                     //!< lock protecting _reqs
+    std::map<std::string, std::shared_future<Image2D *>> _reqs; //!< the requests keyed by file
+
+};
+
+} // namespace cs237
+
+#endif // !_CS237_IMAGE_LOADER_HPP_
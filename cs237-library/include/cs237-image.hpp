@@ -18,6 +18,7 @@
 #endif
 
 #include <fstream>
+#include <functional>
 
 namespace cs237 {
 
@@ -50,11 +51,64 @@ enum class ChannelTy {
 //! convert a ChannelTy value to a printable string
 std::string to_string (ChannelTy ty);
 
+class Image1D;
+class Image2D;
+Image1D *convert (Image1D const *src, Channels chans, ChannelTy ty, bool sRGB);
+Image2D *convert (Image2D const *src, Channels chans, ChannelTy ty, bool sRGB);
+
 namespace __detail {
 
     //! \brief convert an image format and channel type to a Vulkan image format
     VkFormat toVkFormat (Channels chans, ChannelTy ty, bool sRGB);
 
+    //! the layout of a decoded PNG image
+    struct PNGInfo {
+        uint32_t wid;           //!< the width of the image in pixels
+        uint32_t ht;            //!< the height of the image in pixels
+        Channels chans;         //!< the channels of the decoded pixels
+        ChannelTy type;         //!< the type of the channels
+        bool sRGB;              //!< true if the image should be interpreted as sRGB
+        size_t nBytes;          //!< the size of the decoded image in bytes
+    };
+
+    //! a function that supplies the storage for a decoded PNG image, given its
+    //! layout; it returns nullptr if the storage cannot be allocated
+    using PNGDestFn = std::function<void *(PNGInfo const &)>;
+
+    //! \brief read a PNG image from an input stream into caller-supplied storage.
+    //!        The rows are written directly into the storage, so it can be
+    //!        (for example) a mapped Vulkan staging buffer.
+    //! \param inS the input stream
+    //! \param flip true if the rows of the image should be flipped to match OpenGL coordinates
+    //! \param addAlpha true if three-channel images should be expanded to four
+    //!        channels (with an opaque alpha) as they are decoded
+    //! \param dst the function that supplies the storage for the pixels
+    //! \param info output variable for the layout of the image
+    //! \return true if successful.  If dst has been called and the result is false,
+    //!         then the caller is responsible for releasing the storage.
+    bool readPNG (
+        std::ifstream &inS, bool flip, bool addAlpha,
+        PNGDestFn const &dst, PNGInfo &info);
+
+    //! \brief convert an array of pixels from one format to another.
+    //! \param nPixels the number of pixels to convert
+    //! \param src the source pixels
+    //! \param srcChans the channels of the source pixels
+    //! \param srcTy the channel type of the source pixels
+    //! \param srcSRGB true if the color channels of the source are sRGB encoded
+    //! \param dst the destination storage, which must not overlap the source
+    //! \param dstChans the channels of the destination pixels
+    //! \param dstTy the channel type of the destination pixels
+    //! \param dstSRGB true if the color channels of the destination should be sRGB encoded
+    //!
+    //! Only the `U8`, `U16`, and `F32` channel types are supported.  Missing color
+    //! channels are set to zero and a missing alpha channel is set to opaque.  The
+    //! sRGB encoding only applies to the color channels; alpha is always linear.
+    void convertPixels (
+        size_t nPixels,
+        void const *src, Channels srcChans, ChannelTy srcTy, bool srcSRGB,
+        void *dst, Channels dstChans, ChannelTy dstTy, bool dstSRGB);
+
     class ImageBase {
     public:
         //! the number of dimensions (1, 2, or 3)
@@ -76,6 +130,9 @@ namespace __detail {
         //! the number of bytes per pixel
         size_t nBytesPerPixel () const;
 
+        //! true if the color channels of the image are sRGB encoded
+        bool isSRGB () const { return this->_sRGB; }
+
         //! add an opaque alpha channel to the imag
         //!
         //! This operation only works on images with RGB or BGR pixel format;
@@ -104,6 +161,9 @@ namespace __detail {
 
         virtual ~ImageBase ();
 
+        friend Image1D *cs237::convert (Image1D const *, Channels, ChannelTy, bool);
+        friend Image2D *cs237::convert (Image2D const *, Channels, ChannelTy, bool);
+
     };
 
 } /* namespace __detail */
@@ -195,6 +255,9 @@ class Image2D : public __detail::ImageBase {
   protected:
     uint32_t _wid;      //!< the width of the image in pixels
     uint32_t _ht;       //!< the height of the image in pixels
+
+    //! read the image from a PNG-format input stream
+    bool _read (std::ifstream &inS, bool flip);
 };
 
 //! A 2D Image used to store 2D data, such as a normal map.
@@ -233,6 +296,38 @@ class DataImage2D : public Image2D {
 
 };
 
+//! \brief convert a 1D image to a different pixel format
+//! \param src the source image
+//! \param chans the channels of the result
+//! \param ty the channel type of the result (`U8`, `U16`, or `F32`)
+//! \param sRGB true if the color channels of the result should be sRGB encoded
+//! \return a new image, which the caller is responsible for deleting
+Image1D *convert (Image1D const *src, Channels chans, ChannelTy ty, bool sRGB);
+
+//! \brief convert a 2D image to a different pixel format
+//! \param src the source image
+//! \param chans the channels of the result
+//! \param ty the channel type of the result (`U8`, `U16`, or `F32`)
+//! \param sRGB true if the color channels of the result should be sRGB encoded
+//! \return a new image, which the caller is responsible for deleting
+//!
+//! For example, `convert(img, Channels::RGBA, ChannelTy::F32, false)` produces a
+//! linear floating-point image from an 8-bit sRGB image.
+Image2D *convert (Image2D const *src, Channels chans, ChannelTy ty, bool sRGB);
+
+//! \brief compute the mipmap levels of a 2D image
+//! \param img the base image (i.e., level 0)
+//! \param normalMap if true, the RGB channels of the image hold unit vectors
+//!        (encoded as `0.5*n + 0.5`), which are renormalized after filtering
+//! \return the levels 1, 2, ... down to a 1x1 image.  The levels have the same
+//!         format as `img`; the caller is responsible for deleting them.
+//!
+//! Each level is computed from the previous one using a box filter (with a
+//! three-pixel footprint at the edge of odd-sized levels).  The filtering is
+//! done in linear space for sRGB images and the rows of each level are computed
+//! in parallel using the shared thread pool.
+std::vector<Image2D *> mipmapLevels (Image2D const *img, bool normalMap = false);
+
 } /* namespace cs237 */
 
 #endif /* !_CS237_IMAGE_HPP_ */
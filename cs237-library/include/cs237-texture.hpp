@@ -16,6 +16,14 @@
 
 namespace cs237 {
 
+//! where the mipmap levels of a texture are computed
+enum class MipmapMode {
+    Auto,           //!< on the device, unless it is a CPU implementation of Vulkan (where
+                    //!< blitting is slower than `mipmapLevels`) or it cannot blit the format
+    CPU,            //!< on the CPU (see `mipmapLevels`)
+    Device          //!< on the device whenever it can blit the format
+};
+
 namespace __detail {
 
 class TextureBase {
@@ -28,13 +36,57 @@ protected:
     VkImage _img;               //!< Vulkan image to hold the texture
     VkDeviceMemory _mem;        //!< device memory for the texture image
     VkImageView _view;          //!< image view for texture image
+    uint32_t _nLevels;          //!< the number of mipmap levels in the image
 
     TextureBase (
         Application *app,
         uint32_t wid, uint32_t ht,
         cs237::__detail::ImageBase const *img);
+    explicit TextureBase (Application *app)
+      : _app(app), _img(VK_NULL_HANDLE), _mem(VK_NULL_HANDLE), _view(VK_NULL_HANDLE),
+        _nLevels(1)
+    { }
     ~TextureBase ();
 
+    //! \brief create the Vulkan image, memory, and view for the texture
+    //! \param wid      the width of the texture
+    //! \param ht       the height of the texture
+    //! \param fmt      the pixel format of the texture
+    //! \param nLevels  the number of mipmap levels (default 1)
+    void _init (uint32_t wid, uint32_t ht, VkFormat fmt, uint32_t nLevels = 1);
+
+    //! \brief copy the contents of a staging buffer to the texture's image and
+    //!        then free the staging buffer
+    //! \param stagingBuf  the staging buffer
+    //! \param stagingMem  the staging buffer's memory
+    //! \param regions     the copy regions; one per mipmap level
+    //! \param genMips     if true, then `regions` only covers level 0 and the
+    //!                    other levels are computed on the device by blitting
+    void _upload (
+        VkBuffer stagingBuf, VkDeviceMemory stagingMem,
+        std::vector<VkBufferImageCopy> const &regions,
+        bool genMips = false);
+
+    //! \brief initialize the texture from images
+    //! \param wid      the width of the texture
+    //! \param ht       the height of the texture
+    //! \param levels   the mipmap levels of the texture, starting with the base
+    //!                 image; all of the levels must have the same format
+    //! \param genMips  if true, then `levels` is just the base image and the
+    //!                 rest of the levels are computed on the device
+    void _loadImages (
+        uint32_t wid, uint32_t ht,
+        std::vector<ImageBase const *> const &levels,
+        bool genMips = false);
+
+    //! \brief should the device compute the mipmap levels of a texture with the
+    //!        given format?  This requires that the format supports blitting
+    //!        and linear filtering.
+    //! \param fmt   the format of the texture
+    //! \param mode  the requested mipmap mode; `MipmapMode::Auto` also requires
+    //!              that the device is not a CPU implementation of Vulkan
+    bool _canBlitMipmaps (VkFormat fmt, MipmapMode mode = MipmapMode::Auto);
+
     //! \brief create a VkBuffer object
     //! \param size   the size of the buffer in bytes
     //! \param usage  the usage of the buffer
@@ -73,10 +125,45 @@ class Texture2D : public __detail::TextureBase {
 public:
 
     //! \brief Construct a 2D texture from a 2D image
+    //! \param app        the owning application
+    //! \param img        the source image for the texture
+    //! \param mipmap     if true, generate mipmap levels for the texture
+    //! \param normalMap  if true, the image is a normal map and the vectors in
+    //!                   the mipmap levels are renormalized
+    //! \param mode       where the mipmap levels are computed
+    //!
+    //! The mipmap levels are computed on the device (using `vkCmdBlitImage`)
+    //! when `mode` selects it and the format of the image supports it.
+    //! Otherwise, and for normal maps, they are computed on the CPU (see
+    //! `mipmapLevels`).
+    Texture2D (
+        Application *app, Image2D const *img,
+        bool mipmap = false, bool normalMap = false,
+        MipmapMode mode = MipmapMode::Auto);
+
+    //! \brief Construct a 2D texture from a PNG file.  The image is decoded
+    //!        directly into the staging buffer that is used to upload it, so
+    //!        no intermediate `Image2D` is allocated.  As with `Image2D`, the
+    //!        image is flipped vertically to match OpenGL texture coordinates
+    //!        and three-channel images are given an opaque alpha channel.
     //! \param app     the owning application
-    //! \param img     the source image for the texture
-    //! \param mipmap  if true, generate mipmap levels for the texture.
-    Texture2D (Application *app, Image2D const *img, bool mipmap = false);
+    //! \param file    the name of the PNG file
+    //! \param data    if true, the image holds data (e.g., a normal map) and
+    //!                is not sRGB encoded (see `DataImage2D`)
+    //! \param mipmap  if true, generate mipmap levels for the texture.  The levels
+    //!                are computed on the device when `mode` selects it and the
+    //!                image format supports it; otherwise they are computed on
+    //!                the CPU from an in-memory copy of the image.
+    //! \param mode    where the mipmap levels are computed
+    Texture2D (
+        Application *app, std::string const &file,
+        bool data = false, bool mipmap = false,
+        MipmapMode mode = MipmapMode::Auto);
+
+private:
+    //! initialize the texture from an image and its mipmap levels
+    void _loadMipmapped (Image2D const *img, bool normalMap);
+
 };
 
 } // namespace cs237
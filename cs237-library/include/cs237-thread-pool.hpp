@@ -0,0 +1,95 @@
+/*! \file cs237-thread-pool.hpp
+ *
+ * Support code for CMSC 23700 Autumn 2022.
+ *
+ * A simple pool of worker threads for running independent tasks.
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#ifndef _CS237_THREAD_POOL_HPP_
+#define _CS237_THREAD_POOL_HPP_
+
+#ifndef _CS237_HPP_
+#error "cs237-thread-pool.hpp should not be included directly"
+#endif
+
+#include <thread>
+#include <future>
+#include <functional>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+namespace cs237 {
+
+//! A pool of worker threads.  Tasks are run in FIFO order by the workers.
+class ThreadPool {
+public:
+
+    //! \brief create a thread pool
+    //! \param nThreads the number of worker threads; 0 means use one thread
+    //!                 per hardware thread.
+    explicit ThreadPool (unsigned int nThreads = 0);
+
+    //! \brief destroy the pool; this function waits for any queued tasks to
+    //!        complete.
+    ~ThreadPool ();
+
+    ThreadPool (ThreadPool const &) = delete;
+    ThreadPool &operator= (ThreadPool const &) = delete;
+
+    //! the number of worker threads in the pool
+    unsigned int numThreads () const { return this->_workers.size(); }
+
+    //! \brief submit a task to the pool
+    //! \param fn the task to run
+    //! \return a future for the result of the task
+    template <typename F>
+    auto submit (F &&fn) -> std::future<decltype(fn())>
+    {
+        using R = decltype(fn());
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(fn));
+        std::future<R> res = task->get_future();
+        this->_enqueue ([task]() { (*task)(); });
+        return res;
+    }
+
+    //! \brief run `fn(i)`, for `0 <= i < n`, in parallel and wait for all of
+    //!        the calls to complete.
+    //! \param n  the number of iterations
+    //! \param fn the function to run for each iteration
+    //!
+    //! The calling thread also runs iterations, so it is safe to call this
+    //! function from inside a task that is running on the pool.  If any of
+    //! the iterations throws an exception, then the first such exception is
+    //! rethrown once all of the iterations have finished.
+    void parallelFor (size_t n, std::function<void(size_t)> const &fn);
+
+    //! \brief return the process-wide shared pool, which has one worker per
+    //!        hardware thread.
+    static ThreadPool &shared ();
+
+private:
+    std::vector<std::thread> _workers;          //!< the worker threads
+    std::deque<std::function<void()>> _queue;   //!< the queue of pending tasks
+    std::mutex _mu;                             //!< lock protecting the queue
+    std::condition_variable _cv;                //!< signaled when there is work
+    bool _done;                                 //!< set when the pool is shutting down
+
+    //! add a task to the queue
+    void _enqueue (std::function<void()> &&task);
+
+    //! the main loop of a worker thread
+    void _worker ();
+
+};
+
+} // namespace cs237
+
+#endif // !_CS237_THREAD_POOL_HPP_
@@ -0,0 +1,129 @@
+/*! \file cs237-vertex-welder.hpp
+ *
+ * Support code for CMSC 23700 Autumn 2022.
+ *
+ * This file defines a class for welding mesh vertices, i.e., for mapping the
+ * distinct combinations of per-corner attribute indices (e.g., the v/n/t
+ * triples of an OBJ face) to a dense range of vertex IDs.
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#ifndef _CS237_VERTEX_WELDER_HPP_
+#define _CS237_VERTEX_WELDER_HPP_
+
+#ifndef _CS237_HPP_
+#  error "cs237-vertex-welder.hpp should not be included directly"
+#endif
+
+namespace cs237 {
+
+//! A VertexWelder assigns IDs to the distinct keys that it is given, where a key
+//! is a triple of 32-bit attribute indices.  IDs are assigned in order of first
+//! occurrence starting at 0.  The implementation is a flat hash table that uses
+//! linear probing.
+class VertexWelder {
+  public:
+
+    //! a key is a triple of attribute indices
+    struct Key {
+        uint32_t a, b, c;
+    };
+
+    //! \brief create a welder
+    //! \param nKeys the expected number of distinct keys, which is used to size
+    //!        the table.  The table grows as needed, so this value is only a hint.
+    explicit VertexWelder (uint32_t nKeys = 0);
+
+    VertexWelder (VertexWelder const &) = delete;
+    VertexWelder &operator= (VertexWelder const &) = delete;
+
+    //! \brief remove all of the keys and resize the table for a new mesh
+    //! \param nKeys the expected number of distinct keys
+    void reset (uint32_t nKeys);
+
+    //! \brief return the ID for a key, adding the key if it is new
+    //! \param a the first attribute index
+    //! \param b the second attribute index
+    //! \param c the third attribute index
+    //! \return the ID of the key
+    uint32_t weld (uint32_t a, uint32_t b, uint32_t c)
+    {
+        uint32_t i = static_cast<uint32_t>(_hash(a, b, c)) & this->_mask;
+        while (true) {
+            Slot &s = this->_slots[i];
+            if (s.id == kEmpty) {
+                if (this->_keys.size() >= this->_limit) {
+                    this->_grow();
+                    return this->weld (a, b, c);
+                }
+                s.key = Key{a, b, c};
+                s.id = this->_keys.size();
+                this->_keys.push_back (s.key);
+                return s.id;
+            }
+            else if ((s.key.a == a) && (s.key.b == b) && (s.key.c == c)) {
+                return s.id;
+            }
+            i = (i + 1) & this->_mask;
+        }
+    }
+
+    //! the number of distinct keys (i.e., welded vertices)
+    uint32_t numVerts () const { return this->_keys.size(); }
+
+    //! the key for the given vertex ID
+    Key const &key (uint32_t id) const { return this->_keys[id]; }
+
+    //! the keys in order of their IDs
+    std::vector<Key> const &keys () const { return this->_keys; }
+
+    //! \brief free the hash table once all of the keys have been added; after
+    //!        this call, only `numVerts`, `key`, and `keys` may be used (until
+    //!        the next `reset`)
+    void releaseTable ();
+
+  private:
+    //! an entry in the hash table
+    struct Slot {
+        Key key;
+        uint32_t id;                    //!< the key's ID or kEmpty
+    };
+
+    static const uint32_t kEmpty = 0xffffffff;
+
+    std::vector<Slot> _slots;           //!< the hash table; its size is a power of 2
+    std::vector<Key> _keys;             //!< the keys in order of ID
+    uint32_t _mask;                     //!< _slots.size() - 1
+    uint32_t _limit;                    //!< the number of keys that causes the table to grow
+
+    //! hash a 96-bit key; we mix the three words and then apply the finalizer from
+    //! MurmurHash3, so that all of the key bits affect the low bits of the result.
+    static uint64_t _hash (uint32_t a, uint32_t b, uint32_t c)
+    {
+        uint64_t h = ((static_cast<uint64_t>(a) << 32) | b) * 0x9e3779b97f4a7c15ull;
+        h ^= (static_cast<uint64_t>(c) + 0x632be59bd9b4e019ull) * 0xc2b2ae3d27d4eb4full;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    //! allocate a table with room for nKeys keys
+    void _alloc (uint32_t nKeys);
+
+    //! double the size of the table
+    void _grow ();
+
+};
+
+} // namespace cs237
+
+#endif // !_CS237_VERTEX_WELDER_HPP_
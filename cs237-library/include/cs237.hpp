@@ -64,5 +64,9 @@ inline void ReportError (const char *file, int line, std::string const &msg)
 #include "cs237-image.hpp"
 #include "cs237-texture.hpp"
 #include "cs237-aabb.hpp"
+#include "cs237-arena.hpp"
+#include "cs237-thread-pool.hpp"
+#include "cs237-image-loader.hpp"
+#include "cs237-vertex-welder.hpp"
 
 #endif // !_CS237_HPP_
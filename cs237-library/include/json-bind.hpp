@@ -0,0 +1,486 @@
+/*! \file json-bind.hpp
+ *
+ * Typed decoding of JSON files.  A binding describes how the fields of a JSON
+ * object map onto the members of a C++ struct; the description is written once
+ * (usually as a `constexpr` value) and is then used to decode a file directly
+ * from the streaming reader (json::Cursor) without building any JSON values.
+ *
+ * For example, given
+ *
+ *      struct Light { glm::vec3 pos; float k0, k1, k2; };
+ *
+ * the binding
+ *
+ *      constexpr auto kVec3 = json::components<glm::vec3>("x", "y", "z");
+ *      constexpr auto kLight = json::object<Light>(
+ *          json::field("pos", &Light::pos, kVec3),
+ *          json::field("attenuation", json::elements(&Light::k0, &Light::k1, &Light::k2)));
+ *
+ * decodes `{"pos" : {"x" : 1, "y" : 2, "z" : 3}, "attenuation" : [1, 0, 0]}`.
+ * Fields of an object that are not mentioned in the binding are skipped.  All
+ * of the fields in a binding are required, except for those whose member has
+ * type `std::optional<T>`.  Errors are reported with the path of the offending
+ * value (e.g., `$.lighting.lights[2].attenuation`) and its line number.
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#ifndef _JSON_BIND_HPP_
+#define _JSON_BIND_HPP_
+
+#include "json.hpp"
+#include <limits>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace json {
+
+  //! The state of a decoding pass: the cursor, the path to the current value
+  //! (for error messages), and the first error.
+    class Decoder {
+      public:
+        explicit Decoder (Cursor &cursor) : _cursor(cursor), _path(), _err() { }
+
+      //! the cursor that we are decoding from
+        Cursor &cursor () { return this->_cursor; }
+
+      //! get the next event
+        Event next () { return this->_cursor.next(); }
+
+      //! skip the value that starts with the most recent event
+        bool skip ();
+
+      //! enter an object field
+        void push (std::string_view key) { this->_path.push_back (PathElem{key, -1}); }
+
+      //! enter an array element
+        void push (int index) { this->_path.push_back (PathElem{std::string_view(), index}); }
+
+      //! leave the current field/element
+        void pop () { this->_path.pop_back(); }
+
+      //! \brief record an error at the current path
+      //! \return false
+        bool error (std::string const &msg);
+
+      //! \brief record an error for a value of the wrong kind
+      //! \param expected  a description of the expected value
+      //! \param ev        the first event of the value that we got
+      //! \return false
+        bool typeError (const char *expected, Event ev);
+
+      //! the error message (empty if there has not been an error)
+        std::string const &errorMessage () const { return this->_err; }
+
+      private:
+        struct PathElem {
+            std::string_view key;       //!< the field label (if index < 0)
+            int index;                  //!< the array index
+        };
+
+        Cursor &_cursor;
+        std::vector<PathElem> _path;
+        std::string _err;
+    };
+
+  /***** Scalar values *****/
+
+  //! the binding for a scalar type T (numbers, booleans, and strings)
+    template <typename T, typename Enable = void>
+    struct Scalar;
+
+  //! floating-point values can be decoded from integers or reals
+    template <typename T>
+    struct Scalar<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+        using type = T;
+        bool decode (Decoder &dec, Event ev, T &dst) const
+        {
+            if ((ev != E_INTEGER) && (ev != E_REAL)) {
+                return dec.typeError ("number", ev);
+            }
+            dst = static_cast<T>(dec.cursor().realVal());
+            return true;
+        }
+    };
+
+  //! integer values must be in the range of the type
+    template <typename T>
+    struct Scalar<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>> {
+        using type = T;
+        bool decode (Decoder &dec, Event ev, T &dst) const
+        {
+            if (ev != E_INTEGER) {
+                return dec.typeError ("integer", ev);
+            }
+            int64_t n = dec.cursor().intVal();
+          // the upper bound is compared as unsigned, since the maximum of uint64_t
+          // does not fit in an int64_t, so it only applies to non-negative values
+            if ((n < static_cast<int64_t>(std::numeric_limits<T>::min()))
+            || ((n > 0)
+                && (static_cast<uint64_t>(n) > static_cast<uint64_t>(std::numeric_limits<T>::max())))) {
+                return dec.error ("integer out of range");
+            }
+            dst = static_cast<T>(n);
+            return true;
+        }
+    };
+
+    template <>
+    struct Scalar<bool> {
+        using type = bool;
+        bool decode (Decoder &dec, Event ev, bool &dst) const
+        {
+            if (ev != E_BOOL) {
+                return dec.typeError ("boolean", ev);
+            }
+            dst = dec.cursor().boolVal();
+            return true;
+        }
+    };
+
+    template <>
+    struct Scalar<std::string> {
+        using type = std::string;
+        bool decode (Decoder &dec, Event ev, std::string &dst) const
+        {
+            if (ev != E_STRING) {
+                return dec.typeError ("string", ev);
+            }
+            dst = dec.cursor().string();
+            return true;
+        }
+    };
+
+    namespace __details {
+
+      // decode a value into a destination; optional destinations are
+      // emplaced first (or reset by a null value)
+        template <typename B, typename M>
+        bool decodeInto (B const &binding, Decoder &dec, Event ev, M &dst)
+        {
+            return binding.decode (dec, ev, dst);
+        }
+
+        template <typename B, typename M>
+        bool decodeInto (B const &binding, Decoder &dec, Event ev, std::optional<M> &dst)
+        {
+            if (ev == E_NULL) {
+                dst.reset();
+                return true;
+            }
+            return binding.decode (dec, ev, dst.emplace());
+        }
+
+        template <typename M>
+        struct IsOptional : std::false_type { };
+        template <typename M>
+        struct IsOptional<std::optional<M>> : std::true_type { };
+
+        template <typename M>
+        struct Unwrap { using type = M; };
+        template <typename M>
+        struct Unwrap<std::optional<M>> { using type = M; };
+
+    } // namespace __details
+
+  /***** Objects *****/
+
+  //! a field that is decoded into a member of the struct
+    template <typename T, typename M, typename B>
+    struct MemberField {
+        std::string_view name;
+        M T::*member;
+        B binding;
+
+        static constexpr bool kRequired = ! __details::IsOptional<M>::value;
+
+        bool decode (Decoder &dec, Event ev, T &dst) const
+        {
+            return __details::decodeInto (this->binding, dec, ev, dst.*(this->member));
+        }
+    };
+
+  //! a field whose value is an object (or array) that is decoded into the
+  //! enclosing struct; this supports grouping of fields in the JSON that does
+  //! not match the grouping in the struct
+    template <typename T, typename B>
+    struct InlineField {
+        std::string_view name;
+        B binding;
+
+        static constexpr bool kRequired = true;
+
+        bool decode (Decoder &dec, Event ev, T &dst) const
+        {
+            return this->binding.decode (dec, ev, dst);
+        }
+    };
+
+  //! a field that is decoded into an element of the struct (using `operator[]`)
+    template <typename T>
+    struct IndexField {
+        std::string_view name;
+        int index;
+
+        static constexpr bool kRequired = true;
+
+        bool decode (Decoder &dec, Event ev, T &dst) const
+        {
+            using M = std::remove_reference_t<decltype(dst[0])>;
+            return Scalar<M>().decode (dec, ev, dst[this->index]);
+        }
+    };
+
+  //! the binding of a JSON object to the struct T
+    template <typename T, typename... Fields>
+    class ObjectBinding {
+      public:
+        using type = T;
+
+        constexpr explicit ObjectBinding (Fields... fields) : _fields(fields...) { }
+
+        bool decode (Decoder &dec, Event ev, T &dst) const
+        {
+            return this->_decode (dec, ev, dst, std::index_sequence_for<Fields...>());
+        }
+
+      private:
+        std::tuple<Fields...> _fields;
+
+        template <size_t... Is>
+        bool _decode (Decoder &dec, Event ev, T &dst, std::index_sequence<Is...>) const
+        {
+            if (ev != E_START_OBJECT) {
+                return dec.typeError ("object", ev);
+            }
+            bool seen[sizeof...(Fields) + 1] = { false };
+            while ((ev = dec.next()) == E_KEY) {
+                std::string_view key = dec.cursor().string();
+              // find the field; the key is only valid until the next event
+                int idx = -1;
+                ((std::get<Is>(this->_fields).name == key ? (idx = Is, true) : false) || ...);
+                ev = dec.next();
+                if (idx < 0) {
+                    if (! dec.skip()) {
+                        return false;
+                    }
+                    continue;
+                }
+                bool ok = true;
+                ((idx == int(Is)
+                    ? (dec.push (std::get<Is>(this->_fields).name),
+                       ok = std::get<Is>(this->_fields).decode (dec, ev, dst),
+                       true)
+                    : false) || ...);
+                if (! ok) {
+                    return false;
+                }
+                dec.pop();
+                seen[idx] = true;
+            }
+            if (ev != E_END_OBJECT) {
+                return dec.typeError ("field label", ev);
+            }
+          // check that the required fields are present
+            bool ok = true;
+            ((ok = ok && (seen[Is] || !std::tuple_element_t<Is, std::tuple<Fields...>>::kRequired
+                || dec.error ("missing field \"" + std::string(std::get<Is>(this->_fields).name) + "\""))), ...);
+            return ok;
+        }
+    };
+
+  //! \brief the binding of a JSON object to a struct
+  //! \param fields  the bindings of the fields (see `field`)
+    template <typename T, typename... Fields>
+    constexpr ObjectBinding<T, Fields...> object (Fields... fields)
+    {
+        return ObjectBinding<T, Fields...>(fields...);
+    }
+
+  //! \brief a field that is decoded into a scalar member of the struct
+  //! \param name    the JSON label of the field
+  //! \param member  the member of the struct
+    template <typename T, typename M>
+    constexpr auto field (std::string_view name, M T::*member)
+    {
+        using B = Scalar<typename __details::Unwrap<M>::type>;
+        return MemberField<T, M, B>{ name, member, B() };
+    }
+
+  //! \brief a field that is decoded into a member of the struct using a binding
+  //! \param name     the JSON label of the field
+  //! \param member   the member of the struct
+  //! \param binding  the binding for the member's value
+    template <typename T, typename M, typename B>
+    constexpr auto field (std::string_view name, M T::*member, B binding)
+    {
+        return MemberField<T, M, B>{ name, member, binding };
+    }
+
+  //! \brief a field that is decoded into the enclosing struct
+  //! \param name     the JSON label of the field
+  //! \param binding  the binding for the field's value, which must be a binding
+  //!                 for the enclosing struct
+    template <typename B, typename = std::enable_if_t<!std::is_member_pointer_v<B>>>
+    constexpr auto field (std::string_view name, B binding)
+    {
+        return InlineField<typename B::type, B>{ name, binding };
+    }
+
+    namespace __details {
+        template <typename V, size_t... Is, typename... Names>
+        constexpr auto components (std::index_sequence<Is...>, Names... names)
+        {
+            return object<V> (IndexField<V>{ names, int(Is) }...);
+        }
+    } // namespace __details
+
+  //! \brief the binding of a JSON object to a vector type (e.g., `glm::vec3`)
+  //!        whose components are accessed using `operator[]`
+  //! \param names  the labels of the components in order
+    template <typename V, typename... Names>
+    constexpr auto components (Names... names)
+    {
+        return __details::components<V> (
+            std::index_sequence_for<Names...>(),
+            std::string_view(names)...);
+    }
+
+  /***** Arrays *****/
+
+  //! the binding of a JSON array to a `std::vector`
+    template <typename B>
+    class ArrayBinding {
+      public:
+        using type = std::vector<typename B::type>;
+
+        constexpr explicit ArrayBinding (B binding) : _binding(binding) { }
+
+        bool decode (Decoder &dec, Event ev, type &dst) const
+        {
+            if (ev != E_START_ARRAY) {
+                return dec.typeError ("array", ev);
+            }
+            dst.clear();
+            for (int i = 0;  (ev = dec.next()) != E_END_ARRAY;  i++) {
+                dst.emplace_back();
+                dec.push (i);
+                if (! this->_binding.decode (dec, ev, dst.back())) {
+                    return false;
+                }
+                dec.pop();
+            }
+            return true;
+        }
+
+      private:
+        B _binding;
+    };
+
+  //! \brief the binding of a JSON array whose elements are decoded using a binding
+    template <typename B>
+    constexpr ArrayBinding<B> arrayOf (B binding)
+    {
+        return ArrayBinding<B>(binding);
+    }
+
+  //! the binding of a fixed-length JSON array of scalars to members of a struct
+    template <typename T, typename... Ms>
+    class ElementsBinding {
+      public:
+        using type = T;
+
+        constexpr explicit ElementsBinding (Ms T::*... members) : _members(members...) { }
+
+        bool decode (Decoder &dec, Event ev, T &dst) const
+        {
+            return this->_decode (dec, ev, dst, std::index_sequence_for<Ms...>());
+        }
+
+      private:
+        std::tuple<Ms T::*...> _members;
+
+        template <size_t... Is>
+        bool _decode (Decoder &dec, Event ev, T &dst, std::index_sequence<Is...>) const
+        {
+            const size_t n = sizeof...(Ms);
+            if (ev != E_START_ARRAY) {
+                return dec.typeError ("array", ev);
+            }
+            bool ok = true;
+            ((ok = ok && this->_element (dec, Is, dst.*std::get<Is>(this->_members))), ...);
+            if (! ok) {
+                return false;
+            }
+            ev = dec.next();
+            if (ev != E_END_ARRAY) {
+                return (ev == E_ERROR)
+                    ? dec.typeError ("']'", ev)
+                    : dec.error ("expected array of " + std::to_string(n) + " elements");
+            }
+            return true;
+        }
+
+        template <typename M>
+        bool _element (Decoder &dec, int i, M &dst) const
+        {
+            Event ev = dec.next();
+            if (ev == E_END_ARRAY) {
+                return dec.error ("expected array of " + std::to_string(sizeof...(Ms)) + " elements");
+            }
+            dec.push (i);
+            if (! Scalar<M>().decode (dec, ev, dst)) {
+                return false;
+            }
+            dec.pop ();
+            return true;
+        }
+    };
+
+  //! \brief the binding of a fixed-length JSON array of scalars, which are
+  //!        stored in the given members of a struct
+    template <typename T, typename... Ms>
+    constexpr ElementsBinding<T, Ms...> elements (Ms T::*... members)
+    {
+        return ElementsBinding<T, Ms...>(members...);
+    }
+
+  /***** Decoding files *****/
+
+  //! \brief decode a JSON file
+  //! \param filename  the file to decode
+  //! \param binding   the binding for the file's top-level value
+  //! \param dst       the value to decode into
+  //! \param err       set to a description of the error (if any)
+  //! \return false if the file cannot be read, has a syntax error, or does not
+  //!         match the binding
+    template <typename B>
+    bool decodeFile (
+        std::string const &filename,
+        B const &binding,
+        typename B::type &dst,
+        std::string &err)
+    {
+        Cursor cursor;
+        if (! cursor.open (filename)) {
+            err = "unable to read \"" + filename + "\"";
+            return false;
+        }
+        Decoder dec(cursor);
+        if (! binding.decode (dec, dec.next(), dst)) {
+            err = dec.errorMessage();
+            return false;
+        }
+        return true;
+    }
+
+} // namespace json
+
+#endif // !_JSON_BIND_HPP_
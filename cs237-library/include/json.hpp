@@ -17,9 +17,12 @@
 #ifndef _JSON_HPP_
 #define _JSON_HPP_
 
+#include <cstdint>
 #include <vector>
 #include <string>
-#include <map>
+#include <string_view>
+
+namespace cs237 { class Arena; }
 
 namespace json {
 
@@ -34,6 +37,22 @@ namespace json {
         T_NULL          //!< the null value
     };
 
+  //! the events produced by the streaming reader (see Cursor)
+    enum Event {
+        E_START_OBJECT, //!< the start of an object
+        E_END_OBJECT,   //!< the end of an object
+        E_START_ARRAY,  //!< the start of an array
+        E_END_ARRAY,    //!< the end of an array
+        E_KEY,          //!< the label of an object field
+        E_INTEGER,      //!< an integer number
+        E_REAL,         //!< a real number
+        E_STRING,       //!< a string
+        E_BOOL,         //!< a boolean
+        E_NULL,         //!< the null value
+        E_END,          //!< the end of the input
+        E_ERROR         //!< a syntax error
+    };
+
     class Value;
     class Object;
     class Array;
@@ -43,10 +62,181 @@ namespace json {
     class String;
     class Bool;
     class Null;
+    class Document;
+    class Handler;
+    class Cursor;
 
-  // parse a JSON file; this returns nullptr if there is a parsing error
+  //! parse a JSON file into a tree of heap-allocated values; this returns
+  //! nullptr if there is a parsing error.  The caller owns the result and
+  //! deleting it deletes the whole tree.
     Value *parseFile (std::string filename);
 
+  //! A Document owns a parsed JSON file.  All of the document's values (and
+  //! the text of the file) are allocated from a single arena, so parsing does
+  //! not call `new` per value and freeing the document is cheap.  Strings that
+  //! do not contain escapes refer directly to the text of the file.  The values
+  //! of a document must not be deleted; they are valid until the document is
+  //! destroyed or is used to parse another file.
+    class Document {
+      public:
+        Document ();
+        ~Document ();
+
+        Document (Document const &) = delete;
+        Document &operator= (Document const &) = delete;
+
+      //! \brief parse a JSON file, replacing the previous contents of the document
+      //! \param filename  the file to parse
+      //! \return the root value or nullptr if there was an error
+        Value *parseFile (std::string const &filename);
+
+      //! the root value of the document (nullptr if there is none)
+        Value *root () const { return this->_root; }
+
+      private:
+        cs237::Arena *_arena;   //!< the storage for the text and values
+        Value *_root;           //!< the root value
+    };
+
+  //! The interface for the event-driven (SAX-style) reader.  The reader calls
+  //! the handler's methods as it parses the file, in file order, without
+  //! building any values.  Each method returns false to stop the parse.
+    class Handler {
+      public:
+        virtual ~Handler ();
+
+        virtual bool startObject () = 0;
+        virtual bool endObject () = 0;
+        virtual bool startArray () = 0;
+        virtual bool endArray () = 0;
+      //! the label of an object field; the label is only valid during the call
+        virtual bool key (std::string_view k) = 0;
+        virtual bool integer (int64_t n) = 0;
+        virtual bool real (double r) = 0;
+      //! a string value; the string is only valid during the call
+        virtual bool string (std::string_view s) = 0;
+        virtual bool boolean (bool b) = 0;
+        virtual bool null () = 0;
+    };
+
+  //! \brief parse a JSON file and pass its contents to a handler
+  //! \param filename  the file to parse
+  //! \param handler   the handler that receives the parsing events
+  //! \return false if the file cannot be read, has a syntax error, or the
+  //!         handler stopped the parse
+    bool parseFile (std::string const &filename, Handler &handler);
+
+  //! A pull parser for JSON files.  Each call to `next` returns the next event
+  //! in the file; the value of a key, string, or number event is available from
+  //! the cursor until the following call to `next`.  The cursor checks the
+  //! syntax of the file as it goes, and its memory use depends only on the
+  //! nesting depth of the input.
+    class Cursor {
+      public:
+        Cursor ();
+        ~Cursor ();
+
+        Cursor (Cursor const &) = delete;
+        Cursor &operator= (Cursor const &) = delete;
+
+      //! \brief open a JSON file for reading
+      //! \return false if the file cannot be read
+        bool open (std::string const &filename);
+
+      //! return the next event; once the input is exhausted (or there has been
+      //! an error), `next` returns `E_END` (resp. `E_ERROR`).
+        Event next ();
+
+      //! \brief skip a value.  If the most recent event was `E_START_OBJECT` or
+      //!        `E_START_ARRAY`, then this skips to the matching end event;
+      //!        otherwise it does nothing.
+      //! \return false if there was a syntax error
+        bool skip ();
+
+      //! the label of an `E_KEY` event or the value of an `E_STRING` event.  If
+      //! the string does not contain escape sequences, then it refers to the
+      //! text of the file and is valid as long as the cursor is; otherwise, it
+      //! is only valid until the next call to `next`.
+        std::string_view string () const { return this->_str; }
+
+      //! true if the current string contained escape sequences
+        bool hasEscapes () const { return this->_escapes; }
+
+      //! the value of an `E_INTEGER` event
+        int64_t intVal () const { return this->_int; }
+
+      //! the value of an `E_REAL` or `E_INTEGER` event
+        double realVal () const
+        {
+            return (this->_event == E_INTEGER) ? static_cast<double>(this->_int) : this->_real;
+        }
+
+      //! the value of an `E_BOOL` event
+        bool boolVal () const { return this->_bool; }
+
+      //! the most recent event
+        Event event () const { return this->_event; }
+
+      //! the nesting depth of the current position (0 at the top level)
+        int depth () const { return static_cast<int>(this->_stack.size()); }
+
+      //! true if the innermost enclosing value is an object (false if it is an
+      //! array or if we are at the top level)
+        bool inObject () const
+        {
+            return (! this->_stack.empty()) && (this->_stack.back() == '{');
+        }
+
+      //! the line number of the current position; this is computed on demand,
+      //! so it should only be used for error messages
+        int line () const;
+
+      //! a description of the syntax error after an `E_ERROR` event (nullptr
+      //! if there has not been an error)
+        const char *errorMessage () const { return this->_errMsg; }
+
+      private:
+        friend class Document;
+
+      //! the parsing states
+        enum State {
+            S_VALUE,            //!< expecting a value
+            S_OBJ_START,        //!< following "{": expecting a label or "}"
+            S_ARR_START,        //!< following "[": expecting a value or "]"
+            S_KEY,              //!< following "," in an object: expecting a label
+            S_AFTER_VALUE,      //!< expecting ",", "}", "]", or the end of the input
+            S_DONE,             //!< the whole value has been read
+            S_ERROR             //!< there has been an error
+        };
+
+        std::string _file;      //!< the file name (for error messages)
+        const char *_buffer;    //!< the text, which is followed by a NUL
+        size_t _pos;            //!< the current position in the text
+        size_t _len;            //!< the length of the text
+        bool _owned;            //!< true if the cursor owns the buffer
+        State _state;           //!< the parsing state
+        std::vector<char> _stack; //!< the open objects ('{') and arrays ('[')
+        Event _event;           //!< the most recent event
+        std::string_view _str;  //!< the current string/label
+        bool _escapes;          //!< true if _str contained escape sequences
+        std::string _scratch;   //!< storage for unescaped strings
+        int64_t _int;           //!< the current integer
+        double _real;           //!< the current real
+        bool _bool;             //!< the current boolean
+        const char *_errMsg;    //!< the error message (nullptr if no error)
+
+      //! read from a NUL-terminated buffer that is owned by someone else
+        void _init (std::string const &file, const char *buf, size_t len);
+
+        bool _skipWhitespace ();
+        Event _error (const char *msg);
+        Event _scanKey ();
+        Event _scanValue ();
+        Event _scanString (Event ev);
+        Event _scanNumber ();
+        Event _endContainer ();
+    };
+
   // virtual base class of JSON values
     class Value {
       public:
@@ -117,25 +307,44 @@ namespace json {
         return s << v->toString();
     }
 
-  //! JSON objects
+  //! JSON objects.  The fields are kept in the order in which they were
+  //! inserted.  Lookup in small objects is a linear scan of the fields; objects
+  //! with more than `kMaxLinear` fields also have a hash table that maps keys
+  //! to field indices.
     class Object : public Value {
       public:
-        Object () : Value(T_OBJECT), _value() { };
+      //! a field of an object
+        struct Member {
+            std::string_view key;       //!< the field's label
+            Value *value;               //!< the field's value
+        };
+
+        //! the largest object that does not have a hash table
+        static const int kMaxLinear = 8;
+
+        Object ()
+          : Value(T_OBJECT), _fields(nullptr), _size(0), _cap(0),
+            _index(nullptr), _mask(0)
+        { };
         ~Object ();
 
       //! return the number of fields in the object
-        int size () const { return this->_value.size(); }
+        int size () const { return this->_size; }
+
+      //! return the i'th field of the object
+        Member const &field (int i) const { return this->_fields[i]; }
 
-      //! insert a key-value pair into the object
-        void insert (std::string key, Value *val);
+      //! insert a key-value pair into the object; the object takes ownership of
+      //! the value.  This operation is only supported for heap-allocated objects.
+        void insert (std::string_view key, Value *val);
 
       //! return the value corresponding to the given key.
       //! \returns nil if the key is not defined in the object
-        Value *operator[] (std::string key) const;
+        Value *operator[] (std::string_view key) const;
 
       //! return an object-valued field
       //! \returns nullptr if the field is not present or is not an object
-        const Object *fieldAsObject (std::string key) const
+        const Object *fieldAsObject (std::string_view key) const
         {
             const Value *v = (*this)[key];
             return (v != nullptr) ? v->asObject() : nullptr;
@@ -143,7 +352,7 @@ namespace json {
 
       //! return an array-valued field
       //! \returns nullptr if the field is not present or is not an array
-        const Array *fieldAsArray (std::string key) const
+        const Array *fieldAsArray (std::string_view key) const
         {
             const Value *v = (*this)[key];
             return (v != nullptr) ? v->asArray() : nullptr;
@@ -151,7 +360,7 @@ namespace json {
 
       //! return a number-valued field
       //! \returns nullptr if the field is not present or is not a number
-        const Number *fieldAsNumber (std::string key) const
+        const Number *fieldAsNumber (std::string_view key) const
         {
             const Value *v = (*this)[key];
             return (v != nullptr) ? v->asNumber() : nullptr;
@@ -159,7 +368,7 @@ namespace json {
 
       //! return an integer-valued field
       //! \returns nullptr if the field is not present or is not an integer
-        const Integer *fieldAsInteger (std::string key) const
+        const Integer *fieldAsInteger (std::string_view key) const
         {
             const Value *v = (*this)[key];
             return (v != nullptr) ? v->asInteger() : nullptr;
@@ -167,7 +376,7 @@ namespace json {
 
       //! return an real-valued field
       //! \returns nullptr if the field is not present or is not a real
-        const Real *fieldAsReal (std::string key) const
+        const Real *fieldAsReal (std::string_view key) const
         {
             const Value *v = (*this)[key];
             return (v != nullptr) ? v->asReal() : nullptr;
@@ -175,7 +384,7 @@ namespace json {
 
       //! return an string-valued field
       //! \returns nullptr if the field is not present or is not a string
-        const String *fieldAsString (std::string key) const
+        const String *fieldAsString (std::string_view key) const
         {
             const Value *v = (*this)[key];
             return (v != nullptr) ? v->asString() : nullptr;
@@ -183,7 +392,7 @@ namespace json {
 
       //! return an bool-valued field
       //! \returns nullptr if the field is not present or is not a bool
-        const Bool *fieldAsBool (std::string key) const
+        const Bool *fieldAsBool (std::string_view key) const
         {
             const Value *v = (*this)[key];
             return (v != nullptr) ? v->asBool() : nullptr;
@@ -192,24 +401,59 @@ namespace json {
         std::string toString();
 
       private:
-        std::map<std::string, Value *> _value;
+        friend class Parser;
+
+        Member  *_fields;       //!< the fields in insertion order
+        int     _size;          //!< the number of fields
+        int     _cap;           //!< the capacity of the _fields array
+        uint32_t *_index;       //!< open-addressing hash table that maps keys to
+                                //!< field index + 1 (0 marks an empty slot);
+                                //!< nullptr for small objects
+        uint32_t _mask;         //!< the size of the hash table minus one
+
+      // an arena-allocated object; the fields are owned by the document
+        Object (Member *fields, int n)
+          : Value(T_OBJECT), _fields(fields), _size(n), _cap(n),
+            _index(nullptr), _mask(0)
+        { }
+
+      // the size of the hash table for an object with n fields
+        static uint32_t _indexSize (int n);
+
+      // initialize the hash table, which has sz (a power of 2) slots, from the fields
+        void _buildIndex (uint32_t *table, uint32_t sz);
+
+      // add the i'th field to the hash table
+        void _indexField (int i);
     };
 
   //! JSON arrays
     class Array : public Value {
       public:
-        Array () : Value(T_ARRAY), _value() { };
+        Array () : Value(T_ARRAY), _elems(nullptr), _len(0), _cap(0) { };
         ~Array ();
 
-        int length () const { return static_cast<int>(this->_value.size()); }
-        void add (Value *v) { this->_value.push_back(v); }
+        int length () const { return this->_len; }
+
+      //! add a value to the end of the array; the array takes ownership of the
+      //! value.  This operation is only supported for heap-allocated arrays.
+        void add (Value *v);
 
-        Value *operator[] (int idx) const { return this->_value[idx]; }
+        Value *operator[] (int idx) const { return this->_elems[idx]; }
 
         std::string toString();
 
       private:
-        std::vector<Value *> _value;
+        friend class Parser;
+
+        Value   **_elems;       //!< the elements of the array
+        int     _len;           //!< the number of elements
+        int     _cap;           //!< the capacity of the _elems array
+
+      // an arena-allocated array; the elements are owned by the document
+        Array (Value **elems, int n)
+          : Value(T_ARRAY), _elems(elems), _len(n), _cap(n)
+        { }
     };
 
   //! base class for JSON numbers
@@ -254,15 +498,23 @@ namespace json {
 
     class String : public Value {
       public:
-        String (std::string v) : Value(T_STRING), _value(v) { };
+        String (std::string v);
         ~String ();
 
-        std::string value () const { return this->_value; }
+        std::string value () const { return std::string(this->_value); }
+
+      //! the characters of the string without copying them
+        std::string_view view () const { return this->_value; }
 
         std::string toString();
 
       private:
-        std::string _value;
+        friend class Parser;
+
+        std::string_view _value;
+
+      // an arena-allocated string; the characters are owned by the document
+        String (std::string_view v, bool) : Value(T_STRING), _value(v) { };
     };
 
     class Bool : public Value {
@@ -15,9 +15,13 @@
 #define _OBJ_HXX_
 
 #include "cs237.hpp"
+#include <cfloat>
+#include <unordered_map>
 
 namespace OBJ {
 
+namespace __details { class MappedFile; }
+
 //! Illumination modes define how to interpret the material values.
 //! Note that other modes are mapped to Specular by the loader
 enum {
@@ -80,6 +84,188 @@ struct Group {
                                         //!  to render the group
 }; // struct Group
 
+//! Statistics about how well a group's triangle order uses a FIFO post-transform
+//! vertex cache.
+struct CacheStats {
+    float               acmr;           //!< average cache miss ratio (vertex shader
+                                        //!  invocations per triangle)
+    float               atvr;           //!< average transformed vertex ratio (vertex
+                                        //!  shader invocations per vertex)
+}; // struct CacheStats
+
+//! \brief compute the vertex-cache statistics for a group
+//! \param grp       the group to analyze
+//! \param cacheSize the number of entries in the simulated FIFO cache
+//! \return the ACMR and ATVR of the group's triangle order
+CacheStats AnalyzeVertexCache (struct Group const &grp, uint32_t cacheSize = 32);
+
+//! \brief optimize the triangle and vertex order of a group.  The triangles are
+//!        reordered for the post-transform vertex cache (using the Tipsify
+//!        algorithm) and then the vertices are renumbered in order of first use.
+//! \param grp       the group to optimize; its arrays are modified in place
+//! \param cacheSize the target cache size
+void OptimizeGroup (struct Group &grp, uint32_t cacheSize = 16);
+
+//! How the face normals are weighted when computing smooth vertex normals
+enum NormalWeighting {
+    AngleWeighted,              //!< weight by the angle of the face at the vertex
+    AreaWeighted                //!< weight by the area of the face
+};
+
+//! \brief compute smooth vertex normals for a group.  Vertices that have the same
+//!        position get the same normal, so the normals are continuous across
+//!        texture seams.
+//! \param grp   the group
+//! \param norms array of grp.nVerts normals that is set to the result
+//! \param wt    how the face normals are weighted
+void ComputeNormals (struct Group const &grp, glm::vec3 *norms, NormalWeighting wt = AngleWeighted);
+
+//! \brief compute vertex tangents for normal mapping using the MikkTSpace
+//!        conventions.  The xyz part of a tangent is a unit vector that is
+//!        orthogonal to the vertex normal and the w part is the handedness of
+//!        the frame (+1 or -1), so that the bitangent is w * cross(N, T).
+//! \param grp   the group; it must have texture coordinates
+//! \param norms the vertex normals (either grp.norms or computed by ComputeNormals)
+//! \param tans  array of grp.nVerts tangents that is set to the result
+void ComputeTangents (struct Group const &grp, glm::vec3 const *norms, glm::vec4 *tans);
+
+//! A simplified level of detail (LOD) for a group.  The indices refer to the
+//! vertex arrays of the group, so all of the levels of a group can share the
+//! group's vertex buffer.
+struct LOD {
+    std::vector<uint32_t> indices;      //!< the triangles of this level
+    float               error;          //!< the approximate object-space distance between
+                                        //!  this level and the original group
+}; // struct LOD
+
+//! \brief simplify a group by quadric edge collapse.  UV and normal seams are
+//!        preserved and open borders are only simplified along the border.
+//! \param grp           the group to simplify
+//! \param targetIndices the desired number of indices (3 * number of triangles)
+//! \param maxError      the maximum object-space error of a collapse
+//! \return the simplified triangles, which may have more than targetIndices indices
+//!         if the error limit is reached or no more edges can be collapsed
+LOD SimplifyGroup (struct Group const &grp, uint32_t targetIndices, float maxError = FLT_MAX);
+
+//! \brief build a chain of levels of detail for a group
+//! \param grp       the group to simplify
+//! \param maxLevels the maximum number of levels (including the full-detail level)
+//! \param ratio     the target reduction in triangles from one level to the next
+//! \param maxError  the maximum object-space error of a collapse
+//! \return the levels ordered from finest to coarsest; level 0 is the original
+//!         group and the errors are non-decreasing
+std::vector<LOD> BuildLODChain (
+    struct Group const &grp,
+    uint32_t maxLevels = 8,
+    float ratio = 0.5f,
+    float maxError = FLT_MAX);
+
+//! \brief compute the size in pixels of an object-space error when viewed with a
+//!        perspective projection
+//! \param error      the object-space error
+//! \param dist       the distance from the eye to the object
+//! \param fovy       the vertical field of view (in radians)
+//! \param viewportHt the height of the viewport in pixels
+//! \return the projected size of the error in pixels
+float ScreenSpaceError (float error, float dist, float fovy, float viewportHt);
+
+//! \brief select the coarsest level of detail whose screen-space error is within
+//!        a threshold
+//! \param chain      the levels of detail (see BuildLODChain)
+//! \param dist       the distance from the eye to the object
+//! \param fovy       the vertical field of view (in radians)
+//! \param viewportHt the height of the viewport in pixels
+//! \param pixelError the maximum allowed screen-space error in pixels
+//! \return the index of the selected level in chain
+uint32_t SelectLOD (
+    std::vector<LOD> const &chain,
+    float dist,
+    float fovy,
+    float viewportHt,
+    float pixelError = 1.0f);
+
+//! A meshlet is a small cluster of a group's triangles.  The triangles of a
+//! meshlet are contiguous in the table's index array, so a visible meshlet
+//! can be drawn with a single indexed draw.
+struct Meshlet {
+    uint32_t            firstIndex;     //!< offset of the meshlet's triangles in
+                                        //!  MeshletTable::indices
+    uint32_t            firstVert;      //!< offset of the meshlet's vertices in
+                                        //!  MeshletTable::vertices
+    uint32_t            firstTri;       //!< offset of the meshlet's local triangles in
+                                        //!  MeshletTable::triangles (in triangles)
+    uint16_t            nVerts;         //!< the number of vertices in the meshlet
+    uint16_t            nTris;          //!< the number of triangles in the meshlet
+}; // struct Meshlet
+
+//! The culling data for a meshlet, which is stored separately from the Meshlet
+//! so that the culling loop only touches 32 bytes per meshlet.
+struct MeshletBounds {
+    glm::vec4           sphere;         //!< the bounding sphere (center in xyz, radius in w)
+    glm::vec4           cone;           //!< the normal cone (unit axis in xyz and the cutoff
+                                        //!  in w); the meshlet is back-facing when viewed
+                                        //!  from eye if
+                                        //!  dot(c - eye, axis) >= w * |c - eye| + radius,
+                                        //!  where c is the sphere's center.  The cutoff is
+                                        //!  1 for meshlets that are never back-facing.
+}; // struct MeshletBounds
+
+//! The meshlets of a group
+struct MeshletTable {
+    std::vector<Meshlet> meshlets;      //!< the meshlets
+    std::vector<MeshletBounds> bounds;  //!< the culling data for the meshlets
+    std::vector<uint32_t> vertices;     //!< the group vertex indices of each meshlet's
+                                        //!  vertices
+    std::vector<uint8_t> triangles;     //!< three local vertex indices per triangle
+    std::vector<uint32_t> indices;      //!< the group's triangles reordered by meshlet;
+                                        //!  this array replaces the group's index array
+                                        //!  when drawing meshlets
+}; // struct MeshletTable
+
+//! \brief split a group into meshlets.  Triangles are added to a meshlet
+//!        greedily, preferring triangles that share vertices with the meshlet
+//!        and that face the same way as the meshlet's triangles.
+//! \param grp      the group to split
+//! \param maxVerts the maximum number of vertices in a meshlet (at most 255)
+//! \param maxTris  the maximum number of triangles in a meshlet
+//! \return the meshlet table for the group
+MeshletTable BuildMeshlets (struct Group const &grp, uint32_t maxVerts = 64, uint32_t maxTris = 124);
+
+//! \brief determine which meshlets are potentially visible
+//! \param table    the meshlet table to cull
+//! \param mvp      the model-view-projection matrix (with Vulkan's [0..1] depth range)
+//! \param eye      the position of the eye in model coordinates
+//! \param visible  output vector that is set to the indices of the meshlets that
+//!                 intersect the view frustum and that are not back-facing
+void CullMeshlets (
+    MeshletTable const &table,
+    glm::mat4 const &mvp,
+    glm::vec3 const &eye,
+    std::vector<uint32_t> &visible);
+
+//! Options that control how a model is loaded
+struct Options {
+    bool                useCache;       //!< if true, load the model from a binary cache
+                                        //!  file when it is up to date and write the cache
+                                        //!  file when it is not.
+    std::string         cacheDir;       //!< the directory that holds the cache files; if
+                                        //!  empty, then the cache file is stored next to
+                                        //!  the OBJ file.
+    bool                optimize;       //!< if true, optimize the triangle and vertex
+                                        //!  order of the groups (see OptimizeGroup)
+    bool                verbose;        //!< if true, report the vertex-cache statistics
+                                        //!  of the optimized groups
+    bool                parallel;       //!< if true, parse the file and build the groups
+                                        //!  in parallel; otherwise the file is streamed
+                                        //!  and the vertices are welded as they are read,
+                                        //!  which uses less memory.
+
+    Options ()
+      : useCache(false), cacheDir(), optimize(false), verbose(false), parallel(false)
+    { }
+
+}; // struct Options
+
 //! A model from an OBJ file
 class Model {
   public:
@@ -87,6 +273,12 @@ class Model {
   //! create a Model by loading it from the specified OBJ file
   //! \param filename the path of the OBJ file to be loaded
     Model (std::string filename);
+
+  //! create a Model by loading it from the specified OBJ file
+  //! \param filename the path of the OBJ file to be loaded
+  //! \param opts     options that control the loading of the model
+    Model (std::string filename, Options const &opts);
+
     ~Model ();
 
   //! the model's axis-aligned bounding box
@@ -96,6 +288,14 @@ class Model {
     int NumMaterials () const { return this->_materials.size(); }
   //! get a material
     const OBJ::Material & Material (int i) const { return this->_materials[i]; }
+  //! get the index of a material by name
+  //! \param name the name of the material
+  //! \return the index of the material or -1 if there is no such material
+    int MaterialIndex (std::string const &name) const
+    {
+        auto it = this->_mtlIndex.find(name);
+        return (it == this->_mtlIndex.end()) ? -1 : it->second;
+    }
 
   //! the number of groups in this model
     int NumGroups () const { return this->_groups.size(); }
@@ -112,11 +312,34 @@ class Model {
     cs237::AABBf        _bbox;          //!< bounding box for model
 
     std::vector<OBJ::Material> _materials;
+    std::unordered_map<std::string, int> _mtlIndex;     //!< maps material names to indices
     std::vector<OBJ::Group> _groups;
 
+  //! if the model was loaded from a cache file, then this is the mapping of the file
+  //! and the group arrays point into it; otherwise it is nullptr and the group arrays
+  //! are heap allocated.
+    __details::MappedFile *_cache;
+
+  //! if the model was loaded from an OBJ file, then this is the arena that holds
+  //! the group arrays in a single block; otherwise it is nullptr.
+    cs237::Arena *_arena;
+
   // read a material library
     bool readMaterial (std::string m);
 
+  // build the map from material names to indices
+    void _indexMaterials ();
+
+  // load the model from the OBJ file
+    void _loadOBJ (Options const &opts);
+
+  // load the model from a cache file; returns false if the cache file does not
+  // exist, is out of date, or was written with different options.
+    bool _loadCache (std::string const &cacheFile, Options const &opts);
+
+  // write the model to a cache file
+    void _saveCache (std::string const &cacheFile, Options const &opts) const;
+
 }; // class Model
 
 } // namespace OBJ
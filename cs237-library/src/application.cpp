@@ -370,7 +370,8 @@ VkImage Application::_createImage (
     uint32_t wid,
     uint32_t ht, VkFormat format,
     VkImageTiling tiling,
-    VkImageUsageFlags usage)
+    VkImageUsageFlags usage,
+    uint32_t mipLevels)
 {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -378,7 +379,7 @@ VkImage Application::_createImage (
     imageInfo.extent.width = wid;
     imageInfo.extent.height = ht;
     imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
+    imageInfo.mipLevels = mipLevels;
     imageInfo.arrayLayers = 1;
     imageInfo.format = format;
     imageInfo.tiling = tiling;
@@ -419,7 +420,8 @@ VkDeviceMemory Application::_allocImageMemory (VkImage img, VkMemoryPropertyFlag
 VkImageView Application::_createImageView (
     VkImage img,
     VkFormat fmt,
-    VkImageAspectFlags aspectFlags)
+    VkImageAspectFlags aspectFlags,
+    uint32_t mipLevels)
 {
     assert (img != VK_NULL_HANDLE);
 
@@ -430,7 +432,7 @@ VkImageView Application::_createImageView (
     viewInfo.format = fmt;
     viewInfo.subresourceRange.aspectMask = aspectFlags;
     viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.levelCount = mipLevels;
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
 
@@ -661,6 +663,9 @@ VkSampler Application::createSampler (Application::SamplerInfo const &info)
     samplerInfo.unnormalizedCoordinates = VK_FALSE;
     samplerInfo.compareEnable = VK_FALSE;
     samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    // allow all of the mipmap levels of the texture to be used
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
     VkSampler sampler;
     auto sts = vkCreateSampler(this->_device, &samplerInfo, nullptr, &sampler);
@@ -682,6 +687,17 @@ std::vector<VkExtensionProperties> Application::supportedExtensions ()
     return extProps;
 }
 
+// Get the list of supported device extensions for the selected physical device
+//
+std::vector<VkExtensionProperties> Application::supportedDeviceExtensions ()
+{
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(this->_gpu, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extProps(extensionCount);
+    vkEnumerateDeviceExtensionProperties(this->_gpu, nullptr, &extensionCount, extProps.data());
+    return extProps;
+}
+
 // Get the list of supported layers
 //
 std::vector<VkLayerProperties> Application::supportedLayers ()
@@ -0,0 +1,93 @@
+/*! \file arena.cpp
+ *
+ * Support code for CMSC 23700 Autumn 2022.
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#include "cs237.hpp"
+#include <cstdlib>
+
+namespace cs237 {
+
+Arena::Arena (size_t blockSz)
+  : _blocks(nullptr), _next(nullptr), _limit(nullptr), _blockSz(blockSz)
+{
+    if (blockSz > 0) {
+        this->_newBlock (blockSz);
+    }
+}
+
+Arena::~Arena ()
+{
+    Block *blk = this->_blocks;
+    while (blk != nullptr) {
+        Block *next = blk->next;
+        std::free (blk);
+        blk = next;
+    }
+}
+
+void Arena::reset ()
+{
+    if (this->_blocks == nullptr) {
+        return;
+    }
+  // free all but the most recent block
+    Block *blk = this->_blocks->next;
+    while (blk != nullptr) {
+        Block *next = blk->next;
+        std::free (blk);
+        blk = next;
+    }
+    this->_blocks->next = nullptr;
+    this->_next = this->_blocks->data();
+    this->_limit = this->_next + this->_blocks->size;
+}
+
+size_t Arena::size () const
+{
+    size_t sz = 0;
+    for (Block *blk = this->_blocks;  blk != nullptr;  blk = blk->next) {
+        sz += blk->size;
+    }
+    return sz;
+}
+
+size_t Arena::numBlocks () const
+{
+    size_t n = 0;
+    for (Block *blk = this->_blocks;  blk != nullptr;  blk = blk->next) {
+        n++;
+    }
+    return n;
+}
+
+void *Arena::_allocSlow (size_t nBytes, size_t align)
+{
+  // the block data is aligned to kDefaultAlign, so we only need padding for
+  // larger alignments
+    size_t pad = (align > kDefaultAlign) ? align - kDefaultAlign : 0;
+    this->_newBlock (std::max(this->_blockSz, nBytes + pad));
+    return this->alloc (nBytes, align);
+}
+
+void Arena::_newBlock (size_t sz)
+{
+    Block *blk = static_cast<Block *>(std::malloc (sizeof(Block) + sz));
+    if (blk == nullptr) {
+        ERROR("Arena: unable to allocate memory");
+    }
+    blk->next = this->_blocks;
+    blk->size = sz;
+    this->_blocks = blk;
+    this->_next = blk->data();
+    this->_limit = this->_next + sz;
+}
+
+} // namespace cs237
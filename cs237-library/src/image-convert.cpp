@@ -0,0 +1,586 @@
+/*! \file image-convert.cpp
+ *
+ * Support code for CMSC 23700 Autumn 2022.
+ *
+ * Conversion of image data between pixel formats.
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#include "cs237.hpp"
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#  include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#  include <arm_neon.h>
+#endif
+
+namespace cs237 {
+
+/***** Pixel layouts *****/
+
+// the layout of a pixel: the number of channels and the index of the red,
+// green, blue, and alpha channels in the pixel (-1 if the channel is missing)
+struct Layout {
+    int n;
+    int idx[4];
+};
+
+static Layout layoutOf (Channels chans)
+{
+    switch (chans) {
+    case Channels::R: return Layout{1, {0, -1, -1, -1}};
+    case Channels::RG: return Layout{2, {0, 1, -1, -1}};
+    case Channels::RGB: return Layout{3, {0, 1, 2, -1}};
+    case Channels::BGR: return Layout{3, {2, 1, 0, -1}};
+    case Channels::RGBA: return Layout{4, {0, 1, 2, 3}};
+    case Channels::BGRA: return Layout{4, {2, 1, 0, 3}};
+    default:
+        ERROR("convert: unknown channels");
+    }
+}
+
+// the size of a channel in bytes
+static size_t typeSize (ChannelTy ty)
+{
+    switch (ty) {
+    case ChannelTy::U8: return 1;
+    case ChannelTy::U16: return 2;
+    case ChannelTy::F32: return 4;
+    default:
+        ERROR("convert: unsupported channel type " + to_string(ty));
+    }
+}
+
+/***** sRGB transfer functions *****/
+
+static inline float srgbToLinear (float x)
+{
+    return (x <= 0.04045f) ? x * (1.0f / 12.92f) : std::pow((x + 0.055f) * (1.0f / 1.055f), 2.4f);
+}
+
+static inline float linearToSRGB (float x)
+{
+    return (x <= 0.0031308f) ? x * 12.92f : 1.055f * std::pow(x, 1.0f / 2.4f) - 0.055f;
+}
+
+static inline float clamp01 (float x)
+{
+    return (x < 0.0f) ? 0.0f : ((x > 1.0f) ? 1.0f : x);
+}
+
+// decoding table for 8-bit sRGB values
+static float const *srgb8ToLinearTbl ()
+{
+    static float const *tbl = []() {
+        float *t = new float[256];
+        for (int i = 0;  i < 256;  i++) {
+            t[i] = srgbToLinear(float(i) / 255.0f);
+        }
+        return t;
+    }();
+    return tbl;
+}
+
+// encoding table from linear values (quantized to 16 bits) to 8-bit sRGB values;
+// the steepest part of the sRGB curve maps about 20 table entries to each 8-bit
+// value, so the quantization does not affect the result except at ties
+static uint8_t const *linearToSRGB8Tbl ()
+{
+    static uint8_t const *tbl = []() {
+        uint8_t *t = new uint8_t[65536];
+        for (int i = 0;  i < 65536;  i++) {
+            t[i] = uint8_t(255.0f * linearToSRGB(float(i) / 65535.0f) + 0.5f);
+        }
+        return t;
+    }();
+    return tbl;
+}
+
+/***** Channel-type conversions *****/
+
+// convert n channel values without changing the channel layout or the encoding
+static void convertValues (
+    size_t n,
+    void const *src, ChannelTy srcTy,
+    void *dst, ChannelTy dstTy)
+{
+    if (srcTy == ChannelTy::U8) {
+        uint8_t const *s = static_cast<uint8_t const *>(src);
+        if (dstTy == ChannelTy::U16) {
+            uint16_t *d = static_cast<uint16_t *>(dst);
+            for (size_t i = 0;  i < n;  i++) {
+                d[i] = uint16_t(s[i]) * 257;
+            }
+        }
+        else { // F32
+            float *d = static_cast<float *>(dst);
+            size_t i = 0;
+#if defined(__AVX2__)
+            __m256 scale = _mm256_set1_ps(1.0f / 255.0f);
+            for (;  i + 8 <= n;  i += 8) {
+                __m128i b = _mm_loadl_epi64 (reinterpret_cast<__m128i const *>(s + i));
+                _mm256_storeu_ps (d + i, _mm256_mul_ps (_mm256_cvtepi32_ps (_mm256_cvtepu8_epi32 (b)), scale));
+            }
+#elif defined(__SSE2__)
+            __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+            __m128i zero = _mm_setzero_si128();
+            for (;  i + 16 <= n;  i += 16) {
+                __m128i b = _mm_loadu_si128 (reinterpret_cast<__m128i const *>(s + i));
+                __m128i lo = _mm_unpacklo_epi8 (b, zero);
+                __m128i hi = _mm_unpackhi_epi8 (b, zero);
+                _mm_storeu_ps (d + i, _mm_mul_ps (_mm_cvtepi32_ps (_mm_unpacklo_epi16 (lo, zero)), scale));
+                _mm_storeu_ps (d + i + 4, _mm_mul_ps (_mm_cvtepi32_ps (_mm_unpackhi_epi16 (lo, zero)), scale));
+                _mm_storeu_ps (d + i + 8, _mm_mul_ps (_mm_cvtepi32_ps (_mm_unpacklo_epi16 (hi, zero)), scale));
+                _mm_storeu_ps (d + i + 12, _mm_mul_ps (_mm_cvtepi32_ps (_mm_unpackhi_epi16 (hi, zero)), scale));
+            }
+#endif
+            for (;  i < n;  i++) {
+                d[i] = float(s[i]) * (1.0f / 255.0f);
+            }
+        }
+    }
+    else if (srcTy == ChannelTy::U16) {
+        uint16_t const *s = static_cast<uint16_t const *>(src);
+        if (dstTy == ChannelTy::U8) {
+            uint8_t *d = static_cast<uint8_t *>(dst);
+          // round(x / 257) computed without a division
+            for (size_t i = 0;  i < n;  i++) {
+                d[i] = uint8_t((uint32_t(s[i]) * 255 + 32895) >> 16);
+            }
+        }
+        else { // F32
+            float *d = static_cast<float *>(dst);
+            for (size_t i = 0;  i < n;  i++) {
+                d[i] = float(s[i]) * (1.0f / 65535.0f);
+            }
+        }
+    }
+    else { // F32
+        float const *s = static_cast<float const *>(src);
+        if (dstTy == ChannelTy::U8) {
+            uint8_t *d = static_cast<uint8_t *>(dst);
+            size_t i = 0;
+#if defined(__SSE2__)
+          // clamp, scale, and round (by adding 0.5 and truncating, to match the scalar code)
+            __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+            __m128 scale = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+            for (;  i + 16 <= n;  i += 16) {
+                __m128i v[4];
+                for (int j = 0;  j < 4;  j++) {
+                    __m128 x = _mm_min_ps (_mm_max_ps (_mm_loadu_ps (s + i + 4*j), zero), one);
+                    v[j] = _mm_cvttps_epi32 (_mm_add_ps (_mm_mul_ps (x, scale), half));
+                }
+                __m128i w = _mm_packus_epi16 (_mm_packs_epi32 (v[0], v[1]), _mm_packs_epi32 (v[2], v[3]));
+                _mm_storeu_si128 (reinterpret_cast<__m128i *>(d + i), w);
+            }
+#endif
+            for (;  i < n;  i++) {
+                d[i] = uint8_t(clamp01(s[i]) * 255.0f + 0.5f);
+            }
+        }
+        else { // U16
+            uint16_t *d = static_cast<uint16_t *>(dst);
+            for (size_t i = 0;  i < n;  i++) {
+                d[i] = uint16_t(clamp01(s[i]) * 65535.0f + 0.5f);
+            }
+        }
+    }
+}
+
+/***** Channel swizzles *****/
+
+// the source of each destination channel: a channel index, or one of the
+// following constants
+static const int kZero = -1;    // missing color channel
+static const int kOne = -2;     // missing alpha channel
+
+static void channelMap (Layout const &src, Layout const &dst, int sel[4])
+{
+    for (int c = 0;  c < 4;  c++) {
+        if (dst.idx[c] >= 0) {
+            int s = src.idx[c];
+            sel[dst.idx[c]] = (s >= 0) ? s : ((c == 3) ? kOne : kZero);
+        }
+    }
+}
+
+// rearrange the channels of pixels i..nPixels-1.  The numbers of source and
+// destination channels are template parameters and the per-channel state is
+// held in scalars, so that the loop is unrolled and has no branches (missing
+// channels are handled by masking).
+template <typename T, int SN, int DN>
+static void swizzleFrom (
+    size_t i, size_t nPixels,
+    T const *src, T *dst, int const sel[4], T one)
+{
+    int idx[4];
+    T keep[4], fill[4];
+    for (int c = 0;  c < 4;  c++) {
+        int sc = (c < DN) ? sel[c] : kZero;
+        idx[c] = (sc >= 0) ? sc : 0;
+        keep[c] = (sc >= 0) ? T(~T(0)) : T(0);
+        fill[c] = (sc == kOne) ? one : T(0);
+    }
+    int const i0 = idx[0], i1 = idx[1], i2 = idx[2], i3 = idx[3];
+    T const k0 = keep[0], k1 = keep[1], k2 = keep[2], k3 = keep[3];
+    T const f0 = fill[0], f1 = fill[1], f2 = fill[2], f3 = fill[3];
+
+    T const *s = src + i*SN;
+    T *d = dst + i*DN;
+    for (;  i < nPixels;  i++, s += SN, d += DN) {
+      // load the whole pixel before storing, since the stores might alias
+        T p0 = (s[i0] & k0) | f0;
+        T p1 = (DN > 1) ? T((s[i1] & k1) | f1) : T(0);
+        T p2 = (DN > 2) ? T((s[i2] & k2) | f2) : T(0);
+        T p3 = (DN > 3) ? T((s[i3] & k3) | f3) : T(0);
+        d[0] = p0;
+        if constexpr (DN > 1) { d[1] = p1; }
+        if constexpr (DN > 2) { d[2] = p2; }
+        if constexpr (DN > 3) { d[3] = p3; }
+    }
+}
+
+template <typename T, int SN>
+static void swizzleFrom (
+    size_t i, size_t nPixels,
+    T const *src, T *dst, int dn, int const sel[4], T one)
+{
+    switch (dn) {
+    case 1: swizzleFrom<T,SN,1> (i, nPixels, src, dst, sel, one); break;
+    case 2: swizzleFrom<T,SN,2> (i, nPixels, src, dst, sel, one); break;
+    case 3: swizzleFrom<T,SN,3> (i, nPixels, src, dst, sel, one); break;
+    default: swizzleFrom<T,SN,4> (i, nPixels, src, dst, sel, one); break;
+    }
+}
+
+template <typename T>
+static void swizzleFrom (
+    size_t i, size_t nPixels,
+    T const *src, int sn,
+    T *dst, int dn, int const sel[4], T one)
+{
+    switch (sn) {
+    case 1: swizzleFrom<T,1> (i, nPixels, src, dst, dn, sel, one); break;
+    case 2: swizzleFrom<T,2> (i, nPixels, src, dst, dn, sel, one); break;
+    case 3: swizzleFrom<T,3> (i, nPixels, src, dst, dn, sel, one); break;
+    default: swizzleFrom<T,4> (i, nPixels, src, dst, dn, sel, one); break;
+    }
+}
+
+// rearrange the channels of pixels without changing the channel type; `one` is
+// the representation of an opaque alpha value.  Floats are handled as 32-bit
+// integers.
+template <typename T>
+static void swizzle (
+    size_t nPixels,
+    T const *src, Layout const &srcL,
+    T *dst, Layout const &dstL,
+    T one)
+{
+    int sel[4];
+    channelMap (srcL, dstL, sel);
+    swizzleFrom (size_t(0), nPixels, src, srcL.n, dst, dstL.n, sel, one);
+}
+
+// the 8-bit case, which is the common one, is vectorized
+template <>
+void swizzle<uint8_t> (
+    size_t nPixels,
+    uint8_t const *src, Layout const &srcL,
+    uint8_t *dst, Layout const &dstL,
+    uint8_t one)
+{
+    int sel[4];
+    channelMap (srcL, dstL, sel);
+    int sn = srcL.n, dn = dstL.n;
+    size_t i = 0;
+
+#if defined(__SSSE3__) || (defined(__ARM_NEON) && defined(__aarch64__))
+  // four pixels at a time using a byte shuffle; each step reads 16 bytes from
+  // the source and writes 16 bytes to the destination (of which 4*sn and 4*dn
+  // are used), so we stop while there are at least 16 bytes left in both, which
+  // is governed by the smaller of the two pixel sizes.
+    alignas(16) uint8_t shuf[16], ones[16];
+    for (int p = 0;  p < 4;  p++) {
+        for (int c = 0;  c < 4;  c++) {
+            int j = 4*p + c;
+            if (c >= dn) {
+                shuf[j] = 0x80; ones[j] = 0;
+            } else if (sel[c] >= 0) {
+                shuf[j] = uint8_t(p*sn + sel[c]); ones[j] = 0;
+            } else {
+                shuf[j] = 0x80; ones[j] = (sel[c] == kOne) ? one : 0;
+            }
+        }
+    }
+  // compact the destination bytes when the destination has fewer than four channels
+    if (dn < 4) {
+        uint8_t s2[16], o2[16];
+        int k = 0;
+        for (int p = 0;  p < 4;  p++) {
+            for (int c = 0;  c < dn;  c++, k++) {
+                s2[k] = shuf[4*p + c]; o2[k] = ones[4*p + c];
+            }
+        }
+        for (;  k < 16;  k++) {
+            s2[k] = 0x80; o2[k] = 0;
+        }
+        std::memcpy (shuf, s2, 16);
+        std::memcpy (ones, o2, 16);
+    }
+#  if defined(__SSSE3__)
+    __m128i shufV = _mm_load_si128 (reinterpret_cast<__m128i const *>(shuf));
+    __m128i onesV = _mm_load_si128 (reinterpret_cast<__m128i const *>(ones));
+    for (;  (nPixels - i) * std::min(sn, dn) >= 16;  i += 4) {
+        __m128i v = _mm_loadu_si128 (reinterpret_cast<__m128i const *>(src + i*sn));
+        v = _mm_or_si128 (_mm_shuffle_epi8 (v, shufV), onesV);
+        _mm_storeu_si128 (reinterpret_cast<__m128i *>(dst + i*dn), v);
+    }
+#  else
+  // vqtbl1q_u8 returns 0 for out-of-range indices, like pshufb does for 0x80
+    uint8x16_t shufV = vld1q_u8 (shuf);
+    uint8x16_t onesV = vld1q_u8 (ones);
+    for (;  (nPixels - i) * std::min(sn, dn) >= 16;  i += 4) {
+        uint8x16_t v = vld1q_u8 (src + i*sn);
+        vst1q_u8 (dst + i*dn, vorrq_u8 (vqtbl1q_u8 (v, shufV), onesV));
+    }
+#  endif
+#endif
+
+    swizzleFrom (i, nPixels, src, sn, dst, dn, sel, one);
+}
+
+/***** The general case *****/
+
+// the number of pixels that are converted at a time in the general case
+static const size_t kBlockSz = 256;
+
+// decoding table for 8-bit linear values
+static float const *linear8ToFloatTbl ()
+{
+    static float const *tbl = []() {
+        float *t = new float[256];
+        for (int i = 0;  i < 256;  i++) {
+            t[i] = float(i) / 255.0f;
+        }
+        return t;
+    }();
+    return tbl;
+}
+
+// unpack a block of pixels to linear RGBA floats
+static void unpack (
+    size_t n,
+    void const *src, Layout const &srcL, ChannelTy srcTy, bool decode,
+    float *rgba)
+{
+    if (srcTy == ChannelTy::U8) {
+      // table lookup per channel; alpha is never sRGB encoded
+        float const *lin = linear8ToFloatTbl();
+        float const *clr = decode ? srgb8ToLinearTbl() : lin;
+        uint8_t const *s = static_cast<uint8_t const *>(src);
+        for (size_t i = 0;  i < n;  i++, s += srcL.n) {
+            float *d = rgba + 4*i;
+            for (int c = 0;  c < 3;  c++) {
+                int j = srcL.idx[c];
+                d[c] = (j >= 0) ? clr[s[j]] : 0.0f;
+            }
+            d[3] = (srcL.idx[3] >= 0) ? lin[s[srcL.idx[3]]] : 1.0f;
+        }
+        return;
+    }
+
+    float vals[4 * kBlockSz];
+    float const *s;
+    if (srcTy == ChannelTy::F32) {
+        s = static_cast<float const *>(src);
+    } else {
+        convertValues (n * srcL.n, src, srcTy, vals, ChannelTy::F32);
+        s = vals;
+    }
+    for (size_t i = 0;  i < n;  i++, s += srcL.n) {
+        float *d = rgba + 4*i;
+        for (int c = 0;  c < 4;  c++) {
+            int j = srcL.idx[c];
+            d[c] = (j >= 0) ? s[j] : ((c == 3) ? 1.0f : 0.0f);
+        }
+        if (decode) {
+            for (int c = 0;  c < 3;  c++) {
+                d[c] = srgbToLinear(clamp01(d[c]));
+            }
+        }
+    }
+}
+
+// pack a block of linear RGBA floats
+static void pack (
+    size_t n,
+    float const *rgba,
+    void *dst, Layout const &dstL, ChannelTy dstTy, bool encode)
+{
+    if ((dstTy == ChannelTy::U8) && encode) {
+      // use the encoding table for the color channels
+        uint8_t const *tbl = linearToSRGB8Tbl();
+        uint8_t *d = static_cast<uint8_t *>(dst);
+        size_t i = 0;
+#if defined(__SSE2__)
+      // compute the table indices (and the alpha value) for a pixel at a time
+      // with SIMD when the destination is RGBA
+        if (dstL.n == 4) {
+            __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f);
+            __m128 scl = _mm_setr_ps(65535.0f, 65535.0f, 65535.0f, 255.0f);
+            alignas(16) int32_t q[4];
+            for (;  i < n;  i++, d += 4) {
+                __m128 v = _mm_min_ps (_mm_max_ps (_mm_loadu_ps (rgba + 4*i), zero), one);
+                _mm_store_si128 (
+                    reinterpret_cast<__m128i *>(q),
+                    _mm_cvttps_epi32 (_mm_add_ps (_mm_mul_ps (v, scl), half)));
+                d[dstL.idx[0]] = tbl[q[0]];
+                d[dstL.idx[1]] = tbl[q[1]];
+                d[dstL.idx[2]] = tbl[q[2]];
+                d[3] = uint8_t(q[3]);
+            }
+            return;
+        }
+#endif
+        for (;  i < n;  i++, d += dstL.n) {
+            float const *s = rgba + 4*i;
+            for (int c = 0;  c < 4;  c++) {
+                int j = dstL.idx[c];
+                if (j >= 0) {
+                    d[j] = (c < 3)
+                        ? tbl[uint32_t(clamp01(s[c]) * 65535.0f + 0.5f)]
+                        : uint8_t(clamp01(s[c]) * 255.0f + 0.5f);
+                }
+            }
+        }
+        return;
+    }
+
+    float vals[4 * kBlockSz];
+    float *d = (dstTy == ChannelTy::F32) ? static_cast<float *>(dst) : vals;
+    for (size_t i = 0;  i < n;  i++, d += dstL.n) {
+        float const *s = rgba + 4*i;
+        for (int c = 0;  c < 4;  c++) {
+            int j = dstL.idx[c];
+            if (j >= 0) {
+                d[j] = (encode && (c < 3)) ? linearToSRGB(clamp01(s[c])) : s[c];
+            }
+        }
+    }
+    if (dstTy != ChannelTy::F32) {
+        convertValues (n * dstL.n, vals, ChannelTy::F32, dst, dstTy);
+    }
+}
+
+/***** Entry points *****/
+
+namespace __detail {
+
+void convertPixels (
+    size_t nPixels,
+    void const *src, Channels srcChans, ChannelTy srcTy, bool srcSRGB,
+    void *dst, Channels dstChans, ChannelTy dstTy, bool dstSRGB)
+{
+    size_t srcTySz = typeSize(srcTy);
+    size_t dstTySz = typeSize(dstTy);
+    Layout srcL = layoutOf(srcChans);
+    Layout dstL = layoutOf(dstChans);
+
+  // the encoding only matters when it changes
+    bool decode = srcSRGB && !dstSRGB;
+    bool encode = !srcSRGB && dstSRGB;
+
+    if (!decode && !encode) {
+        if ((srcChans == dstChans) && (srcTy == dstTy)) {
+            std::memcpy (dst, src, nPixels * srcL.n * srcTySz);
+            return;
+        }
+        else if (srcTy == dstTy) {
+            switch (srcTy) {
+            case ChannelTy::U8:
+                swizzle (
+                    nPixels,
+                    static_cast<uint8_t const *>(src), srcL,
+                    static_cast<uint8_t *>(dst), dstL,
+                    uint8_t(0xff));
+                break;
+            case ChannelTy::U16:
+                swizzle (
+                    nPixels,
+                    static_cast<uint16_t const *>(src), srcL,
+                    static_cast<uint16_t *>(dst), dstL,
+                    uint16_t(0xffff));
+                break;
+            default:
+                swizzle (
+                    nPixels,
+                    static_cast<uint32_t const *>(src), srcL,
+                    static_cast<uint32_t *>(dst), dstL,
+                    uint32_t(0x3f800000)); // 1.0f
+                break;
+            }
+            return;
+        }
+        else if (srcChans == dstChans) {
+            convertValues (nPixels * srcL.n, src, srcTy, dst, dstTy);
+            return;
+        }
+    }
+
+  // the general case: convert to linear RGBA floats and back a block at a time
+    size_t srcPixSz = srcL.n * srcTySz;
+    size_t dstPixSz = dstL.n * dstTySz;
+    uint8_t const *s = static_cast<uint8_t const *>(src);
+    uint8_t *d = static_cast<uint8_t *>(dst);
+    float rgba[4 * kBlockSz];
+  // when one side is already linear RGBA floats, we skip the intermediate block
+    bool srcIsRGBA = (srcChans == Channels::RGBA) && (srcTy == ChannelTy::F32) && !decode;
+    bool dstIsRGBA = (dstChans == Channels::RGBA) && (dstTy == ChannelTy::F32) && !encode;
+    for (size_t i = 0;  i < nPixels;  i += kBlockSz) {
+        size_t n = std::min(kBlockSz, nPixels - i);
+        if (srcIsRGBA) {
+            pack (n, reinterpret_cast<float const *>(s + i * srcPixSz), d + i * dstPixSz, dstL, dstTy, encode);
+        }
+        else if (dstIsRGBA) {
+            unpack (n, s + i * srcPixSz, srcL, srcTy, decode, reinterpret_cast<float *>(d + i * dstPixSz));
+        }
+        else {
+            unpack (n, s + i * srcPixSz, srcL, srcTy, decode, rgba);
+            pack (n, rgba, d + i * dstPixSz, dstL, dstTy, encode);
+        }
+    }
+}
+
+} // namespace __detail
+
+Image1D *convert (Image1D const *src, Channels chans, ChannelTy ty, bool sRGB)
+{
+    Image1D *dst = new Image1D (src->width(), chans, ty);
+    dst->_sRGB = sRGB;
+    __detail::convertPixels (
+        src->width(),
+        src->data(), src->channels(), src->type(), src->_sRGB,
+        dst->data(), chans, ty, sRGB);
+    return dst;
+}
+
+Image2D *convert (Image2D const *src, Channels chans, ChannelTy ty, bool sRGB)
+{
+    Image2D *dst = new Image2D (src->width(), src->height(), chans, ty);
+    dst->_sRGB = sRGB;
+    __detail::convertPixels (
+        src->width() * src->height(),
+        src->data(), src->channels(), src->type(), src->_sRGB,
+        dst->data(), chans, ty, sRGB);
+    return dst;
+}
+
+} // namespace cs237
@@ -0,0 +1,79 @@
+/*! \file image-loader.cpp
+ *
+ * Support code for CMSC 23700 Autumn 2022.
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#include "cs237.hpp"
+
+namespace cs237 {
+
+ImageLoader::ImageLoader (ThreadPool &pool)
+  : _pool(pool)
+{ }
+
+std::shared_future<Image2D *> ImageLoader::load (std::string const &file, bool data, bool flip)
+{
+    std::lock_guard<std::mutex> lk(this->_mu);
+
+    auto it = this->_reqs.find(file);
+    if (it != this->_reqs.end()) {
+        return it->second;
+    }
+
+    std::shared_future<Image2D *> res = this->_pool.submit (
+        [file, data, flip]() -> Image2D * {
+            if (data) {
+                return new DataImage2D (file, flip);
+            } else {
+                return new Image2D (file, flip);
+            }
+        }).share();
+    this->_reqs.insert (std::make_pair(file, res));
+
+    return res;
+}
+
+Image2D *ImageLoader::get (std::string const &file)
+{
+    std::shared_future<Image2D *> res;
+    {
+        std::lock_guard<std::mutex> lk(this->_mu);
+        auto it = this->_reqs.find(file);
+        if (it == this->_reqs.end()) {
+            ERROR("ImageLoader::get: no request for \"" + file + "\"");
+        }
+        res = it->second;
+    }
+  // wait without holding the lock, so that other threads can make requests
+    return res.get();
+}
+
+void ImageLoader::wait ()
+{
+    std::vector<std::shared_future<Image2D *>> reqs;
+    {
+        std::lock_guard<std::mutex> lk(this->_mu);
+        reqs.reserve (this->_reqs.size());
+        for (auto &req : this->_reqs) {
+            reqs.push_back (req.second);
+        }
+    }
+    for (auto &req : reqs) {
+        req.wait();
+    }
+}
+
+size_t ImageLoader::numRequests () const
+{
+    std::lock_guard<std::mutex> lk(this->_mu);
+    return this->_reqs.size();
+}
+
+} // namespace cs237
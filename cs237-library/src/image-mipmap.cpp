@@ -0,0 +1,201 @@
+/*! \file image-mipmap.cpp
+ *
+ * Support code for CMSC 23700 Autumn 2022.
+ *
+ * Construction of mipmap levels for 2D images.
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#include "cs237.hpp"
+
+#if defined(__SSE2__)
+#  include <immintrin.h>
+#elif defined(__ARM_NEON)
+#  include <arm_neon.h>
+#endif
+
+namespace cs237 {
+
+/***** Pixel arithmetic *****/
+
+// the filter works on linear RGBA float pixels, which fit in a single SIMD register
+#if defined(__SSE2__)
+using Pixel = __m128;
+static inline Pixel load (float const *p) { return _mm_loadu_ps (p); }
+static inline void store (float *p, Pixel v) { _mm_storeu_ps (p, v); }
+static inline Pixel add (Pixel a, Pixel b) { return _mm_add_ps (a, b); }
+static inline Pixel scale (Pixel a, float s) { return _mm_mul_ps (a, _mm_set1_ps (s)); }
+#elif defined(__ARM_NEON)
+using Pixel = float32x4_t;
+static inline Pixel load (float const *p) { return vld1q_f32 (p); }
+static inline void store (float *p, Pixel v) { vst1q_f32 (p, v); }
+static inline Pixel add (Pixel a, Pixel b) { return vaddq_f32 (a, b); }
+static inline Pixel scale (Pixel a, float s) { return vmulq_n_f32 (a, s); }
+#else
+struct Pixel { float v[4]; };
+static inline Pixel load (float const *p) { return Pixel{{p[0], p[1], p[2], p[3]}}; }
+static inline void store (float *p, Pixel v) { std::memcpy (p, v.v, sizeof(v.v)); }
+static inline Pixel add (Pixel a, Pixel b)
+{
+    return Pixel{{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}};
+}
+static inline Pixel scale (Pixel a, float s)
+{
+    return Pixel{{a.v[0] * s, a.v[1] * s, a.v[2] * s, a.v[3] * s}};
+}
+#endif
+
+/***** Levels *****/
+
+// the number of destination rows that are computed by a single task
+static const uint32_t kBandSz = 16;
+
+// the source of a filtering step, which is either the base image (whose rows
+// are converted to linear RGBA floats as they are needed) or the linear RGBA
+// pixels of the previous level
+struct Level {
+    uint32_t wid;
+    uint32_t ht;
+    float const *pixels;        // linear RGBA pixels; nullptr for the base image
+    Image2D const *img;         // the base image
+
+    // return row y as linear RGBA floats; scratch is storage for the conversion
+    float const *row (uint32_t y, float *scratch) const
+    {
+        if (this->pixels != nullptr) {
+            return this->pixels + 4 * size_t(y) * this->wid;
+        }
+        size_t rowBytes = this->img->nBytes() / this->ht;
+        __detail::convertPixels (
+            this->wid,
+            static_cast<uint8_t const *>(this->img->data()) + y * rowBytes,
+            this->img->channels(), this->img->type(), this->img->isSRGB(),
+            scratch, Channels::RGBA, ChannelTy::F32, false);
+        return scratch;
+    }
+};
+
+// the number of source rows (or columns) that are filtered to produce the
+// destination row (or column) i, when the source has n rows (or columns) and
+// the destination has m.  Each destination pixel covers two source pixels,
+// except that the last one also covers the last source pixel when n is odd.
+static inline uint32_t filterWidth (uint32_t i, uint32_t n, uint32_t m)
+{
+    if (n == 1) {
+        return 1;
+    } else if ((i == m - 1) && (n & 1)) {
+        return 3;
+    } else {
+        return 2;
+    }
+}
+
+// compute destination row y from the source level
+static void filterRow (
+    Level const &src, uint32_t y,
+    uint32_t dw, uint32_t dh,
+    float *scratch, float *dst)
+{
+    uint32_t sw = src.wid;
+    uint32_t nRows = filterWidth (y, src.ht, dh);
+
+  // sum the source rows; the first 4*sw floats of scratch are the sum and the
+  // rest is used to convert base-image rows
+    float *vsum = scratch;
+    float *cvt = scratch + 4 * size_t(sw);
+    float const *r = src.row (2*y, cvt);
+    for (uint32_t x = 0;  x < sw;  x++) {
+        store (vsum + 4*x, load (r + 4*x));
+    }
+    for (uint32_t i = 1;  i < nRows;  i++) {
+        r = src.row (2*y + i, cvt);
+        for (uint32_t x = 0;  x < sw;  x++) {
+            store (vsum + 4*x, add (load (vsum + 4*x), load (r + 4*x)));
+        }
+    }
+
+  // sum adjacent columns and normalize
+    float s2 = 1.0f / float(2 * nRows);
+    for (uint32_t x = 0;  x < dw;  x++) {
+        uint32_t nCols = filterWidth (x, sw, dw);
+        float const *p = vsum + 8*x;
+        Pixel sum = load (p);
+        if (nCols == 1) {
+            sum = scale (sum, 1.0f / float(nRows));
+        } else if (nCols == 2) {
+            sum = scale (add (sum, load (p + 4)), s2);
+        } else {
+            sum = scale (add (add (sum, load (p + 4)), load (p + 8)), 1.0f / float(3 * nRows));
+        }
+        store (dst + 4*x, sum);
+    }
+}
+
+// renormalize a row of normal vectors, which are encoded as 0.5*n + 0.5 in
+// the RGB channels
+static void renormalizeRow (uint32_t n, float *row)
+{
+    for (uint32_t x = 0;  x < n;  x++) {
+        float *p = row + 4*x;
+        glm::vec3 v = 2.0f * glm::vec3(p[0], p[1], p[2]) - 1.0f;
+        float len = glm::length(v);
+        v = (len > 0.0f) ? v / len : glm::vec3(0.0f, 0.0f, 1.0f);
+        p[0] = 0.5f * v.x + 0.5f;
+        p[1] = 0.5f * v.y + 0.5f;
+        p[2] = 0.5f * v.z + 0.5f;
+    }
+}
+
+std::vector<Image2D *> mipmapLevels (Image2D const *img, bool normalMap)
+{
+    ThreadPool &pool = ThreadPool::shared();
+    std::vector<Image2D *> levels;
+    std::vector<float> prev, cur;
+
+    Level src = { uint32_t(img->width()), uint32_t(img->height()), nullptr, img };
+    while ((src.wid > 1) || (src.ht > 1)) {
+        uint32_t dw = std::max(src.wid >> 1, 1u);
+        uint32_t dh = std::max(src.ht >> 1, 1u);
+        cur.resize (4 * size_t(dw) * dh);
+        Image2D *dst = img->isSRGB()
+            ? new Image2D (dw, dh, img->channels(), img->type())
+            : new DataImage2D (dw, dh, img->channels(), img->type());
+        size_t dstRowBytes = dst->nBytes() / dh;
+
+      // each task computes a band of rows in linear RGBA and then converts
+      // them to the image's format
+        size_t nBands = (dh + kBandSz - 1) / kBandSz;
+        pool.parallelFor (nBands, [&](size_t b) {
+            std::vector<float> scratch (8 * size_t(src.wid));
+            uint32_t y0 = uint32_t(b) * kBandSz;
+            uint32_t y1 = std::min(y0 + kBandSz, dh);
+            for (uint32_t y = y0;  y < y1;  y++) {
+                float *row = cur.data() + 4 * size_t(y) * dw;
+                filterRow (src, y, dw, dh, scratch.data(), row);
+                if (normalMap) {
+                    renormalizeRow (dw, row);
+                }
+            }
+            __detail::convertPixels (
+                size_t(y1 - y0) * dw,
+                cur.data() + 4 * size_t(y0) * dw, Channels::RGBA, ChannelTy::F32, false,
+                static_cast<uint8_t *>(dst->data()) + y0 * dstRowBytes,
+                dst->channels(), dst->type(), dst->isSRGB());
+        });
+        levels.push_back (dst);
+
+      // the level that we just computed is the source for the next one
+        prev.swap (cur);
+        src = Level{ dw, dh, prev.data(), img };
+    }
+
+    return levels;
+}
+
+} // namespace cs237
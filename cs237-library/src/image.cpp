@@ -68,18 +68,12 @@ static void readData (png_struct *pngPtr, png_bytep data, png_size_t length)
     }
 }
 
-//! \brief helper function to read a PNG image from an input stream
-//! \param inS the input stream
-//! \param flip true if the rows of the image should be flipped to match OpenGL coordinates
-//! \param widOut output variable for the image width
-//! \param htOut output variable for the image height (nullptr for 1D images)
-//! \param fmtOut output variable for the channel format
-//! \param tyOut output variable for the channel representation type
-//! \param sRGBOut output variable set to true if the image should be interpreted as sRGB
-//! \return a pointer to the image data, or nullptr on error
-void *readPNG (
-    std::ifstream &inS, bool flip, uint32_t *widOut, uint32_t *htOut,
-    Channels *fmtOut, ChannelTy *tyOut, bool *sRGBOut)
+namespace __detail {
+
+// read a PNG image from an input stream into caller-supplied storage
+bool readPNG (
+    std::ifstream &inS, bool flip, bool addAlpha,
+    PNGDestFn const &dst, PNGInfo &info)
 {
   /* check PNG signature */
     unsigned char sig[8];
@@ -88,13 +82,13 @@ void *readPNG (
 #ifndef NDEBUG
         std::cerr << "readPNG: I/O error reading header" << std::endl;
 #endif
-        return nullptr;
+        return false;
     }
     if (png_sig_cmp(sig, 0, 8)) {
 #ifndef NDEBUG
         std::cerr << "readPNG: bogus header" << std::endl;
 #endif
-        return nullptr;
+        return false;
     }
 
   /* setup read structures */
@@ -103,7 +97,7 @@ void *readPNG (
 #ifndef NDEBUG
         std::cerr << "readPNG: error creating read_struct" << std::endl;
 #endif
-        return nullptr;
+        return false;
     }
     png_infop infoPtr = png_create_info_struct(pngPtr);
     if (infoPtr == nullptr) {
@@ -111,7 +105,7 @@ void *readPNG (
         std::cerr << "readPNG: error creating info_struct" << std::endl;
 #endif
         png_destroy_read_struct(&pngPtr, nullptr, nullptr);
-        return nullptr;
+        return false;
     }
     png_infop endPtr = png_create_info_struct(pngPtr);
     if (!endPtr) {
@@ -119,16 +113,18 @@ void *readPNG (
         std::cerr << "readPNG: error creating info_struct" << std::endl;
 #endif
         png_destroy_read_struct (&pngPtr, &infoPtr, nullptr);
-        return nullptr;
+        return false;
     }
 
-  /* error handler */
+  /* error handler; rowPtrs is volatile, since it is modified after the setjmp */
+    png_bytep *volatile rowPtrs = nullptr;
     if (setjmp (png_jmpbuf(pngPtr))) {
 #ifndef NDEBUG
         std::cerr << "readPNG: I/O error" << std::endl;
 #endif
         png_destroy_read_struct (&pngPtr, &infoPtr, &endPtr);
-        return nullptr;
+        delete[] rowPtrs;
+        return false;
     }
 
   /* set up input */
@@ -213,7 +209,7 @@ void *readPNG (
         std::cerr << "unknown color type " << colorType << std::endl;
 #endif
         png_destroy_read_struct (&pngPtr, &infoPtr, (png_infopp)0);
-        return nullptr;
+        return false;
     }
 
   /* sanity check the image dimensions: max size is 20k x 20k */
@@ -221,21 +217,36 @@ void *readPNG (
 #ifndef NDEBUG
         std::cerr << "readPNG: image too large" << std::endl;
 #endif
-        return nullptr;
+        png_destroy_read_struct (&pngPtr, &infoPtr, &endPtr);
+        return false;
     }
 
-  /* allocate image data */
-    int bytesPerRow = bytesPerPixel * width;
-    png_byte *img = (png_bytep) std::malloc (height * bytesPerRow);
+  /* expand three-channel images to four channels, since Vulkan prefers them */
+    if (addAlpha && (fmt == Channels::RGB)) {
+        png_set_filler (pngPtr, 0xffff, PNG_FILLER_AFTER);
+        fmt = Channels::RGBA;
+        bytesPerPixel = (bytesPerPixel / 3) * 4;
+    }
+
+    info.wid = width;
+    info.ht = height;
+    info.chans = fmt;
+    info.type = ty;
+    info.sRGB = sRGB;
+    info.nBytes = size_t(height) * size_t(bytesPerPixel) * size_t(width);
+
+  /* get the storage for the image data */
+    size_t bytesPerRow = bytesPerPixel * width;
+    png_byte *img = static_cast<png_byte *>(dst(info));
     if (img == nullptr) {
 #ifndef NDEBUG
         std::cerr << "readPNG: unable to allocate image" << std::endl;
 #endif
         png_destroy_read_struct (&pngPtr, &infoPtr, &endPtr);
-        return nullptr;
+        return false;
     }
 
-    png_bytepp rowPtrs = new png_bytep[height];
+    rowPtrs = new png_bytep[height];
     if (flip) {
       /* setup row pointers so that the texture has OpenGL orientation */
         for (png_uint_32 i = 1;  i <= height;  i++)
@@ -253,21 +264,27 @@ void *readPNG (
     png_destroy_read_struct (&pngPtr, &infoPtr, &endPtr);
     delete[] rowPtrs;
 
-    if ((htOut == nullptr) && (height > 1)) {
-        width *= height;
-    }
+    return true;
 
-    *widOut = width;
-    if (htOut != nullptr) *htOut = height;
-    *fmtOut = fmt;
-    *tyOut = ty;
-    if (sRGBOut != nullptr) {
-        *sRGBOut = sRGB;
-    }
+} /* readPNG */
 
-    return img;
+//! \brief read a PNG image into malloc'd storage
+//! \return the image data or nullptr on error
+static void *readPNG (std::ifstream &inS, bool flip, PNGInfo &info)
+{
+    void *data = nullptr;
+    auto alloc = [&data](PNGInfo const &info) {
+        data = std::malloc(info.nBytes);
+        return data;
+    };
+    if (! readPNG (inS, flip, true, alloc, info)) {
+        std::free (data);
+        return nullptr;
+    }
+    return data;
+}
 
-} /* readPNG */
+} // namespace __detail
 
 //! \brief write function wrapper around an ostream.
 static void writeData (png_struct *pngPtr, png_bytep data, png_size_t length)
@@ -481,7 +498,7 @@ VkFormat toVkFormat (Channels chans, ChannelTy ty, bool isRGB)
 /***** virtual base class __detail::ImageBase member functions *****/
 
 ImageBase::ImageBase (uint32_t nd, Channels chans, ChannelTy ty, size_t npixels)
-  : _nDims(nd), _chans(chans), _type(ty),
+  : _nDims(nd), _chans(chans), _type(ty), _sRGB(false),
     _nBytes(numChannels(chans) * npixels * sizeOfType(ty))
 {
     this->_data = std::malloc(this->_nBytes);
@@ -506,54 +523,28 @@ size_t ImageBase::nBytesPerPixel () const
 
 void ImageBase::addAlphaChannel ()
 {
+    Channels chans;
     if (this->_chans == Channels::RGB) {
-        this->_chans = Channels::RGBA;
+        chans = Channels::RGBA;
     }
-    else if (this->_chans != Channels::BGR) {
-        this->_chans = Channels::BGRA;
+    else if (this->_chans == Channels::BGR) {
+        chans = Channels::BGRA;
     }
     else {
         return;
     }
 
-    switch (this->_type) {
-    case ChannelTy::U8: {
-            uint32_t nPixels = this->_nBytes / 3;
-            uint8_t *newImg = (uint8_t *) std::malloc (4 * nPixels);
-            uint8_t *dstP = newImg;
-            uint8_t *srcP = reinterpret_cast<uint8_t *>(this->_data);
-            for (int i = 0;  i < nPixels;  ++i) {
-                dstP[0] = srcP[0];
-                dstP[1] = srcP[1];
-                dstP[2] = srcP[2];
-                dstP[3] = 0xff;
-                dstP += 4;
-                srcP += 3;
-            }
-            std::free(this->_data);
-            this->_data = newImg;
-            this->_nBytes = 4 * nPixels;
-        } break;
-    case ChannelTy::U16: {
-            uint32_t nPixels = this->_nBytes / 6;
-            uint16_t *newImg = (uint16_t *) std::malloc (8 * nPixels);
-            uint16_t *dstP = newImg;
-            uint16_t *srcP = reinterpret_cast<uint16_t *>(this->_data);
-            for (int i = 0;  i < nPixels;  ++i) {
-                dstP[0] = srcP[0];
-                dstP[1] = srcP[1];
-                dstP[2] = srcP[2];
-                dstP[3] = 0xffff;
-                dstP += 4;
-                srcP += 3;
-            }
-            std::free(this->_data);
-            this->_data = newImg;
-            this->_nBytes = 8 * nPixels;
-        } break;
-    default:
-        ERROR ("unsupported channel type");
-    }
+    size_t nPixels = this->_nBytes / (3 * sizeOfType(this->_type));
+    size_t nBytes = 4 * nPixels * sizeOfType(this->_type);
+    void *newImg = std::malloc (nBytes);
+    convertPixels (
+        nPixels,
+        this->_data, this->_chans, this->_type, this->_sRGB,
+        newImg, chans, this->_type, this->_sRGB);
+    std::free(this->_data);
+    this->_data = newImg;
+    this->_nBytes = nBytes;
+    this->_chans = chans;
 
 }
 
@@ -578,20 +569,19 @@ Image1D::Image1D (std::string const &file)
         exit (1);
     }
 
-    this->_data = readPNG(
-        inS, false, &this->_wid, nullptr, &this->_chans, &this->_type, &this->_sRGB);
+    __detail::PNGInfo info;
+    this->_data = __detail::readPNG(inS, false, info);
     if (this->_data == nullptr) {
         inS.close();
         std::cerr << "Image2D::Image1D: unable to load image file \"" << file << "\"" << std::endl;
         exit (1);
     }
-    int nChannels = numChannels(this->_chans);
-    this->_nBytes = nChannels * this->_wid * sizeOfType(this->_type);
-
-    // because Vulkan prefers 4-channel images
-    if (nChannels == 3) {
-        this->addAlphaChannel();
-    }
+    // a multi-row image is treated as a single row
+    this->_wid = info.wid * info.ht;
+    this->_chans = info.chans;
+    this->_type = info.type;
+    this->_sRGB = info.sRGB;
+    this->_nBytes = info.nBytes;
 
     inS.close();
 }
@@ -620,7 +610,10 @@ bool Image1D::write (const char *file)
 
 Image2D::Image2D (uint32_t wid, uint32_t ht, Channels chans, ChannelTy ty)
     : __detail::ImageBase (2, chans, ty, wid * ht), _wid(wid), _ht(ht)
-{ }
+{
+  // by default, 2D images hold color data (see DataImage2D)
+    this->_sRGB = true;
+}
 
 Image2D::Image2D (std::string const &file, bool flip)
     : __detail::ImageBase (2)
@@ -634,40 +627,41 @@ Image2D::Image2D (std::string const &file, bool flip)
         exit (1);
     }
 
-    this->_data = readPNG(
-        inS, flip, &this->_wid, &this->_ht, &this->_chans, &this->_type, &this->_sRGB);
-    if (this->_data == nullptr) {
+    if (! this->_read (inS, flip)) {
         inS.close();
         std::cerr << "Image2D::Image2D: unable to load image file \"" << file << "\"" << std::endl;
         exit (1);
     }
-    int nChannels = numChannels(this->_chans);
-    this->_nBytes = nChannels * this->_wid * this->_ht * sizeOfType(this->_type);
 
     inS.close();
-
-    // because Vulkan prefers 4-channel images
-    if (nChannels == 3) {
-        this->addAlphaChannel();
-    }
 }
 
 Image2D::Image2D (std::ifstream &inS, bool flip)
     : __detail::ImageBase (2)
 {
-    this->_data = readPNG(
-        inS, flip, &this->_wid, &this->_ht, &this->_chans, &this->_type, &this->_sRGB);
-    if (this->_data == nullptr) {
+    if (! this->_read (inS, flip)) {
         std::cerr << "Image2D::Image2D: unable to load 2D image" << std::endl;
         exit (1);
     }
-    int nChannels = numChannels(this->_chans);
-    this->_nBytes = nChannels * this->_wid * this->_ht * sizeOfType(this->_type);
+}
 
-    // because Vulkan prefers 4-channel images
-    if (nChannels == 3) {
-        this->addAlphaChannel();
+// read the image from a PNG stream; three-channel images are expanded to four
+// channels as they are decoded, because Vulkan prefers 4-channel images
+bool Image2D::_read (std::ifstream &inS, bool flip)
+{
+    __detail::PNGInfo info;
+    this->_data = __detail::readPNG(inS, flip, info);
+    if (this->_data == nullptr) {
+        return false;
     }
+    this->_wid = info.wid;
+    this->_ht = info.ht;
+    this->_chans = info.chans;
+    this->_type = info.type;
+    this->_sRGB = info.sRGB;
+    this->_nBytes = info.nBytes;
+
+    return true;
 }
 
 // write the image to a file
@@ -0,0 +1,66 @@
+/*! \file json-bind.cpp
+ *
+ * Support code for the typed decoding of JSON files.
+ *
+ * CMSC 23700 Autumn 2022.
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#include "json-bind.hpp"
+
+namespace json {
+
+/***** class Decoder member functions *****/
+
+bool Decoder::skip ()
+{
+    if (! this->_cursor.skip()) {
+        return this->typeError ("value", E_ERROR);
+    }
+    return true;
+}
+
+bool Decoder::error (std::string const &msg)
+{
+  // we only report the first error
+    if (! this->_err.empty()) {
+        return false;
+    }
+
+    std::string path = "$";
+    for (auto const &elem : this->_path) {
+        if (elem.index < 0) {
+            path += ".";
+            path += elem.key;
+        } else {
+            path += "[" + std::to_string(elem.index) + "]";
+        }
+    }
+    this->_err = path + ": " + msg + " at line " + std::to_string(this->_cursor.line());
+
+    return false;
+}
+
+bool Decoder::typeError (const char *expected, Event ev)
+{
+    static const char *kFound[] = {
+            "object", "'}'", "array", "']'", "field label", "integer", "real number",
+            "string", "boolean", "null", "end of input", "syntax error"
+        };
+
+    if (ev == E_ERROR) {
+        const char *msg = this->_cursor.errorMessage();
+        return this->error (std::string("syntax error (") + (msg ? msg : "unknown") + ")");
+    }
+    else {
+        return this->error (std::string("expected ") + expected + " but found " + kFound[ev]);
+    }
+}
+
+} // namespace json
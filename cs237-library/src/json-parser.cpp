@@ -15,457 +15,924 @@
  * All rights reserved.
  */
 
+#include "cs237.hpp"
 #include "json.hpp"
 #include <iostream>
 #include <fstream>
 #include <cctype>
+#include <cstring>
+#include <cstdlib>
+#include <charconv>
+#include <strings.h>
+#include <new>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#  include <immintrin.h>
+#elif defined(__ARM_NEON)
+#  include <arm_neon.h>
+#endif
 
 namespace json {
 
+static inline bool isDigit (char c) { return ('0' <= c) && (c <= '9'); }
 
-class Input {
-  public:
-    Input (std::string filename);
-    ~Input () { delete this->_buffer; }
+/***** Character scanning *****/
 
+// Most of the cursor's time is spent skipping whitespace and finding the end of
+// strings.  The following functions examine kBlockSz characters at a time using
+// the vector instructions of the target (AVX2, SSE2, or NEON), with a scalar
+// loop for the tail of the buffer and for targets without vector support.  The
+// block functions return the index of the first interesting character in the
+// block, or kBlockSz if there is none.
 
-    Input const &operator++ (int _unused) {
-        if (this->_buffer[this->_i++] == '\n') this->_lnum++;
-        return *this;
-    }
-    Input const &operator += (int n) { this->_i += n;  return *this; }
-    const char *operator() () const { return &(this->_buffer[this->_i]); }
-    char operator[] (int j) const { return this->_buffer[this->_i + j]; }
-    char operator* () const { return this->_buffer[this->_i]; }
-    int avail () const { return this->_len - this->_i; }
-    bool eof () const { return this->_i >= this->_len; }
+// JSON whitespace (which does not include '\v' and '\f')
+static inline bool isSpace (char c)
+{
+    return (c == ' ') || (c == '\n') || (c == '\r') || (c == '\t');
+}
 
-    void error (std::string msg)
-    {
-#ifndef NDEBUG
-        std::cerr << "json::parseFile(" << this->_file << "): " << msg
-            << " at line " << this->_lnum << std::endl;
-        std::cerr << "    input = \"";
-        int n = this->avail();
-        if (20 < n) n = 20;
-        for (int i = 0;  (i < 20);  i++) {
-            if (isprint(this->_buffer[this->_i+i]))
-                std::cerr << this->_buffer[this->_i+i];
-            else
-                std::cerr << ".";
-        }
-        std::cerr << " ...\n" << std::endl;
-#endif
-    }
+// characters that end the fast scan of a string: '"', '\\', and the control
+// characters (tabs are allowed in strings, but they are handled by the slow path)
+static inline bool isStringSpecial (unsigned char c)
+{
+    return (c == '"') || (c == '\\') || (c < 0x20) || (c == 0x7f);
+}
 
-  private:
-    std::string _file;
-    char        *_buffer;
-    int         _i;     // character index
-    int         _lnum;  // current line number
-    int         _len;   // buffer size
+#if defined(__AVX2__)
 
-};
+static const int kBlockSz = 32;
 
-Input::Input (std::string filename)
-    : _file(filename), _buffer(nullptr), _i(0), _lnum(0), _len(0)
+static inline int firstNonSpace (const char *p)
 {
-  // open the json file for reading
-    std::ifstream inS(filename, std::ios::in);
-    if (inS.fail())
-        return;
+    __m256i v = _mm256_loadu_si256 (reinterpret_cast<const __m256i *>(p));
+    __m256i ws = _mm256_or_si256 (
+        _mm256_or_si256 (
+            _mm256_cmpeq_epi8 (v, _mm256_set1_epi8(' ')),
+            _mm256_cmpeq_epi8 (v, _mm256_set1_epi8('\n'))),
+        _mm256_or_si256 (
+            _mm256_cmpeq_epi8 (v, _mm256_set1_epi8('\r')),
+            _mm256_cmpeq_epi8 (v, _mm256_set1_epi8('\t'))));
+    uint32_t m = ~static_cast<uint32_t>(_mm256_movemask_epi8 (ws));
+    return (m == 0) ? kBlockSz : __builtin_ctz(m);
+}
 
-  // figure out the size of the file
-    inS.seekg (0, inS.end);
-    int length = inS.tellg();
-    inS.seekg (0, inS.beg);
+static inline int firstStringSpecial (const char *p)
+{
+    __m256i v = _mm256_loadu_si256 (reinterpret_cast<const __m256i *>(p));
+    __m256i ctl = _mm256_cmpeq_epi8 (_mm256_max_epu8 (v, _mm256_set1_epi8(0x1f)), _mm256_set1_epi8(0x1f));
+    __m256i sp = _mm256_or_si256 (
+        _mm256_or_si256 (
+            _mm256_cmpeq_epi8 (v, _mm256_set1_epi8('"')),
+            _mm256_cmpeq_epi8 (v, _mm256_set1_epi8('\\'))),
+        _mm256_or_si256 (ctl, _mm256_cmpeq_epi8 (v, _mm256_set1_epi8(0x7f))));
+    uint32_t m = static_cast<uint32_t>(_mm256_movemask_epi8 (sp));
+    return (m == 0) ? kBlockSz : __builtin_ctz(m);
+}
 
-  // read length bytes
-    this->_lnum = 1;
-    this->_buffer = new char[length];
-    inS.read (this->_buffer, length);
+#elif defined(__SSE2__)
 
-    if (inS.fail()) {
-        delete this->_buffer;
-        this->_buffer = 0;
-        return;
+static const int kBlockSz = 32;
+
+static inline __m128i spaceChars (__m128i v)
+{
+    return _mm_or_si128 (
+        _mm_or_si128 (
+            _mm_cmpeq_epi8 (v, _mm_set1_epi8(' ')),
+            _mm_cmpeq_epi8 (v, _mm_set1_epi8('\n'))),
+        _mm_or_si128 (
+            _mm_cmpeq_epi8 (v, _mm_set1_epi8('\r')),
+            _mm_cmpeq_epi8 (v, _mm_set1_epi8('\t'))));
+}
+
+static inline __m128i specialChars (__m128i v)
+{
+    __m128i ctl = _mm_cmpeq_epi8 (_mm_max_epu8 (v, _mm_set1_epi8(0x1f)), _mm_set1_epi8(0x1f));
+    return _mm_or_si128 (
+        _mm_or_si128 (
+            _mm_cmpeq_epi8 (v, _mm_set1_epi8('"')),
+            _mm_cmpeq_epi8 (v, _mm_set1_epi8('\\'))),
+        _mm_or_si128 (ctl, _mm_cmpeq_epi8 (v, _mm_set1_epi8(0x7f))));
+}
+
+static inline int firstNonSpace (const char *p)
+{
+    __m128i lo = _mm_loadu_si128 (reinterpret_cast<const __m128i *>(p));
+    __m128i hi = _mm_loadu_si128 (reinterpret_cast<const __m128i *>(p + 16));
+    uint32_t m = ~(static_cast<uint32_t>(_mm_movemask_epi8 (spaceChars (lo)))
+        | (static_cast<uint32_t>(_mm_movemask_epi8 (spaceChars (hi))) << 16));
+    return (m == 0) ? kBlockSz : __builtin_ctz(m);
+}
+
+static inline int firstStringSpecial (const char *p)
+{
+    __m128i lo = _mm_loadu_si128 (reinterpret_cast<const __m128i *>(p));
+    __m128i hi = _mm_loadu_si128 (reinterpret_cast<const __m128i *>(p + 16));
+    uint32_t m = static_cast<uint32_t>(_mm_movemask_epi8 (specialChars (lo)))
+        | (static_cast<uint32_t>(_mm_movemask_epi8 (specialChars (hi))) << 16);
+    return (m == 0) ? kBlockSz : __builtin_ctz(m);
+}
+
+#elif defined(__ARM_NEON)
+
+static const int kBlockSz = 16;
+
+// NEON does not have a movemask instruction, so we narrow the comparison
+// result to a 64-bit mask with four bits per character
+static inline int firstSet (uint8x16_t m)
+{
+    uint64_t bits = vget_lane_u64 (
+        vreinterpret_u64_u8 (vshrn_n_u16 (vreinterpretq_u16_u8 (m), 4)), 0);
+    return (bits == 0) ? kBlockSz : (__builtin_ctzll(bits) >> 2);
+}
+
+static inline int firstNonSpace (const char *p)
+{
+    uint8x16_t v = vld1q_u8 (reinterpret_cast<const uint8_t *>(p));
+    uint8x16_t ws = vorrq_u8 (
+        vorrq_u8 (vceqq_u8 (v, vdupq_n_u8(' ')), vceqq_u8 (v, vdupq_n_u8('\n'))),
+        vorrq_u8 (vceqq_u8 (v, vdupq_n_u8('\r')), vceqq_u8 (v, vdupq_n_u8('\t'))));
+    return firstSet (vmvnq_u8 (ws));
+}
+
+static inline int firstStringSpecial (const char *p)
+{
+    uint8x16_t v = vld1q_u8 (reinterpret_cast<const uint8_t *>(p));
+    uint8x16_t sp = vorrq_u8 (
+        vorrq_u8 (vceqq_u8 (v, vdupq_n_u8('"')), vceqq_u8 (v, vdupq_n_u8('\\'))),
+        vorrq_u8 (vcltq_u8 (v, vdupq_n_u8(0x20)), vceqq_u8 (v, vdupq_n_u8(0x7f))));
+    return firstSet (sp);
+}
+
+#else
+
+static const int kBlockSz = 8;
+
+static inline int firstNonSpace (const char *p)
+{
+    for (int i = 0;  i < kBlockSz;  i++) {
+        if (! isSpace(p[i])) return i;
+    }
+    return kBlockSz;
+}
+
+static inline int firstStringSpecial (const char *p)
+{
+    for (int i = 0;  i < kBlockSz;  i++) {
+        if (isStringSpecial(p[i])) return i;
     }
+    return kBlockSz;
+}
+
+#endif
 
-    this->_len = length;
+// return the position of the first non-whitespace character at or after pos
+// (len if there is none)
+static inline size_t skipSpace (const char *buf, size_t pos, size_t len)
+{
+  // whitespace runs are often short (e.g., a single space after a ':'), so
+  // we check a couple of characters before switching to the block scan
+    if ((pos < len) && !isSpace(buf[pos])) return pos;
+    if ((++pos < len) && !isSpace(buf[pos])) return pos;
+    while (pos + kBlockSz <= len) {
+        int i = firstNonSpace (buf + pos);
+        pos += i;
+        if (i < kBlockSz) return pos;
+    }
+    while ((pos < len) && isSpace(buf[pos])) {
+        pos++;
+    }
+    return pos;
 }
 
-// forward decls
-static bool skipWhitespace (Input &datap);
-static Value *parse (Input &datap);
+// return the position of the first '"', '\\', or control character at or after
+// pos (len if there is none)
+static inline size_t scanString (const char *buf, size_t pos, size_t len)
+{
+  // labels are usually short, so we check the first few characters one at a
+  // time before switching to the block scan
+    for (size_t end = std::min(pos + 8, len);  pos < end;  pos++) {
+        if (isStringSpecial(buf[pos])) return pos;
+    }
+    while (pos + kBlockSz <= len) {
+        int i = firstStringSpecial (buf + pos);
+        pos += i;
+        if (i < kBlockSz) return pos;
+    }
+    while ((pos < len) && !isStringSpecial(buf[pos])) {
+        pos++;
+    }
+    return pos;
+}
 
-// parse a json file; this returns nullptr if there is a parsing error
-Value *parseFile (std::string filename)
+// the parts of the text of a JSON number
+struct NumberText {
+    const char *start;          //!< the first character of the number
+    const char *end;            //!< the character following the number
+    const char *intPart;        //!< the digits of the integer part
+    const char *intEnd;
+    const char *fracPart;       //!< the digits of the fraction (empty if none)
+    const char *fracEnd;
+    int exp10;                  //!< the exponent (clamped to +/-100000)
+    bool neg;                   //!< true if there is a leading minus sign
+};
+
+// convert a JSON real number to a correctly-rounded double.  If the number has
+// at most 19 digits, then we accumulate them in an integer; if the integer fits
+// in the 53-bit mantissa of a double and the power of ten is at most 22, then
+// both the mantissa and the power of ten are exact and the result of the single
+// multiplication or division is correctly rounded (Clinger's fast path).
+// Otherwise, we fall back to the library's conversion.
+static double toDouble (NumberText const &num)
+{
+    static const double kPow10[] = {
+            1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+    int nFrac = num.fracEnd - num.fracPart;
+    if ((num.intEnd - num.intPart) + nFrac <= 19) {
+        uint64_t mant = 0;
+        for (const char *p = num.intPart;  p < num.intEnd;  p++) {
+            mant = 10 * mant + (*p - '0');
+        }
+        for (const char *p = num.fracPart;  p < num.fracEnd;  p++) {
+            mant = 10 * mant + (*p - '0');
+        }
+        int exp10 = num.exp10 - nFrac;
+        if (mant == 0) {
+            return num.neg ? -0.0 : 0.0;
+        }
+        else if ((mant <= (uint64_t(1) << 53)) && (-22 <= exp10) && (exp10 <= 22)) {
+            double d = static_cast<double>(mant);
+            if (exp10 < 0) {
+                d /= kPow10[-exp10];
+            } else {
+                d *= kPow10[exp10];
+            }
+            return num.neg ? -d : d;
+        }
+    }
+
+#ifdef __cpp_lib_to_chars
+    double d;
+    auto res = std::from_chars (num.start, num.end, d);
+    if (res.ec == std::errc()) {
+        return d;
+    }
+  // the number is out of range (which leaves d unset); strtod returns
+  // +/-HUGE_VAL on overflow and the nearest subnormal or +/-0 on underflow
+    return std::strtod (num.start, nullptr);
+#else
+  // libc++ does not support from_chars for floating-point types; the number
+  // is followed by a non-numeric character, so strtod stops at num.end
+    return std::strtod (num.start, nullptr);
+#endif
+}
+
+// read a file into a buffer followed by a NUL character; the buffer is allocated
+// by the alloc function.  Returns nullptr on failure.
+template <typename Alloc>
+static char *readFile (std::string const &filename, size_t &len, Alloc alloc)
 {
   // open the json file for reading
-    Input datap(filename);
-    if (datap.eof()) {
+    std::ifstream inS(filename, std::ios::in | std::ios::binary);
+    if (inS.fail()) {
 #ifndef NDEBUG
         std::cerr << "json::parseFile: unable to read \"" << filename << "\"" << std::endl;
 #endif
         return nullptr;
     }
 
-    if (! skipWhitespace (datap)) {
+  // figure out the size of the file
+    inS.seekg (0, inS.end);
+    len = inS.tellg();
+    inS.seekg (0, inS.beg);
+
+  // read len bytes
+    char *buffer = alloc (len + 1);
+    inS.read (buffer, len);
+    if (inS.fail()) {
+#ifndef NDEBUG
+        std::cerr << "json::parseFile: unable to read \"" << filename << "\"" << std::endl;
+#endif
         return nullptr;
     }
+    buffer[len] = '\0';
 
-    Value *value = parse (datap);
+    return buffer;
+}
 
-    return value;
+/***** class Cursor member functions *****/
 
-}
+Cursor::Cursor ()
+  : _file(), _buffer(nullptr), _pos(0), _len(0), _owned(false),
+    _state(S_ERROR), _stack(), _event(E_ERROR), _str(), _escapes(false),
+    _scratch(), _int(0), _real(0.0), _bool(false), _errMsg(nullptr)
+{ }
 
-static bool skipWhitespace (Input &datap)
+Cursor::~Cursor ()
 {
-    while ((! datap.eof()) && isspace(*datap))
-        datap++;
+    if (this->_owned) {
+        delete[] this->_buffer;
+    }
+}
 
-    if (datap.eof()) {
-        datap.error("unexpected eof");
+bool Cursor::open (std::string const &filename)
+{
+    size_t len;
+    char *buffer = readFile (filename, len, [](size_t n) { return new char[n]; });
+    if (buffer == nullptr) {
         return false;
     }
-    else
-        return true;
+    this->_init (filename, buffer, len);
+    this->_owned = true;
+
+    return true;
 }
 
-static bool extractString (Input &datap, std::string &str)
+void Cursor::_init (std::string const &file, const char *buf, size_t len)
 {
-    str = "";
+    if (this->_owned) {
+        delete[] this->_buffer;
+    }
+    this->_file = file;
+    this->_buffer = buf;
+    this->_pos = 0;
+    this->_len = len;
+    this->_owned = false;
+    this->_state = S_VALUE;
+    this->_stack.clear();
+    this->_event = E_ERROR;
+    this->_errMsg = nullptr;
+}
 
-    if (*datap != '\"')
-        return false;
-    datap++;
+int Cursor::line () const
+{
+  // we only need the line number for error messages, so we compute it here
+  // instead of tracking it while scanning
+    return 1 + std::count (this->_buffer, this->_buffer + this->_pos, '\n');
+}
 
-    while (! datap.eof()) {
-        // Save the char so we can change it if need be
-        char nextChar = *datap;
+Event Cursor::_error (const char *msg)
+{
+#ifndef NDEBUG
+    std::cerr << "json::parseFile(" << this->_file << "): " << msg
+        << " at line " << this->line() << std::endl;
+    std::cerr << "    input = \"";
+    size_t n = std::min(this->_len - this->_pos, size_t(20));
+    for (size_t i = 0;  i < n;  i++) {
+        if (isprint(this->_buffer[this->_pos+i]))
+            std::cerr << this->_buffer[this->_pos+i];
+        else
+            std::cerr << ".";
+    }
+    std::cerr << " ...\n" << std::endl;
+#endif
+    this->_errMsg = msg;
+    this->_state = S_ERROR;
+    return (this->_event = E_ERROR);
+}
 
-        // Escaping something?
-        if (nextChar == '\\') {
-            // Move over the escape char
-            datap++;
-            // Deal with the escaped char
-            switch (*datap) {
-                case '"': nextChar = '"'; break;
-                case '\\': nextChar = '\\'; break;
-                case '/': nextChar = '/'; break;
-                case 'b': nextChar = '\b'; break;
-                case 'f': nextChar = '\f'; break;
-                case 'n': nextChar = '\n'; break;
-                case 'r': nextChar = '\r'; break;
-                case 't': nextChar = '\t'; break;
-                case 'u': /* no UNICODE support */
-                // By the spec, only the above cases are allowed
-                default:
-                    datap.error("invalid escape sequence in string");
-                    return false;
+bool Cursor::_skipWhitespace ()
+{
+    this->_pos = skipSpace (this->_buffer, this->_pos, this->_len);
+
+    return (this->_pos < this->_len);
+}
+
+Event Cursor::next ()
+{
+    while (true) {
+        switch (this->_state) {
+        case S_DONE:
+            return (this->_event = E_END);
+        case S_ERROR:
+            return (this->_event = E_ERROR);
+        case S_AFTER_VALUE:
+            if (this->_stack.empty()) {
+              // we ignore anything that follows the top-level value
+                this->_state = S_DONE;
+                continue;
             }
+            if (! this->_skipWhitespace()) {
+                return this->_error ("unexpected eof");
+            }
+            if (this->_buffer[this->_pos] == ',') {
+                this->_pos++;
+                this->_state = (this->_stack.back() == '{') ? S_KEY : S_VALUE;
+                continue;
+            }
+            return this->_endContainer();
+        case S_OBJ_START:
+            if (! this->_skipWhitespace()) {
+                return this->_error ("unexpected eof");
+            }
+            if (this->_buffer[this->_pos] == '}') {
+                return this->_endContainer();
+            }
+            return this->_scanKey();
+        case S_KEY:
+            if (! this->_skipWhitespace()) {
+                return this->_error ("unexpected eof");
+            }
+            return this->_scanKey();
+        case S_ARR_START:
+            if (! this->_skipWhitespace()) {
+                return this->_error ("unexpected eof");
+            }
+            if (this->_buffer[this->_pos] == ']') {
+                return this->_endContainer();
+            }
+            return this->_scanValue();
+        case S_VALUE:
+            if (! this->_skipWhitespace()) {
+                return this->_error ("unexpected eof");
+            }
+            return this->_scanValue();
         }
-      // End of the string?
-        else if (nextChar == '"') {
-            datap++;
-            str.reserve(); // Remove unused capacity
-            return true;
-        }
-      // Disallowed char?
-        else if (! isprint(nextChar) && (nextChar != '\t')) {
-          // SPEC Violation: Allow tabs due to real world cases
-            datap.error("invalid character in string");
+    }
+}
+
+bool Cursor::skip ()
+{
+    if ((this->_event != E_START_OBJECT) && (this->_event != E_START_ARRAY)) {
+        return (this->_event != E_ERROR);
+    }
+    size_t depth = this->_stack.size();
+    while (this->_stack.size() >= depth) {
+        if (this->next() == E_ERROR) {
             return false;
         }
-      // Add the next char
-        str += nextChar;
-      // Move on
-        datap++;
     }
-
-  // If we're here, the string ended incorrectly
-    return false;
+    return true;
 }
 
-static int64_t parseInt (Input &datap)
+// close an object or array; the current character should be the matching
+// '}' or ']'
+Event Cursor::_endContainer ()
 {
-    int64_t n = 0;
-    while (*datap != 0 && isdigit(*datap)) {
-        n = n * 10 + (*datap - '0');
-        datap++;
+    char c = this->_buffer[this->_pos];
+    if (this->_stack.back() == '{') {
+        if (c != '}') {
+            return this->_error ("expected ','");
+        }
+        this->_event = E_END_OBJECT;
     }
-
-    return n;
+    else {
+        if (c != ']') {
+            return this->_error ("expected ','");
+        }
+        this->_event = E_END_ARRAY;
+    }
+    this->_pos++;
+    this->_stack.pop_back();
+    this->_state = S_AFTER_VALUE;
+    return this->_event;
 }
 
-static double parseDecimal (Input &datap)
+Event Cursor::_scanKey ()
 {
-    double decimal = 0.0;
-    double factor = 0.1;
+    if (this->_buffer[this->_pos] != '"') {
+        return this->_error ("expected label");
+    }
+    if (this->_scanString(E_KEY) == E_ERROR) {
+        return E_ERROR;
+    }
 
-    while ((! datap.eof()) && isdigit(*datap)) {
-        int digit = (*datap - '0');
-        decimal = decimal + digit * factor;
-        factor *= 0.1;
-        datap++;
+  // Need a : now
+    if (! this->_skipWhitespace()) {
+        return this->_error ("unexpected eof");
+    }
+    if (this->_buffer[this->_pos] != ':') {
+        return this->_error ("expected ':'");
     }
-    return decimal;
+    this->_pos++;
+    this->_state = S_VALUE;
+
+    return E_KEY;
 }
 
-static Value *parse (Input &datap)
+Event Cursor::_scanValue ()
 {
-    if (datap.eof()) {
-        datap.error("unexpected end of file");
-        return nullptr;
+    const char *p = &this->_buffer[this->_pos];
+    size_t avail = this->_len - this->_pos;
+
+    this->_state = S_AFTER_VALUE;
+    switch (*p) {
+    case '"':
+        return this->_scanString (E_STRING);
+    case '{':
+        this->_pos++;
+        this->_stack.push_back ('{');
+        this->_state = S_OBJ_START;
+        return (this->_event = E_START_OBJECT);
+    case '[':
+        this->_pos++;
+        this->_stack.push_back ('[');
+        this->_state = S_ARR_START;
+        return (this->_event = E_START_ARRAY);
+    case '-': case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9':
+        return this->_scanNumber ();
+    default:
+        break;
     }
 
-  // Is it a string?
-    if (*datap == '"') {
-        std::string str;
-        if (! extractString(datap, str))
-            return nullptr;
-        else
-            return new String(str);
-    }
   // Is it a boolean?
-    else if ((datap.avail() >= 4) && strncasecmp(datap(), "true", 4) == 0) {
-        datap += 4;
-        return new Bool(true);
+    if ((avail >= 4) && strncasecmp(p, "true", 4) == 0) {
+        this->_pos += 4;
+        this->_bool = true;
+        return (this->_event = E_BOOL);
     }
-    else if ((datap.avail() >=  5) && strncasecmp(datap(), "false", 5) == 0) {
-        datap += 5;
-        return new Bool(false);
+    else if ((avail >=  5) && strncasecmp(p, "false", 5) == 0) {
+        this->_pos += 5;
+        this->_bool = false;
+        return (this->_event = E_BOOL);
     }
   // Is it a null?
-    else if ((datap.avail() >=  4) && strncasecmp(datap(), "null", 4) == 0) {
-        datap += 4;
-        return new Null();
-    }
-  // Is it a number?
-    else if (*datap == '-' || isdigit(*datap)) {
-      // Negative?
-        bool neg = *datap == '-';
-        bool isReal = false;
-        if (neg) datap++;
-
-        int64_t whole = 0;
-
-      // parse the whole part of the number - only if it wasn't 0
-        if (*datap == '0')
-            datap++;
-        else if (isdigit(*datap))
-            whole = parseInt(datap);
-        else {
-            datap.error("invalid number");
-            return nullptr;
-        }
+    else if ((avail >=  4) && strncasecmp(p, "null", 4) == 0) {
+        this->_pos += 4;
+        return (this->_event = E_NULL);
+    }
+  // Ran out of possibilites, it's bad!
+    else {
+        return this->_error ("bogus input");
+    }
+}
 
-        double r;
+// scan a string; the result points into the input buffer if the string does
+// not contain any escape sequences, otherwise the unescaped string is in the
+// scratch buffer.
+Event Cursor::_scanString (Event ev)
+{
+    this->_pos++;
+
+  // scan for the end of the string
+    const char *start = &this->_buffer[this->_pos];
+    bool escapes = false;
+    while ((this->_pos = scanString (this->_buffer, this->_pos, this->_len)) < this->_len) {
+        unsigned char nextChar = this->_buffer[this->_pos];
+        if (nextChar == '"') {
+            break;
+        }
+        else if (nextChar == '\\') {
+            escapes = true;
+          // skip the escaped character; we check it below
+            this->_pos++;
+            if (this->_pos >= this->_len) {
+                break;
+            }
+        }
+      // Disallowed char?
+        else if (nextChar != '\t') {
+          // SPEC Violation: Allow tabs due to real world cases
+            return this->_error ("invalid character in string");
+        }
+        this->_pos++;
+    }
+    if (this->_pos >= this->_len) {
+      // If we're here, the string ended incorrectly
+        return this->_error ("unterminated string");
+    }
+    const char *end = &this->_buffer[this->_pos];
+    this->_pos++;
 
-      // Could be a decimal now...
-        if (*datap == '.') {
-            r = (double)whole;
-            isReal = true;
-            datap++;
+    this->_escapes = escapes;
+    if (! escapes) {
+        this->_str = std::string_view(start, end - start);
+        return (this->_event = ev);
+    }
 
-            // Not get any digits?
-            if (! isdigit(*datap)) {
-                datap.error("invalid number");
-                return nullptr;
+  // unescape the string
+    std::string &s = this->_scratch;
+    s.clear();
+    for (const char *cp = start;  cp < end;  cp++) {
+        char nextChar = *cp;
+        if (nextChar == '\\') {
+            cp++;
+            switch (*cp) {
+                case '"': nextChar = '"'; break;
+                case '\\': nextChar = '\\'; break;
+                case '/': nextChar = '/'; break;
+                case 'b': nextChar = '\b'; break;
+                case 'f': nextChar = '\f'; break;
+                case 'n': nextChar = '\n'; break;
+                case 'r': nextChar = '\r'; break;
+                case 't': nextChar = '\t'; break;
+                case 'u': /* no UNICODE support */
+                // By the spec, only the above cases are allowed
+                default:
+                    this->_pos = cp - this->_buffer;
+                    return this->_error ("invalid escape sequence in string");
             }
+        }
+        s += nextChar;
+    }
+    this->_str = std::string_view(s);
 
-            // Find the decimal and sort the decimal place out
-            // Use parseDecimal as parseInt won't work with decimals less than 0.1
-            // thanks to Javier Abadia for the report & fix
-            double decimal = parseDecimal(datap);
+    return (this->_event = ev);
+}
 
-            // Save the number
-            r += decimal;
+Event Cursor::_scanNumber ()
+{
+  // split the number into its parts, checking the syntax as we go; the input
+  // is terminated by a NUL, so we do not need to check for the end of the buffer
+    NumberText num;
+    const char *p = &this->_buffer[this->_pos];
+    num.start = p;
+    num.neg = (*p == '-');
+    if (num.neg) p++;
+    num.intPart = p;
+    if (*p == '0') {
+        p++;
+    }
+    else if (isDigit(*p)) {
+        while (isDigit(*p)) p++;
+    }
+    else {
+        this->_pos = p - this->_buffer;
+        return this->_error ("invalid number");
+    }
+    num.intEnd = p;
+  // Could be a decimal now...
+    num.fracPart = num.fracEnd = p;
+    if (*p == '.') {
+        p++;
+        if (! isDigit(*p)) {
+            this->_pos = p - this->_buffer;
+            return this->_error ("invalid number");
         }
-
-        // Could be an exponent now...
-        if (*datap == 'E' || *datap == 'e') {
-            if (!isReal) {
-                r = (double)whole;
-                isReal = true;
+        num.fracPart = p;
+        while (isDigit(*p)) p++;
+        num.fracEnd = p;
+    }
+  // Could be an exponent now...
+    num.exp10 = 0;
+    bool hasExp = false;
+    if ((*p == 'E') || (*p == 'e')) {
+        p++;
+        bool negExp = (*p == '-');
+        if ((*p == '-') || (*p == '+')) p++;
+        if (! isDigit(*p)) {
+            this->_pos = p - this->_buffer;
+            return this->_error ("invalid number");
+        }
+        for (;  isDigit(*p);  p++) {
+            if (num.exp10 < 100000) num.exp10 = 10 * num.exp10 + (*p - '0');
+        }
+        if (negExp) num.exp10 = -num.exp10;
+        hasExp = true;
+    }
+    num.end = p;
+    this->_pos = p - this->_buffer;
+
+    if ((num.fracPart == num.fracEnd) && !hasExp) {
+      // an integer; 18 digits cannot overflow, otherwise we use from_chars
+      // to check for overflow
+        if (num.intEnd - num.intPart <= 18) {
+            int64_t n = 0;
+            for (const char *q = num.intPart;  q < num.intEnd;  q++) {
+                n = 10 * n + (*q - '0');
             }
-            datap++;
+            this->_int = num.neg ? -n : n;
+            return (this->_event = E_INTEGER);
+        }
+        std::from_chars_result res = std::from_chars (num.start, num.end, this->_int);
+        if (res.ec == std::errc()) {
+            return (this->_event = E_INTEGER);
+        }
+      // the integer does not fit in 64 bits, so we represent it as a real
+    }
 
-            // Check signage of expo
-            bool neg_expo = false;
-            if (*datap == '-' || *datap == '+') {
-                neg_expo = *datap == '-';
-                datap++;
-            }
+    this->_real = toDouble (num);
+    return (this->_event = E_REAL);
+}
 
-            // Not get any digits?
-            if (! isdigit(*datap)) {
-                datap.error("invalid number");
-                return nullptr;
-            }
+/***** Event-driven parsing *****/
 
-            // Sort the expo out
-            double expo = parseInt(datap);
-            for (double i = 0.0; i < expo; i++) {
-                r = neg_expo ? (r / 10.0) : (r * 10.0);
-            }
-        }
+bool parseFile (std::string const &filename, Handler &handler)
+{
+    Cursor cursor;
+    if (! cursor.open (filename)) {
+        return false;
+    }
 
-        if (isReal) {
-            return new Real (neg ? -r : r);
+    while (true) {
+        bool ok;
+        switch (cursor.next()) {
+        case E_START_OBJECT: ok = handler.startObject(); break;
+        case E_END_OBJECT: ok = handler.endObject(); break;
+        case E_START_ARRAY: ok = handler.startArray(); break;
+        case E_END_ARRAY: ok = handler.endArray(); break;
+        case E_KEY: ok = handler.key (cursor.string()); break;
+        case E_INTEGER: ok = handler.integer (cursor.intVal()); break;
+        case E_REAL: ok = handler.real (cursor.realVal()); break;
+        case E_STRING: ok = handler.string (cursor.string()); break;
+        case E_BOOL: ok = handler.boolean (cursor.boolVal()); break;
+        case E_NULL: ok = handler.null(); break;
+        case E_END: return true;
+        case E_ERROR: return false;
         }
-        else {
-            return new Integer (neg ? -whole : whole);
+        if (! ok) {
+            return false;
         }
     }
-  // An object?
-    else if (*datap == '{') {
-        Object *object = new Object();
 
-        datap++;
+}
 
-        while (!datap.eof()) {
-          // Whitespace at the start?
-            if (! skipWhitespace(datap)) {
-                delete object;
-                return nullptr;
-            }
+/***** Building documents *****/
 
-          // Special case: empty object
-            if ((object->size() == 0) && (*datap == '}')) {
-                datap++;
-                return object;
-            }
+// the parser builds the values of a document in the document's arena from the
+// events of a cursor.  The fields of objects and the elements of arrays are
+// accumulated on stacks that are shared by all of the objects/arrays being
+// parsed, and are copied into the arena once the size of the object/array is
+// known.
+class Parser {
+  public:
+    Parser (Cursor &cursor, cs237::Arena &arena) : _cursor(cursor), _arena(arena) { }
 
-          // We want a string now...
-            std::string name;
-// CHECK: do we need to look for "?
-            if (! extractString(datap, name)) {
-                datap.error("expected label");
-                delete object;
-                return nullptr;
-            }
+    Value *parse ();
 
-          // More whitespace?
-            if (! skipWhitespace(datap)) {
-                delete object;
-                return nullptr;
-            }
+  private:
+    Cursor &_cursor;
+    cs237::Arena &_arena;
+    std::vector<Object::Member> _fields;        // stack of object fields
+    std::vector<Value *> _elems;                // stack of array elements
+    std::vector<size_t> _bases;                 // the base of the open objects/arrays
+                                                // on their stack
+
+  // allocate a value in the arena
+    template <typename T, typename... Args>
+    T *_new (Args&&... args)
+    {
+        return new (this->_arena.alloc(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
 
-          // Need a : now
-            if (*datap != ':') {
-                datap.error("expected ':'");
-                delete object;
-                return nullptr;
-            }
-            datap++;
+  // the current string of the cursor, copied to the arena if it is not part
+  // of the input text
+    std::string_view _string ()
+    {
+        std::string_view s = this->_cursor.string();
+        if (this->_cursor.hasEscapes()) {
+            char *chars = this->_arena.alloc<char>(s.size(), 1);
+            std::memcpy (chars, s.data(), s.size());
+            s = std::string_view(chars, s.size());
+        }
+        return s;
+    }
 
-          // More whitespace?
-            if (! skipWhitespace(datap)) {
-                delete object;
-                return nullptr;
-            }
+    Value *_endObject ();
+    Value *_endArray ();
+};
 
-          // The value is here
-            Value *value = parse(datap);
-            if (value == nullptr) {
-                delete object;
-                return nullptr;
-            }
+Value *Parser::parse ()
+{
+    while (true) {
+        Value *value;
+        switch (this->_cursor.next()) {
+        case E_START_OBJECT:
+            this->_bases.push_back (this->_fields.size());
+            continue;
+        case E_START_ARRAY:
+            this->_bases.push_back (this->_elems.size());
+            continue;
+        case E_KEY:
+          // the value is filled in when we get it
+            this->_fields.push_back (Object::Member{ this->_string(), nullptr });
+            continue;
+        case E_END_OBJECT: value = this->_endObject(); break;
+        case E_END_ARRAY: value = this->_endArray(); break;
+        case E_INTEGER: value = this->_new<Integer> (this->_cursor.intVal()); break;
+        case E_REAL: value = this->_new<Real> (this->_cursor.realVal()); break;
+        case E_STRING: value = this->_new<String> (this->_string(), true); break;
+        case E_BOOL: value = this->_new<Bool> (this->_cursor.boolVal()); break;
+        case E_NULL: value = this->_new<Null> (); break;
+        case E_END:
+        case E_ERROR:
+            return nullptr;
+        }
+      // add the value to the enclosing object or array
+        if (this->_cursor.depth() == 0) {
+            return value;
+        }
+        else if (this->_cursor.inObject()) {
+            this->_fields.back().value = value;
+        }
+        else {
+            this->_elems.push_back (value);
+        }
+    }
+}
 
-          // Add the name:value
-            object->insert(name, value);
+Value *Parser::_endObject ()
+{
+    size_t base = this->_bases.back();
+    this->_bases.pop_back();
+
+    int n = this->_fields.size() - base;
+    Object::Member *fields = this->_arena.alloc<Object::Member>(n);
+    std::copy (this->_fields.begin() + base, this->_fields.end(), fields);
+    this->_fields.resize (base);
+    Object *obj = this->_new<Object>(fields, n);
+    if (n > Object::kMaxLinear) {
+        uint32_t sz = Object::_indexSize (n);
+        obj->_buildIndex (this->_arena.alloc<uint32_t>(sz), sz);
+    }
+    return obj;
+}
 
-          // More whitespace?
-            if (! skipWhitespace(datap)) {
-                delete object;
-                return nullptr;
-            }
+Value *Parser::_endArray ()
+{
+    size_t base = this->_bases.back();
+    this->_bases.pop_back();
+
+    int n = this->_elems.size() - base;
+    Value **elems = this->_arena.alloc<Value *>(n);
+    std::copy (this->_elems.begin() + base, this->_elems.end(), elems);
+    this->_elems.resize (base);
+    return this->_new<Array>(elems, n);
+}
 
-            // End of object?
-            if (*datap == '}') {
-                datap++;
-                return object;
-            }
+/***** class Document member functions *****/
 
-            // Want a , now
-            if (*datap != ',') {
-                datap.error("expected ','");
-                delete object;
-                return nullptr;
-            }
+Document::Document () : _arena(nullptr), _root(nullptr) { }
 
-            datap++;
-        }
+Document::~Document ()
+{
+    delete this->_arena;
+}
 
-      // Only here if we ran out of data
-        datap.error("unexpected eof");
-        delete object;
+Value *Document::parseFile (std::string const &filename)
+{
+    delete this->_arena;
+    this->_arena = nullptr;
+    this->_root = nullptr;
+
+  // the first block of the arena holds the text of the file plus (usually)
+  // enough space for the values, but we do not know the size of the file
+  // until we have opened it.
+    cs237::Arena *&arena = this->_arena;
+    size_t len;
+    char *buffer = readFile (filename, len,
+        [&arena](size_t n) {
+            arena = new cs237::Arena(std::max(2 * n, size_t(4096)));
+            return arena->alloc<char>(n, 1);
+        });
+    if (buffer == nullptr) {
         return nullptr;
     }
 
-    // An array?
-    else if (*datap == '[') {
-        Array *array = new Array();
-
-        datap++;
+    Cursor cursor;
+    cursor._init (filename, buffer, len);
+    Parser parser(cursor, *this->_arena);
 
-        while (! datap.eof()) {
-          // Whitespace at the start?
-            if (! skipWhitespace(datap)) {
-                delete array;
-                return nullptr;
-            }
+    this->_root = parser.parse ();
 
-          // Special case - empty array
-            if ((array->length() == 0) && (*datap == ']')) {
-                datap++;
-                return array;
-            }
+    return this->_root;
 
-          // Get the value
-            Value *value = parse(datap);
-            if (value == nullptr) {
-                delete array;
-                return nullptr;
-            }
+}
 
-          // Add the value
-            array->add(value);
+/***** Heap-allocated values *****/
 
-          // More whitespace?
-            if (! skipWhitespace(datap)) {
-                delete array;
-                return nullptr;
+// copy a document value into a tree of heap-allocated values
+static Value *copyValue (Value const *v)
+{
+    switch (v->type()) {
+    case T_OBJECT: {
+            Object const *src = v->asObject();
+            Object *obj = new Object();
+            for (int i = 0;  i < src->size();  i++) {
+                Object::Member const &fld = src->field(i);
+                obj->insert (fld.key, copyValue(fld.value));
             }
-
-          // End of array?
-            if (*datap == ']') {
-                datap++;
-                return array;
+            return obj;
+        }
+    case T_ARRAY: {
+            Array const *src = v->asArray();
+            Array *arr = new Array();
+            for (int i = 0;  i < src->length();  i++) {
+                arr->add (copyValue((*src)[i]));
             }
+            return arr;
+        }
+    case T_INTEGER: return new Integer(v->asInteger()->intVal());
+    case T_REAL: return new Real(v->asReal()->realVal());
+    case T_STRING: return new String(std::string(v->asString()->view()));
+    case T_BOOL: return new Bool(v->asBool()->value());
+    case T_NULL: return new Null();
+    }
+    return nullptr;
+}
 
-            // Want a , now
-            if (*datap != ',') {
-                datap.error("expected ','");
-                delete array;
-                return nullptr;
-            }
+// parse a json file; this returns nullptr if there is a parsing error
+Value *parseFile (std::string filename)
+{
+    Document doc;
 
-            datap++;
-        }
+    Value *value = doc.parseFile (filename);
+
+    return (value != nullptr) ? copyValue (value) : nullptr;
 
-      // Only here if we ran out of data
-        datap.error("unexpected eof");
-        delete array;
-        return nullptr;
-    }
-  // Ran out of possibilites, it's bad!
-    else {
-        datap.error("bogus input");
-        return nullptr;
-    }
 }
 
 } // namespace json
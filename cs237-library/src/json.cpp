@@ -13,6 +13,8 @@
  */
 
 #include "json.hpp"
+#include <cstring>
+#include <algorithm>
 
 namespace json {
 
@@ -20,60 +22,163 @@ namespace json {
 
 Value::~Value () { }
 
+// the downcasts are based on the type tag, which is much cheaper than
+// dynamic_cast
+
 const Object *Value::asObject () const
 {
-    return dynamic_cast<const Object *>(this);
+    return this->isObject() ? static_cast<const Object *>(this) : nullptr;
 }
 
 const Array *Value::asArray () const
 {
-    return dynamic_cast<const Array *>(this);
+    return this->isArray() ? static_cast<const Array *>(this) : nullptr;
 }
 
 const Number *Value::asNumber () const
 {
-    return dynamic_cast<const Number *>(this);
+    return this->isNumber() ? static_cast<const Number *>(this) : nullptr;
 }
 
 const Integer *Value::asInteger () const
 {
-    return dynamic_cast<const Integer *>(this);
+    return this->isInteger() ? static_cast<const Integer *>(this) : nullptr;
 }
 
 const Real *Value::asReal () const
 {
-    return dynamic_cast<const Real *>(this);
+    return this->isReal() ? static_cast<const Real *>(this) : nullptr;
 }
 
 const String *Value::asString () const
 {
-    return dynamic_cast<const String *>(this);
+    return this->isString() ? static_cast<const String *>(this) : nullptr;
 }
 
 const Bool *Value::asBool () const
 {
-    return dynamic_cast<const Bool *>(this);
+    return this->isBool() ? static_cast<const Bool *>(this) : nullptr;
 }
 
+/***** class Handler member functions *****/
+
+Handler::~Handler () { }
+
 /***** class Object member functions *****/
 
+// Note that the destructors of the Object, Array, and String classes are only
+// run for heap-allocated values; the values of a Document are never destroyed.
+
+// FNV-1a hash of a key
+static inline uint32_t hashKey (std::string_view key)
+{
+    uint32_t h = 2166136261u;
+    for (char c : key) {
+        h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+    return h;
+}
+
+// make a heap-allocated copy of a string
+static std::string_view copyString (std::string_view s)
+{
+    char *chars = new char[s.size()];
+    std::memcpy (chars, s.data(), s.size());
+    return std::string_view(chars, s.size());
+}
+
 Object::~Object ()
 {
-  // need to delete contents
+    for (int i = 0;  i < this->_size;  i++) {
+        delete[] this->_fields[i].key.data();
+        delete this->_fields[i].value;
+    }
+    delete[] this->_fields;
+    delete[] this->_index;
+}
+
+void Object::insert (std::string_view key, Value *val)
+{
+    bool grew = false;
+    if (this->_size == this->_cap) {
+        int newCap = (this->_cap == 0) ? 4 : 2 * this->_cap;
+        Member *fields = new Member[newCap];
+        std::copy (this->_fields, this->_fields + this->_size, fields);
+        delete[] this->_fields;
+        this->_fields = fields;
+        this->_cap = newCap;
+        grew = true;
+    }
+    this->_fields[this->_size++] = Member{ copyString(key), val };
+
+    if (this->_size > kMaxLinear) {
+        if ((this->_index == nullptr) || grew) {
+          // (re)build the hash table so that it stays at most half full
+            delete[] this->_index;
+            uint32_t sz = _indexSize (this->_cap);
+            this->_buildIndex (new uint32_t[sz], sz);
+        }
+        else {
+            this->_indexField (this->_size - 1);
+        }
+    }
+}
+
+Value *Object::operator[] (std::string_view key) const
+{
+  // if a key is repeated, then the first instance is the one that we return
+    if (this->_index == nullptr) {
+        for (int i = 0;  i < this->_size;  i++) {
+            if (this->_fields[i].key == key) {
+                return this->_fields[i].value;
+            }
+        }
+    }
+    else {
+        for (uint32_t h = hashKey(key) & this->_mask;  ;  h = (h + 1) & this->_mask) {
+            uint32_t ix = this->_index[h];
+            if (ix == 0) {
+                break;
+            }
+            else if (this->_fields[ix-1].key == key) {
+                return this->_fields[ix-1].value;
+            }
+        }
+    }
+    return nullptr;
 }
 
-void Object::insert (std::string key, Value *val)
+uint32_t Object::_indexSize (int n)
 {
-    this->_value.insert (std::pair<std::string, Value *>(key, val));
+    uint32_t sz = 16;
+    while (sz < 2 * uint32_t(n)) {
+        sz *= 2;
+    }
+    return sz;
 }
 
-Value *Object::operator[] (std::string key) const
+void Object::_buildIndex (uint32_t *table, uint32_t sz)
 {
-    std::map<std::string, Value *>::const_iterator got = this->_value.find(key);
-    if (got == this->_value.end())
-        return nullptr;
-    else
-        return got->second;
+    std::fill (table, table + sz, 0);
+    this->_index = table;
+    this->_mask = sz - 1;
+    for (int i = 0;  i < this->_size;  i++) {
+        this->_indexField (i);
+    }
+}
+
+void Object::_indexField (int i)
+{
+    std::string_view key = this->_fields[i].key;
+    uint32_t h = hashKey(key) & this->_mask;
+    while (this->_index[h] != 0) {
+        if (this->_fields[this->_index[h]-1].key == key) {
+          // keep the first instance of a repeated key
+            return;
+        }
+        h = (h + 1) & this->_mask;
+    }
+    this->_index[h] = i + 1;
 }
 
 std::string Object::toString() { return std::string("<object>"); }
@@ -82,7 +187,23 @@ std::string Object::toString() { return std::string("<object>"); }
 
 Array::~Array ()
 {
-  // need to delete contents
+    for (int i = 0;  i < this->_len;  i++) {
+        delete this->_elems[i];
+    }
+    delete[] this->_elems;
+}
+
+void Array::add (Value *v)
+{
+    if (this->_len == this->_cap) {
+        int newCap = (this->_cap == 0) ? 4 : 2 * this->_cap;
+        Value **elems = new Value*[newCap];
+        std::copy (this->_elems, this->_elems + this->_len, elems);
+        delete[] this->_elems;
+        this->_elems = elems;
+        this->_cap = newCap;
+    }
+    this->_elems[this->_len++] = v;
 }
 
 std::string Array::toString() { return std::string("<array>"); }
@@ -105,9 +226,11 @@ std::string Real::toString() { return std::string("<real>"); }
 
 /***** class String member functions *****/
 
-String::~String () { }
+String::String (std::string v) : Value(T_STRING), _value(copyString(v)) { }
+
+String::~String () { delete[] this->_value.data(); }
 
-std::string String::toString () { return this->_value; }
+std::string String::toString () { return std::string(this->_value); }
 
 /***** class Bool member functions *****/
 
@@ -14,8 +14,9 @@
  */
 
 #include "obj.hpp"
-#include <fstream>
-#include <stdexcept>
+#include "obj-scan.hpp"
+#include <charconv>
+#include <string_view>
 #include <utility>
 
 namespace OBJ {
@@ -28,34 +29,32 @@ static std::string dirName (std::string const &path)
     return path.substr(0, path.find_last_of('/'));
 }
 
-// scan one or more floats from a string
-static bool scanFloats (std::string s, int n, float f[3])
+// scan one or more whitespace-separated floats from a string.  We use the OBJ
+// float scanner instead of std::from_chars, since not all of the standard
+// libraries that we support implement from_chars for floating-point types.
+static bool scanFloats (std::string_view s, int n, float f[3])
 {
     assert ((0 < n) && (n <= 3));
-    try {
-        for (int i = 0;  i < n;  i++) {
-            size_t sz;
-            f[i] = std::stof (s, &sz);
-            s = s.substr(sz);
+    const char *p = s.data();
+    const char *e = p + s.size();
+    for (int i = 0;  i < n;  i++) {
+        p = scanFloat (skipBlanks(p, e), e, f[i]);
+        if (p == nullptr) {
+            return false;
         }
     }
-    catch (std::invalid_argument) {
-        return false;
-    }
 
     return true;
 }
 
-static bool scanInt (std::string s, int &n)
+static bool scanInt (std::string_view s, int &n)
 {
-    try {
-        n = std::stoi (s);
+    const char *p = s.data();
+    const char *e = p + s.size();
+    if ((p < e) && (*p == '+')) {
+        p++;
     }
-    catch (std::invalid_argument) {
-        return false;
-    }
-
-    return true;
+    return (std::from_chars(p, e, n).ec == std::errc());
 }
 
 static void Error (std::string const &file, int lnum, std::string const &msg)
@@ -75,43 +74,53 @@ bool ReadMaterial (
 {
     std::string file = dirName(path) + "/" + m;
     int lnum = 0;
-    std::ifstream inS(file);
-    if (inS.fail()) {
+    MappedFile inF(file.c_str());
+    if (! inF.isValid()) {
         std::cerr << "Error: unable to open \"" << file << "\"" << std::endl;
         return false;
     }
 
-  // parse the materials
+  // parse the materials; the lines and tokens are views of the mapped file, so
+  // we only copy strings that are stored in the material.
     int count = 0;
     struct Material mtl;
     float fvals[3];
     int ival;
-    std::string ln;
-    while (std::getline(inS, ln).good()) {
+    const char *p = inF.begin();
+    const char *e = inF.end();
+    while (p < e) {
         lnum++;
-      // if there is a trailing '\r', then remove it
+        const char *eol = endOfLine(p, e);
+      // the line without its terminator (or a trailing '\r')
+        std::string_view ln(p, eol - p);
+        p = eol + 1;
         if ((ln.length() > 0) && (ln.back() == '\r')) {
-            ln.pop_back();
+            ln.remove_suffix(1);
         }
-      // Note that ln will _not_ include the end-of-line terminator!
         if ((ln.length() == 0) || (ln[0] == '#')) {
             continue;
         }
       // skip initial whitespace and ignore empty lines
-        size_t pos = ln.find_first_not_of(" \t");
-        if (pos == std::string::npos) {
+        const char *q = skipBlanks(ln.data(), ln.data() + ln.size());
+        const char *lnEnd = ln.data() + ln.size();
+        if (q == lnEnd) {
             continue;
         }
-        size_t pos2 = ln.find_first_of(" \t", pos);
-        std::string firstTok = ln.substr(pos, pos2-pos);
-        std::string rest = ln.substr(ln.find_first_not_of(" \t", pos2));
-        if (firstTok.compare("newmtl") == 0) { // newmtl name
+        const char *tokEnd = skipToken(q, lnEnd);
+        std::string_view firstTok(q, tokEnd - q);
+      // the rest of the line without leading or trailing whitespace
+        const char *restStart = skipBlanks(tokEnd, lnEnd);
+        while ((restStart < lnEnd) && isBlank(lnEnd[-1])) {
+            lnEnd--;
+        }
+        std::string_view rest(restStart, lnEnd - restStart);
+        if (firstTok == "newmtl") { // newmtl name
             if (count > 0) {
-                materials.push_back(mtl);
+                materials.push_back(std::move(mtl));
             }
             ++count;
           // initialize mtl to default values
-            mtl.name = (rest.empty() ? "default" : rest);
+            mtl.name = (rest.empty() ? std::string("default") : std::string(rest));
             mtl.illum = NoLight;
             mtl.ambientC = DefaultComponent;
             mtl.emissiveC = DefaultComponent;
@@ -128,7 +137,7 @@ bool ReadMaterial (
             mtl.emissiveMap.clear();
             mtl.normalMap.clear();
         }
-        else if (firstTok.compare("Ns") == 0) {  // Ns <float>
+        else if (firstTok == "Ns") {  // Ns <float>
             if (scanFloats(rest, 1, fvals)) {
 #ifdef WAVEFRONT_SHINY
               /* wavefront shininess is from [0, 1000], so scale for OpenGL */
@@ -142,17 +151,17 @@ bool ReadMaterial (
             }
         }
 #ifdef MORE_OBJ_FEATURES
-        else if (firstTok.compare("Ni") == 0) {  // Ni <float>
+        else if (firstTok == "Ni") {  // Ni <float>
             /* ignore refraction index */
         }
-        else if (firstTok.compare("Tf") == 0) {  // Tf ...
+        else if (firstTok == "Tf") {  // Tf ...
             /* ignore transmission factor */
         }
-        else if (firstTok.compare("d") == 0) {  // d <float> or d -halo <float>
+        else if (firstTok == "d") {  // d <float> or d -halo <float>
             /* ignore dissolve */
         }
 #endif
-        else if (firstTok.compare("Kd") == 0) {  // Kd <float> <float> <float>
+        else if (firstTok == "Kd") {  // Kd <float> <float> <float>
             if (scanFloats(rest, 3, fvals)) {
                 mtl.diffuse = glm::vec3(fvals[0], fvals[1], fvals[2]);
                 mtl.diffuseC |= UniformComponent;
@@ -161,7 +170,7 @@ bool ReadMaterial (
                 Error (file, lnum, "expected \"Kd <float> <float> <float>\"");
             }
         }
-        else if (firstTok.compare("Ka") == 0) {  // Ka <float> <float> <float>
+        else if (firstTok == "Ka") {  // Ka <float> <float> <float>
             if (scanFloats(rest, 3, fvals)) {
                 mtl.ambient = glm::vec3(fvals[0], fvals[1], fvals[2]);
                 mtl.ambientC |= UniformComponent;
@@ -170,7 +179,7 @@ bool ReadMaterial (
                 Error (file, lnum, "expected \"Ka <float> <float> <float>\"");
             }
         }
-        else if (firstTok.compare("Ke") == 0) {  // Ke <float> <float> <float>
+        else if (firstTok == "Ke") {  // Ke <float> <float> <float>
             if (scanFloats(rest, 3, fvals)) {
                 mtl.emissive = glm::vec3(fvals[0], fvals[1], fvals[2]);
                 mtl.emissiveC |= UniformComponent;
@@ -179,7 +188,7 @@ bool ReadMaterial (
                 Error (file, lnum, "expected \"Ke <float> <float> <float>\"");
             }
        }
-        else if (firstTok.compare("Ks") == 0) {  // Ks <float> <float> <float>
+        else if (firstTok == "Ks") {  // Ks <float> <float> <float>
             if (scanFloats(rest, 3, fvals)) {
                 mtl.specular = glm::vec3(fvals[0], fvals[1], fvals[2]);
                 mtl.specularC |= UniformComponent;
@@ -188,11 +197,11 @@ bool ReadMaterial (
                 Error (file, lnum, "expected \"Ks <float> <float> <float>\"");
             }
         }
-        else if ((firstTok.compare("d") == 0) || (firstTok.compare("Tr") == 0)) {  // d <float> or Tr <float>
+        else if ((firstTok == "d") || (firstTok == "Tr")) {  // d <float> or Tr <float>
             if (scanFloats(rest, 1, fvals)) {
                 if (fvals[0] < 1.0) {
                   /* ignore transparency filter */
-                    Warning (file, lnum, "ignoring \"" + ln + "\"");
+                    Warning (file, lnum, "ignoring \"" + std::string(ln) + "\"");
                 }
             }
             else {
@@ -200,11 +209,11 @@ bool ReadMaterial (
             }
         }
 #ifdef MORE_OBJ_FEATURES
-        else if (firstTok.compare("Tf") == 0) {  // Tf <float> <float> <float>
+        else if (firstTok == "Tf") {  // Tf <float> <float> <float>
             /* ignore transparency filter */
         }
 #endif
-        else if (firstTok.compare("illum") == 0) {  // illumn <int>
+        else if (firstTok == "illum") {  // illumn <int>
             if (scanInt(rest, ival)) {
                 if ((0 <= ival) && (ival < 10)) {
                     mtl.illum = (ival <= Specular) ? ival : Specular;
@@ -218,7 +227,7 @@ bool ReadMaterial (
                 Error (file, lnum, "expected \"illum <int>\"");
             }
         }
-        else if (firstTok.compare("sharpness") == 0) {  // sharpness <float>
+        else if (firstTok == "sharpness") {  // sharpness <float>
             if (scanFloats(rest, 1, fvals)) {
               /* wavefront shininess is from [0, 1000], so scale for OpenGL */
                 mtl.shininess = 128.0f * (fvals[0] / 1000.0f);
@@ -227,48 +236,43 @@ bool ReadMaterial (
                 Error (file, lnum, "expected \"sharpness <float>\"");
             }
         }
-        else if (firstTok.compare("map_Kd") == 0) {  // map_Kd <name>
+        else if (firstTok == "map_Kd") {  // map_Kd <name>
             mtl.diffuseMap = rest;
             mtl.diffuseC |= MapComponent;
         }
-        else if (firstTok.compare("map_Ka") == 0) {  // map_Ka <name>
+        else if (firstTok == "map_Ka") {  // map_Ka <name>
             mtl.ambientMap = rest;
             mtl.ambientC |= MapComponent;
         }
-        else if (firstTok.compare("map_Ks") == 0) {  // map_Ks <name>
+        else if (firstTok == "map_Ks") {  // map_Ks <name>
             mtl.specularMap = rest;
             mtl.specularC |= MapComponent;
         }
-        else if (firstTok.compare("map_Ke") == 0) {  // map_Ke <name>
+        else if (firstTok == "map_Ke") {  // map_Ke <name>
             mtl.emissiveMap = rest;
             mtl.emissiveC |= MapComponent;
         }
-        else if ((firstTok.compare("map_Bump") == 0)
-        || (firstTok.compare("map_bump") == 0)
-        || (firstTok.compare("bump") == 0))
+        else if ((firstTok == "map_Bump")
+        || (firstTok == "map_bump")
+        || (firstTok == "bump"))
         {
             mtl.normalMap = rest;
         }
 #ifdef MORE_OBJ_FEATURES
-        else if ((firstTok.compare("map_Refl") == 0) || (firstTok.compare("map_refl") == 0)) {
+        else if ((firstTok == "map_Refl") || (firstTok == "map_refl")) {
             /* ignore reflection map */
         }
-        else if (firstTok.compare("map_d") == 0) {  // map_d <name>
+        else if (firstTok == "map_d") {  // map_d <name>
             /* ignore transparency map */
         }
 #endif
         else {
-            Warning (file, lnum, "ignoring \"" + ln + "\"");
+            Warning (file, lnum, "ignoring \"" + std::string(ln) + "\"");
         }
     } // while
 
-    if (!inS.eof()) {
-        Error (file, lnum, "input error");
-        return false;
-    }
-
     if (count > 0) {
-        materials.push_back(mtl);
+        materials.push_back(std::move(mtl));
     }
 
     return true;
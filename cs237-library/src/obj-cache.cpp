@@ -0,0 +1,445 @@
+/*! \file obj-cache.cpp
+ *
+ * Support for caching OBJ models in a binary format.  The cache file holds
+ * the materials, bounding box, and the welded group arrays of a model.  It
+ * is loaded by mapping it into memory, so that the `OBJ::Group` arrays point
+ * directly into the mapping.
+ *
+ * The layout of a cache file is
+ *
+ *      header
+ *      material records
+ *      group records
+ *      string data
+ *      group arrays (each aligned to kAlign bytes)
+ *
+ * where the file offsets in the records are relative to the start of the file.
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#include "obj.hpp"
+#include "obj-scan.hpp"
+#include <cstdio>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace OBJ {
+
+namespace __details {
+
+static const char kMagic[8] = { 'C', 'S', '2', '3', '7', 'O', 'B', 'J' };
+static const uint32_t kVersion = 1;
+static const uint32_t kOptimized = 1;           // header flag for optimized groups
+static const uint32_t kByteOrder = 0x01020304;  // used to detect files written on a
+                                                // machine with a different byte order
+static const uint64_t kAlign = 16;              // alignment of the group arrays
+
+// a string in the string data
+struct StrRec {
+    uint32_t off;                       // file offset
+    uint32_t len;                       // length in bytes (no '\0')
+};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t fileSize;                  // the size of the cache file
+    uint64_t srcSize;                   // the size of the OBJ file
+    int64_t srcMTime;                   // the modification time of the OBJ file
+    uint64_t mtlSize;                   // the size of the MTL file (0 if none)
+    int64_t mtlMTime;                   // the modification time of the MTL file
+    StrRec srcPath;                     // the path of the OBJ file
+    StrRec mtlLibName;                  // the name of the material library
+    float bboxMin[3];                   // the model's bounding box
+    float bboxMax[3];
+    uint32_t bboxEmpty;                 // non-zero if the bounding box is empty
+    uint32_t nMaterials;
+    uint32_t nGroups;
+    uint32_t flags;                     // the options used to build the groups
+};
+
+struct MaterialRec {
+    StrRec name;
+    int32_t illum;
+    int32_t ambientC;
+    int32_t emissiveC;
+    int32_t diffuseC;
+    int32_t specularC;
+    float ambient[3];
+    float emissive[3];
+    float diffuse[3];
+    float specular[3];
+    float shininess;
+    StrRec ambientMap;
+    StrRec emissiveMap;
+    StrRec diffuseMap;
+    StrRec specularMap;
+    StrRec normalMap;
+};
+
+struct GroupRec {
+    StrRec name;
+    int32_t material;
+    uint32_t nVerts;
+    uint32_t nIndices;
+    uint32_t pad;
+    uint64_t verts;                     // file offsets of the arrays (0 for none)
+    uint64_t norms;
+    uint64_t txtCoords;
+    uint64_t indices;
+};
+
+// return the directory part of a pathname (this must match mtl-reader.cpp)
+static std::string dirName (std::string const &path)
+{
+    return path.substr(0, path.find_last_of('/'));
+}
+
+// get the size and modification time of a file; returns false if the file
+// does not exist
+static bool fileStats (std::string const &file, uint64_t &sz, int64_t &mtime)
+{
+    struct stat st;
+    if (stat(file.c_str(), &st) < 0) {
+        sz = 0;
+        mtime = 0;
+        return false;
+    }
+    sz = st.st_size;
+    mtime = st.st_mtime;
+    return true;
+}
+
+static uint64_t alignUp (uint64_t n)
+{
+    return (n + kAlign - 1) & ~(kAlign - 1);
+}
+
+std::string CacheFileName (std::string const &path, std::string const &cacheDir)
+{
+    if (cacheDir.empty()) {
+        return path + ".cache";
+    }
+    else {
+      // we use a hash of the path to distinguish OBJ files that have the same
+      // name but live in different directories
+        uint64_t h = 0xcbf29ce484222325ull;     // 64-bit FNV-1a
+        for (char c : path) {
+            h = (h ^ static_cast<uint8_t>(c)) * 0x100000001b3ull;
+        }
+        char buf[17];
+        snprintf (buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(h));
+        std::string base = path.substr(path.find_last_of('/') + 1);
+        return cacheDir + "/" + base + "." + buf + ".cache";
+    }
+}
+
+// helper class for building the records and string data of a cache file
+struct CacheWriter {
+    std::vector<MaterialRec> mtls;
+    std::vector<GroupRec> grps;
+    std::string strings;                // the string data
+    uint64_t stringBase;                // file offset of the string data
+
+    CacheWriter (size_t nMaterials, size_t nGroups)
+      : mtls(nMaterials), grps(nGroups),
+        stringBase(sizeof(Header) + nMaterials * sizeof(MaterialRec) + nGroups * sizeof(GroupRec))
+    { }
+
+    StrRec addString (std::string const &s)
+    {
+        StrRec r;
+        r.off = static_cast<uint32_t>(this->stringBase + this->strings.size());
+        r.len = static_cast<uint32_t>(s.size());
+        this->strings += s;
+        return r;
+    }
+};
+
+// check that a region of the mapping is in bounds and aligned
+static bool validRegion (MappedFile const &f, uint64_t off, uint64_t sz, uint64_t align)
+{
+    return (off <= f.size()) && (sz <= f.size() - off) && ((off % align) == 0);
+}
+
+// get a string from the mapping
+static bool getString (MappedFile const &f, StrRec const &r, std::string &s)
+{
+    if (! validRegion(f, r.off, r.len, 1)) {
+        return false;
+    }
+    s.assign (f.begin() + r.off, r.len);
+    return true;
+}
+
+// check that the indices of a group refer to its vertices
+static bool validIndices (uint32_t const *indices, uint32_t nIndices, uint32_t nVerts)
+{
+    uint32_t maxIdx = 0;
+    for (uint32_t i = 0;  i < nIndices;  i++) {
+        maxIdx = std::max(maxIdx, indices[i]);
+    }
+    return (nIndices == 0) || (maxIdx < nVerts);
+}
+
+} // namespace __details
+
+using namespace __details;
+
+bool Model::_loadCache (std::string const &cacheFile, Options const &opts)
+{
+    MappedFile *f = new MappedFile(cacheFile.c_str(), true);
+    if (!f->isValid() || (f->size() < sizeof(Header))) {
+        delete f;
+        return false;
+    }
+    const char *base = f->begin();
+    Header const *hdr = reinterpret_cast<Header const *>(base);
+
+  // check that the cache file is valid and up to date
+    uint64_t srcSize;
+    int64_t srcMTime;
+    std::string srcPath, mtlLibName;
+    if ((std::memcmp(hdr->magic, kMagic, sizeof(kMagic)) != 0)
+    ||  (hdr->version != kVersion)
+    ||  (hdr->byteOrder != kByteOrder)
+    ||  (hdr->fileSize != f->size())
+    ||  (hdr->flags != (opts.optimize ? kOptimized : 0))
+    ||  (! fileStats(this->_path, srcSize, srcMTime))
+    ||  (hdr->srcSize != srcSize) || (hdr->srcMTime != srcMTime)
+    ||  (! getString(*f, hdr->srcPath, srcPath)) || (srcPath != this->_path)
+    ||  (! getString(*f, hdr->mtlLibName, mtlLibName))) {
+        delete f;
+        return false;
+    }
+    if (! mtlLibName.empty()) {
+        uint64_t mtlSize;
+        int64_t mtlMTime;
+        fileStats (dirName(this->_path) + "/" + mtlLibName, mtlSize, mtlMTime);
+        if ((hdr->mtlSize != mtlSize) || (hdr->mtlMTime != mtlMTime)) {
+            delete f;
+            return false;
+        }
+    }
+    uint64_t mtlOff = sizeof(Header);
+    uint64_t grpOff = mtlOff + uint64_t(hdr->nMaterials) * sizeof(MaterialRec);
+    if (! validRegion(*f, grpOff, uint64_t(hdr->nGroups) * sizeof(GroupRec), 1)) {
+        delete f;
+        return false;
+    }
+
+  // the materials
+    std::vector<OBJ::Material> materials(hdr->nMaterials);
+    MaterialRec const *mtlRecs = reinterpret_cast<MaterialRec const *>(base + mtlOff);
+    for (uint32_t i = 0;  i < hdr->nMaterials;  i++) {
+        MaterialRec const &r = mtlRecs[i];
+        OBJ::Material &mtl = materials[i];
+        if (!getString(*f, r.name, mtl.name)
+        ||  !getString(*f, r.ambientMap, mtl.ambientMap)
+        ||  !getString(*f, r.emissiveMap, mtl.emissiveMap)
+        ||  !getString(*f, r.diffuseMap, mtl.diffuseMap)
+        ||  !getString(*f, r.specularMap, mtl.specularMap)
+        ||  !getString(*f, r.normalMap, mtl.normalMap)) {
+            delete f;
+            return false;
+        }
+        mtl.illum = r.illum;
+        mtl.ambientC = r.ambientC;
+        mtl.emissiveC = r.emissiveC;
+        mtl.diffuseC = r.diffuseC;
+        mtl.specularC = r.specularC;
+        mtl.ambient = glm::vec3(r.ambient[0], r.ambient[1], r.ambient[2]);
+        mtl.emissive = glm::vec3(r.emissive[0], r.emissive[1], r.emissive[2]);
+        mtl.diffuse = glm::vec3(r.diffuse[0], r.diffuse[1], r.diffuse[2]);
+        mtl.specular = glm::vec3(r.specular[0], r.specular[1], r.specular[2]);
+        mtl.shininess = r.shininess;
+    }
+
+  // the groups; the arrays point into the mapping
+    std::vector<OBJ::Group> groups(hdr->nGroups);
+    GroupRec const *grpRecs = reinterpret_cast<GroupRec const *>(base + grpOff);
+    char *data = const_cast<char *>(base);
+    for (uint32_t i = 0;  i < hdr->nGroups;  i++) {
+        GroupRec const &r = grpRecs[i];
+        OBJ::Group &g = groups[i];
+        uint64_t nv = r.nVerts;
+        if (!getString(*f, r.name, g.name)
+        ||  (r.material < -1) || (r.material >= static_cast<int32_t>(hdr->nMaterials))
+        ||  !validRegion(*f, r.verts, nv * sizeof(glm::vec3), kAlign) || (r.verts == 0)
+        ||  !validRegion(*f, r.norms, nv * sizeof(glm::vec3), kAlign)
+        ||  !validRegion(*f, r.txtCoords, nv * sizeof(glm::vec2), kAlign)
+        ||  !validRegion(*f, r.indices, uint64_t(r.nIndices) * sizeof(uint32_t), kAlign)
+        ||  (r.indices == 0)
+        ||  !validIndices(
+                reinterpret_cast<uint32_t const *>(base + r.indices), r.nIndices, r.nVerts)) {
+            delete f;
+            return false;
+        }
+        g.material = r.material;
+        g.nVerts = r.nVerts;
+        g.nIndices = r.nIndices;
+        g.verts = reinterpret_cast<glm::vec3 *>(data + r.verts);
+        g.norms = (r.norms != 0) ? reinterpret_cast<glm::vec3 *>(data + r.norms) : nullptr;
+        g.txtCoords = (r.txtCoords != 0)
+            ? reinterpret_cast<glm::vec2 *>(data + r.txtCoords)
+            : nullptr;
+        g.indices = reinterpret_cast<uint32_t *>(data + r.indices);
+    }
+
+    this->_mtlLibName = mtlLibName;
+    if (hdr->bboxEmpty == 0) {
+        this->_bbox = cs237::AABBf(
+            glm::vec3(hdr->bboxMin[0], hdr->bboxMin[1], hdr->bboxMin[2]),
+            glm::vec3(hdr->bboxMax[0], hdr->bboxMax[1], hdr->bboxMax[2]));
+    }
+    this->_materials = std::move(materials);
+    this->_indexMaterials ();
+    this->_groups = std::move(groups);
+    this->_cache = f;
+
+    return true;
+
+}
+
+void Model::_saveCache (std::string const &cacheFile, Options const &opts) const
+{
+    CacheWriter w(this->_materials.size(), this->_groups.size());
+
+  // the header
+    Header hdr;
+    std::memset (&hdr, 0, sizeof(hdr));
+    std::memcpy (hdr.magic, kMagic, sizeof(kMagic));
+    hdr.version = kVersion;
+    hdr.byteOrder = kByteOrder;
+    if (! fileStats (this->_path, hdr.srcSize, hdr.srcMTime)) {
+        return;
+    }
+    if (! this->_mtlLibName.empty()) {
+        fileStats (dirName(this->_path) + "/" + this->_mtlLibName, hdr.mtlSize, hdr.mtlMTime);
+    }
+    hdr.srcPath = w.addString (this->_path);
+    hdr.mtlLibName = w.addString (this->_mtlLibName);
+    hdr.bboxEmpty = this->_bbox.isEmpty() ? 1 : 0;
+    if (! this->_bbox.isEmpty()) {
+        glm::vec3 minPt = this->_bbox.min();
+        glm::vec3 maxPt = this->_bbox.max();
+        for (int i = 0;  i < 3;  i++) {
+            hdr.bboxMin[i] = minPt[i];
+            hdr.bboxMax[i] = maxPt[i];
+        }
+    }
+    hdr.nMaterials = this->_materials.size();
+    hdr.nGroups = this->_groups.size();
+    hdr.flags = opts.optimize ? kOptimized : 0;
+
+  // the materials
+    for (size_t i = 0;  i < this->_materials.size();  i++) {
+        OBJ::Material const &mtl = this->_materials[i];
+        MaterialRec &r = w.mtls[i];
+        r.name = w.addString (mtl.name);
+        r.illum = mtl.illum;
+        r.ambientC = mtl.ambientC;
+        r.emissiveC = mtl.emissiveC;
+        r.diffuseC = mtl.diffuseC;
+        r.specularC = mtl.specularC;
+        for (int j = 0;  j < 3;  j++) {
+            r.ambient[j] = mtl.ambient[j];
+            r.emissive[j] = mtl.emissive[j];
+            r.diffuse[j] = mtl.diffuse[j];
+            r.specular[j] = mtl.specular[j];
+        }
+        r.shininess = mtl.shininess;
+        r.ambientMap = w.addString (mtl.ambientMap);
+        r.emissiveMap = w.addString (mtl.emissiveMap);
+        r.diffuseMap = w.addString (mtl.diffuseMap);
+        r.specularMap = w.addString (mtl.specularMap);
+        r.normalMap = w.addString (mtl.normalMap);
+    }
+
+  // the group records; we need the names before we can lay out the arrays
+    for (size_t i = 0;  i < this->_groups.size();  i++) {
+        w.grps[i].name = w.addString (this->_groups[i].name);
+    }
+    uint64_t off = alignUp(w.stringBase + w.strings.size());
+    for (size_t i = 0;  i < this->_groups.size();  i++) {
+        OBJ::Group const &g = this->_groups[i];
+        GroupRec &r = w.grps[i];
+        r.material = g.material;
+        r.nVerts = g.nVerts;
+        r.nIndices = g.nIndices;
+        r.pad = 0;
+        r.verts = off;
+        off = alignUp(off + g.nVerts * sizeof(glm::vec3));
+        r.norms = 0;
+        if (g.norms != nullptr) {
+            r.norms = off;
+            off = alignUp(off + g.nVerts * sizeof(glm::vec3));
+        }
+        r.txtCoords = 0;
+        if (g.txtCoords != nullptr) {
+            r.txtCoords = off;
+            off = alignUp(off + g.nVerts * sizeof(glm::vec2));
+        }
+        r.indices = off;
+        off = alignUp(off + g.nIndices * sizeof(uint32_t));
+    }
+    hdr.fileSize = off;
+
+  // write to a temporary file, which is then renamed, so that a partially
+  // written cache file is never visible.
+    std::string tmpFile = cacheFile + "." + std::to_string(getpid()) + ".tmp";
+    FILE *outS = fopen(tmpFile.c_str(), "wb");
+    if (outS == nullptr) {
+        std::cerr << "warning: unable to create cache file \"" << cacheFile << "\""
+            << std::endl;
+        return;
+    }
+    uint64_t pos = 0;
+    auto put = [outS, &pos] (const void *p, uint64_t sz) {
+            if (sz > 0) {
+                fwrite (p, 1, sz, outS);
+                pos += sz;
+            }
+        };
+    auto pad = [outS, &pos] () {
+            static const char zeros[kAlign] = { 0 };
+            fwrite (zeros, 1, alignUp(pos) - pos, outS);
+            pos = alignUp(pos);
+        };
+    put (&hdr, sizeof(hdr));
+    put (w.mtls.data(), w.mtls.size() * sizeof(MaterialRec));
+    put (w.grps.data(), w.grps.size() * sizeof(GroupRec));
+    put (w.strings.data(), w.strings.size());
+    pad ();
+    for (auto &g : this->_groups) {
+        put (g.verts, g.nVerts * sizeof(glm::vec3));
+        pad ();
+        if (g.norms != nullptr) {
+            put (g.norms, g.nVerts * sizeof(glm::vec3));
+            pad ();
+        }
+        if (g.txtCoords != nullptr) {
+            put (g.txtCoords, g.nVerts * sizeof(glm::vec2));
+            pad ();
+        }
+        put (g.indices, g.nIndices * sizeof(uint32_t));
+        pad ();
+    }
+    bool ok = !ferror(outS) && (pos == hdr.fileSize);
+    ok = (fclose(outS) == 0) && ok;
+    if (!ok || (std::rename(tmpFile.c_str(), cacheFile.c_str()) != 0)) {
+        std::cerr << "warning: unable to write cache file \"" << cacheFile << "\""
+            << std::endl;
+        std::remove (tmpFile.c_str());
+    }
+
+}
+
+} // namespace OBJ
@@ -0,0 +1,635 @@
+/*! \file obj-lod.cpp
+ *
+ * Simplification of OBJ groups by quadric edge collapse, which is used to
+ * generate chains of levels of detail.  The error metric is from
+ *
+ *      Surface Simplification Using Quadric Error Metrics
+ *      by Michael Garland and Paul S. Heckbert
+ *      SIGGRAPH 1997
+ *
+ * Edges are collapsed onto one of their endpoints (i.e., no new vertices are
+ * created), so a simplified group shares the vertex arrays of the original.
+ * Vertices that lie on a UV or normal seam (i.e., two vertices that have the
+ * same position) are only collapsed along the seam and both sides of the seam
+ * are collapsed together, so seams stay closed.  Vertices on open borders are
+ * only collapsed along the border.
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#include "obj.hpp"
+#include "obj-scan.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <unordered_map>
+
+namespace OBJ {
+
+namespace {
+
+const uint32_t kNone = 0xffffffff;
+
+// the weight of the quadrics that keep open borders in place, relative to the
+// quadrics of the faces
+const float kBorderWeight = 10.0f;
+
+// the classification of vertices, which determines how they can be collapsed
+enum VertexKind {
+    Manifold,           // interior vertex; can be collapsed onto any neighbor
+    Border,             // vertex on an open border; can only be collapsed along the border
+    Seam,               // one of a pair of vertices on an attribute seam; can only be
+                        // collapsed along the seam together with its partner
+    Locked              // vertex that cannot be removed
+};
+
+// a symmetric 4x4 quadric matrix plus the total weight of the planes that
+// contributed to it
+struct Quadric {
+    double a2, b2, c2, d2, ab, ac, ad, bc, bd, cd;
+    double w;
+
+    Quadric () : a2(0), b2(0), c2(0), d2(0), ab(0), ac(0), ad(0), bc(0), bd(0), cd(0), w(0) { }
+
+  // add the plane n.x + d = 0 (where n is a unit vector) with weight wt
+    void addPlane (glm::dvec3 n, double d, double wt)
+    {
+        this->a2 += wt * n.x * n.x;
+        this->b2 += wt * n.y * n.y;
+        this->c2 += wt * n.z * n.z;
+        this->d2 += wt * d * d;
+        this->ab += wt * n.x * n.y;
+        this->ac += wt * n.x * n.z;
+        this->ad += wt * n.x * d;
+        this->bc += wt * n.y * n.z;
+        this->bd += wt * n.y * d;
+        this->cd += wt * n.z * d;
+        this->w += wt;
+    }
+
+    Quadric &operator+= (Quadric const &q)
+    {
+        this->a2 += q.a2; this->b2 += q.b2; this->c2 += q.c2; this->d2 += q.d2;
+        this->ab += q.ab; this->ac += q.ac; this->ad += q.ad;
+        this->bc += q.bc; this->bd += q.bd; this->cd += q.cd;
+        this->w += q.w;
+        return *this;
+    }
+
+  // the weighted sum of the squared distances from p to the planes
+    double eval (glm::vec3 const &p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double r = this->a2*x*x + this->b2*y*y + this->c2*z*z + this->d2
+            + 2.0 * (this->ab*x*y + this->ac*x*z + this->ad*x
+                + this->bc*y*z + this->bd*y + this->cd*z);
+        return (r < 0.0) ? 0.0 : r;
+    }
+};
+
+// the half-edges of a triangle list, grouped by their source vertex
+struct EdgeAdjacency {
+    std::vector<uint32_t> offsets;      // offsets into targets, indexed by source vertex
+    std::vector<uint32_t> targets;      // the targets of the half-edges
+
+  // build the adjacency for the given indices, where the vertices are first
+  // mapped by remap (if it is not nullptr)
+    void build (std::vector<uint32_t> const &indices, uint32_t nVerts, uint32_t const *remap)
+    {
+        this->offsets.assign (nVerts + 1, 0);
+        for (uint32_t i = 0;  i < indices.size();  i++) {
+            uint32_t v = indices[i];
+            this->offsets[((remap != nullptr) ? remap[v] : v) + 1]++;
+        }
+        for (uint32_t v = 0;  v < nVerts;  v++) {
+            this->offsets[v + 1] += this->offsets[v];
+        }
+        this->targets.resize (indices.size());
+        std::vector<uint32_t> pos(this->offsets.begin(), this->offsets.end() - 1);
+        for (uint32_t i = 0;  i < indices.size();  i += 3) {
+            for (int j = 0;  j < 3;  j++) {
+                uint32_t a = indices[i + j];
+                uint32_t b = indices[i + (j + 1) % 3];
+                if (remap != nullptr) {
+                    a = remap[a];
+                    b = remap[b];
+                }
+                this->targets[pos[a]++] = b;
+            }
+        }
+    }
+
+  // is there a half-edge from a to b?
+    bool has (uint32_t a, uint32_t b) const
+    {
+        for (uint32_t k = this->offsets[a];  k < this->offsets[a + 1];  k++) {
+            if (this->targets[k] == b) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// a candidate edge collapse
+struct Collapse {
+    uint32_t src;                       // the vertex that is removed
+    uint32_t dst;                       // the vertex that it is collapsed onto
+    float error;                        // the squared error of the collapse
+};
+
+// the state of a simplification; the simplification can be continued to
+// produce successively coarser levels.
+class Simplifier {
+  public:
+    Simplifier (struct Group const &grp);
+
+  // simplify the mesh until it has at most target indices or until the next
+  // collapse would exceed the error limit
+    void simplify (uint32_t target, float maxError);
+
+    std::vector<uint32_t> const &indices () const { return this->_indices; }
+
+  // the error of the current mesh as an object-space distance
+    float error () const { return std::sqrt(this->_error); }
+
+  private:
+    uint32_t _nVerts;
+    glm::vec3 const *_pos;
+    std::vector<uint32_t> _indices;     // the current triangles
+    std::vector<uint32_t> _posId;       // maps vertices to the first vertex with the
+                                        // same position
+    std::vector<uint32_t> _wedge;       // circular list of the vertices that have the
+                                        // same position
+    std::vector<uint8_t> _kind;         // the VertexKind of each vertex
+    std::vector<Quadric> _quadrics;     // quadrics indexed by position ID
+    float _error;                       // the maximum squared error of the collapses so far
+
+    EdgeAdjacency _adj;                 // half-edges of the current mesh
+    std::vector<uint32_t> _triOffsets;  // vertex to triangle adjacency of the current mesh
+    std::vector<uint32_t> _tris;
+
+    void _classify ();
+    void _computeQuadrics ();
+    void _buildAdjacency ();
+    bool _isOpen (uint32_t a, uint32_t b) const
+    {
+        return (this->_adj.has(a, b) != this->_adj.has(b, a));
+    }
+    uint32_t _seamPartner (uint32_t src, uint32_t dst) const;
+    bool _canCollapse (uint32_t src, uint32_t dst) const;
+    bool _flips (uint32_t src, uint32_t dst) const;
+    uint32_t _numRemoved (uint32_t src, uint32_t dst) const;
+    float _collapseError (uint32_t src, uint32_t dst) const
+    {
+        Quadric q = this->_quadrics[this->_posId[src]];
+        q += this->_quadrics[this->_posId[dst]];
+        return (q.w > 0.0) ? float(q.eval(this->_pos[dst]) / q.w) : 0.0f;
+    }
+    bool _pass (uint32_t target, float maxError);
+
+};
+
+Simplifier::Simplifier (struct Group const &grp)
+  : _nVerts(grp.nVerts), _pos(grp.verts), _error(0.0f)
+{
+  // copy the triangles, omitting degenerate ones
+    this->_indices.reserve (grp.nIndices);
+    for (uint32_t i = 0;  i + 2 < grp.nIndices;  i += 3) {
+        uint32_t a = grp.indices[i], b = grp.indices[i+1], c = grp.indices[i+2];
+        if ((a != b) && (b != c) && (c != a)) {
+            this->_indices.push_back (a);
+            this->_indices.push_back (b);
+            this->_indices.push_back (c);
+        }
+    }
+
+  // identify vertices that have the same position
+    std::unordered_map<glm::vec3, uint32_t, __details::PosHash> posMap(2 * this->_nVerts);
+    this->_posId.resize (this->_nVerts);
+    this->_wedge.resize (this->_nVerts);
+    for (uint32_t v = 0;  v < this->_nVerts;  v++) {
+        auto res = posMap.insert (std::pair<glm::vec3, uint32_t>(this->_pos[v], v));
+        uint32_t id = res.first->second;
+        this->_posId[v] = id;
+        if (id == v) {
+            this->_wedge[v] = v;
+        }
+        else {
+          // insert v into the wedge list of id
+            this->_wedge[v] = this->_wedge[id];
+            this->_wedge[id] = v;
+        }
+    }
+
+    this->_classify ();
+    this->_computeQuadrics ();
+
+}
+
+void Simplifier::_classify ()
+{
+    EdgeAdjacency adj;
+    adj.build (this->_indices, this->_nVerts, nullptr);
+
+  // find the open half-edges (i.e., those without an opposite half-edge) into and
+  // out of each vertex; a vertex that has more than one is marked by itself.
+    std::vector<uint32_t> openIn(this->_nVerts, kNone), openOut(this->_nVerts, kNone);
+    for (uint32_t a = 0;  a < this->_nVerts;  a++) {
+        for (uint32_t k = adj.offsets[a];  k < adj.offsets[a + 1];  k++) {
+            uint32_t b = adj.targets[k];
+            if (! adj.has(b, a)) {
+                openOut[a] = (openOut[a] == kNone) ? b : a;
+                openIn[b] = (openIn[b] == kNone) ? a : b;
+            }
+        }
+    }
+    auto single = [](uint32_t v, uint32_t w) { return (w != kNone) && (w != v); };
+
+    this->_kind.resize (this->_nVerts);
+    for (uint32_t v = 0;  v < this->_nVerts;  v++) {
+        uint32_t w = this->_wedge[v];
+        if (w == v) {
+          // the only vertex at this position
+            if ((openIn[v] == kNone) && (openOut[v] == kNone)) {
+                this->_kind[v] = Manifold;
+            }
+            else if (single(v, openIn[v]) && single(v, openOut[v])) {
+                this->_kind[v] = Border;
+            }
+            else {
+                this->_kind[v] = Locked;
+            }
+        }
+        else if (this->_wedge[w] == v) {
+          // two vertices at this position; we have a seam if the open edges of
+          // the two vertices are opposite each other in position space
+            if (single(v, openIn[v]) && single(v, openOut[v])
+            && single(w, openIn[w]) && single(w, openOut[w])
+            && (this->_posId[openIn[v]] == this->_posId[openOut[w]])
+            && (this->_posId[openOut[v]] == this->_posId[openIn[w]])) {
+                this->_kind[v] = Seam;
+            }
+            else {
+                this->_kind[v] = Locked;
+            }
+        }
+        else {
+            this->_kind[v] = Locked;
+        }
+    }
+
+}
+
+void Simplifier::_computeQuadrics ()
+{
+    this->_quadrics.resize (this->_nVerts);
+
+  // the half-edges in position space, which we use to find the open borders
+    EdgeAdjacency adj;
+    adj.build (this->_indices, this->_nVerts, this->_posId.data());
+
+    for (uint32_t i = 0;  i < this->_indices.size();  i += 3) {
+        uint32_t ix[3] = {
+                this->_posId[this->_indices[i]],
+                this->_posId[this->_indices[i+1]],
+                this->_posId[this->_indices[i+2]]
+            };
+        glm::dvec3 p[3] = {
+                glm::dvec3(this->_pos[ix[0]]),
+                glm::dvec3(this->_pos[ix[1]]),
+                glm::dvec3(this->_pos[ix[2]])
+            };
+        glm::dvec3 n = glm::cross(p[1] - p[0], p[2] - p[0]);
+        double len = glm::length(n);
+        if (len == 0.0) {
+            continue;
+        }
+        n /= len;
+      // the plane of the triangle, weighted by its area
+        for (int j = 0;  j < 3;  j++) {
+            this->_quadrics[ix[j]].addPlane (n, -glm::dot(n, p[0]), 0.5 * len);
+        }
+      // for open border edges, add a plane that is perpendicular to the triangle
+        for (int j = 0;  j < 3;  j++) {
+            int k = (j + 1) % 3;
+            if (! adj.has(ix[k], ix[j])) {
+                glm::dvec3 e = p[k] - p[j];
+                glm::dvec3 en = glm::cross(e, n);
+                double elen = glm::length(en);
+                if (elen > 0.0) {
+                    en /= elen;
+                    double wt = kBorderWeight * glm::dot(e, e);
+                    this->_quadrics[ix[j]].addPlane (en, -glm::dot(en, p[j]), wt);
+                    this->_quadrics[ix[k]].addPlane (en, -glm::dot(en, p[j]), wt);
+                }
+            }
+        }
+    }
+
+}
+
+void Simplifier::_buildAdjacency ()
+{
+    this->_adj.build (this->_indices, this->_nVerts, nullptr);
+
+    this->_triOffsets.assign (this->_nVerts + 1, 0);
+    for (uint32_t i = 0;  i < this->_indices.size();  i++) {
+        this->_triOffsets[this->_indices[i] + 1]++;
+    }
+    for (uint32_t v = 0;  v < this->_nVerts;  v++) {
+        this->_triOffsets[v + 1] += this->_triOffsets[v];
+    }
+    this->_tris.resize (this->_indices.size());
+    std::vector<uint32_t> pos(this->_triOffsets.begin(), this->_triOffsets.end() - 1);
+    for (uint32_t i = 0;  i < this->_indices.size();  i++) {
+        this->_tris[pos[this->_indices[i]]++] = i / 3;
+    }
+
+}
+
+// for a collapse of the seam vertex src onto dst, return the vertex that the
+// other side of the seam collapses onto (or kNone if there is no such vertex)
+uint32_t Simplifier::_seamPartner (uint32_t src, uint32_t dst) const
+{
+    uint32_t src2 = this->_wedge[src];
+  // the half-edge between src and dst is open, so the opposite half-edge is on
+  // the other side of the seam
+    bool fwd = this->_adj.has(src, dst);
+    for (uint32_t w = this->_wedge[dst];  w != dst;  w = this->_wedge[w]) {
+        if (fwd ? this->_adj.has(w, src2) : this->_adj.has(src2, w)) {
+            return w;
+        }
+    }
+    return kNone;
+}
+
+bool Simplifier::_canCollapse (uint32_t src, uint32_t dst) const
+{
+    switch (this->_kind[src]) {
+      case Manifold:
+        return true;
+      case Border:
+        return this->_isOpen (src, dst);
+      case Seam:
+        return this->_isOpen (src, dst) && (this->_seamPartner (src, dst) != kNone);
+      default:
+        return false;
+    }
+}
+
+// would moving src to the position of dst flip (or nearly flip) any of the
+// triangles around src?
+bool Simplifier::_flips (uint32_t src, uint32_t dst) const
+{
+    glm::vec3 const &newPos = this->_pos[dst];
+    for (uint32_t k = this->_triOffsets[src];  k < this->_triOffsets[src + 1];  k++) {
+        uint32_t const *tri = &this->_indices[3 * this->_tris[k]];
+      // triangles that contain the edge become degenerate, so we skip them
+        if ((this->_posId[tri[0]] == this->_posId[dst])
+        || (this->_posId[tri[1]] == this->_posId[dst])
+        || (this->_posId[tri[2]] == this->_posId[dst])) {
+            continue;
+        }
+      // rotate the triangle so that src is first
+        int j = (tri[0] == src) ? 0 : ((tri[1] == src) ? 1 : 2);
+        glm::vec3 const &p0 = this->_pos[src];
+        glm::vec3 const &p1 = this->_pos[tri[(j + 1) % 3]];
+        glm::vec3 const &p2 = this->_pos[tri[(j + 2) % 3]];
+        glm::vec3 n0 = glm::cross(p1 - p0, p2 - p0);
+        glm::vec3 n1 = glm::cross(p1 - newPos, p2 - newPos);
+      // reject the collapse if the normal rotates by more than ~75 degrees
+        if (glm::dot(n0, n1) < 0.25f * glm::length(n0) * glm::length(n1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// the number of triangles that are removed by a collapse
+uint32_t Simplifier::_numRemoved (uint32_t src, uint32_t dst) const
+{
+    uint32_t n = 0;
+    for (uint32_t k = this->_triOffsets[src];  k < this->_triOffsets[src + 1];  k++) {
+        uint32_t const *tri = &this->_indices[3 * this->_tris[k]];
+        if ((tri[0] == dst) || (tri[1] == dst) || (tri[2] == dst)) {
+            n++;
+        }
+    }
+    return n;
+}
+
+// one pass of collapses; returns false if no edges were collapsed
+bool Simplifier::_pass (uint32_t target, float maxError)
+{
+    this->_buildAdjacency ();
+
+  // collect the candidate collapses; each edge is considered once in the
+  // direction that has the least error
+    std::vector<Collapse> candidates;
+    for (uint32_t i = 0;  i < this->_indices.size();  i += 3) {
+        for (int j = 0;  j < 3;  j++) {
+            uint32_t a = this->_indices[i + j];
+            uint32_t b = this->_indices[i + (j + 1) % 3];
+            if ((a > b) && this->_adj.has(b, a)) {
+                continue;   // the edge will be considered from the other side
+            }
+            bool ab = this->_canCollapse (a, b);
+            bool ba = this->_canCollapse (b, a);
+            if (ab || ba) {
+                float eab = ab ? this->_collapseError (a, b) : FLT_MAX;
+                float eba = ba ? this->_collapseError (b, a) : FLT_MAX;
+                if (eab <= eba) {
+                    candidates.push_back (Collapse{a, b, eab});
+                }
+                else {
+                    candidates.push_back (Collapse{b, a, eba});
+                }
+            }
+        }
+    }
+    if (candidates.empty()) {
+        return false;
+    }
+    std::sort (candidates.begin(), candidates.end(),
+        [](Collapse const &c1, Collapse const &c2) {
+            return (c1.error < c2.error)
+                || ((c1.error == c2.error) && (c1.src < c2.src));
+        });
+
+  // the number of triangles that we want to remove.  Since the collapses in a
+  // pass are independent, we stop early once the collapses get much more
+  // expensive than the expected last one, so that the next pass can pick from
+  // the cheaper collapses that become available.
+    uint32_t goal = (uint32_t(this->_indices.size()) - target) / 3;
+    uint32_t edgeGoal = goal / 2;
+    float errorGoal = (edgeGoal < candidates.size())
+        ? 1.5f * candidates[edgeGoal].error
+        : FLT_MAX;
+
+    std::vector<uint32_t> remap(this->_nVerts);
+    for (uint32_t v = 0;  v < this->_nVerts;  v++) {
+        remap[v] = v;
+    }
+    std::vector<bool> locked(this->_nVerts, false);     // indexed by position ID
+    uint32_t nRemoved = 0;
+    uint32_t nCollapses = 0;
+    for (auto const &c : candidates) {
+        if (c.error > maxError) {
+            break;
+        }
+        if ((c.error > errorGoal) && (nRemoved > goal / 10)) {
+            break;
+        }
+        uint32_t srcId = this->_posId[c.src];
+        uint32_t dstId = this->_posId[c.dst];
+        if (locked[srcId] || locked[dstId]) {
+            continue;
+        }
+        uint32_t src2 = kNone, dst2 = kNone;
+        if (this->_kind[c.src] == Seam) {
+            src2 = this->_wedge[c.src];
+            dst2 = this->_seamPartner (c.src, c.dst);
+            if (dst2 == kNone) {
+                continue;
+            }
+        }
+        if (this->_flips (c.src, c.dst)
+        || ((src2 != kNone) && this->_flips (src2, dst2))) {
+            continue;
+        }
+      // perform the collapse
+        remap[c.src] = c.dst;
+        nRemoved += this->_numRemoved (c.src, c.dst);
+        if (src2 != kNone) {
+            remap[src2] = dst2;
+            nRemoved += this->_numRemoved (src2, dst2);
+        }
+        this->_quadrics[dstId] += this->_quadrics[srcId];
+        locked[srcId] = true;
+        locked[dstId] = true;
+        this->_error = std::max(this->_error, c.error);
+        nCollapses++;
+        if (nRemoved >= goal) {
+            break;
+        }
+    }
+    if (nCollapses == 0) {
+        return false;
+    }
+
+  // update the triangles and remove the ones that have become degenerate
+    uint32_t n = 0;
+    for (uint32_t i = 0;  i < this->_indices.size();  i += 3) {
+        uint32_t a = remap[this->_indices[i]];
+        uint32_t b = remap[this->_indices[i+1]];
+        uint32_t c = remap[this->_indices[i+2]];
+        if ((a != b) && (b != c) && (c != a)) {
+            this->_indices[n++] = a;
+            this->_indices[n++] = b;
+            this->_indices[n++] = c;
+        }
+    }
+    this->_indices.resize (n);
+
+    return true;
+
+}
+
+void Simplifier::simplify (uint32_t target, float maxError)
+{
+    float maxSqError = maxError * maxError;
+    while ((this->_indices.size() > target) && this->_pass (target, maxSqError)) {
+        continue;
+    }
+}
+
+} // anonymous namespace
+
+LOD SimplifyGroup (struct Group const &grp, uint32_t targetIndices, float maxError)
+{
+    Simplifier simp(grp);
+    simp.simplify (targetIndices, maxError);
+
+    LOD lod;
+    lod.indices = simp.indices();
+    lod.error = simp.error();
+
+    return lod;
+
+}
+
+std::vector<LOD> BuildLODChain (
+    struct Group const &grp,
+    uint32_t maxLevels,
+    float ratio,
+    float maxError)
+{
+    std::vector<LOD> chain;
+
+  // level 0 is the original group
+    LOD lod0;
+    lod0.indices.assign (grp.indices, grp.indices + grp.nIndices);
+    lod0.error = 0.0f;
+    chain.push_back (std::move(lod0));
+
+  // we continue the same simplification for each level, so that the errors of
+  // the levels are monotonic
+    Simplifier simp(grp);
+    float target = float(grp.nIndices);
+    while (chain.size() < maxLevels) {
+        target *= ratio;
+        uint32_t nIndices = 3 * uint32_t(target / 3.0f);
+        if (nIndices < 3) {
+            break;
+        }
+        simp.simplify (nIndices, maxError);
+      // stop if the simplification did not make enough progress
+        uint32_t prevSize = chain.back().indices.size();
+        if (simp.indices().size() > prevSize - prevSize / 8) {
+            break;
+        }
+        LOD lod;
+        lod.indices = simp.indices();
+        lod.error = simp.error();
+        chain.push_back (std::move(lod));
+    }
+
+    return chain;
+
+}
+
+float ScreenSpaceError (float error, float dist, float fovy, float viewportHt)
+{
+    if (dist <= 0.0f) {
+        return FLT_MAX;
+    }
+    return error * viewportHt / (2.0f * dist * std::tan(0.5f * fovy));
+}
+
+uint32_t SelectLOD (
+    std::vector<LOD> const &chain,
+    float dist,
+    float fovy,
+    float viewportHt,
+    float pixelError)
+{
+  // the levels are ordered by increasing error, so we pick the last one that
+  // is within the threshold
+    uint32_t level = 0;
+    for (uint32_t i = 1;  i < chain.size();  i++) {
+        if (ScreenSpaceError (chain[i].error, dist, fovy, viewportHt) > pixelError) {
+            break;
+        }
+        level = i;
+    }
+    return level;
+
+}
+
+} // namespace OBJ
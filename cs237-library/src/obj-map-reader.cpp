@@ -0,0 +1,440 @@
+/*! \file obj-map-reader.cpp
+ *
+ * A single-pass reader for OBJ files.  The file is mapped into memory and
+ * tokenized in place, and the parsed data is passed to an `OBJVisitor` as
+ * it is read, so we avoid the two passes through stdio that `OBJReadOBJ`
+ * makes.  `OBJReadMappedOBJ` uses a visitor that grows the model's arrays.
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#include "obj-reader.hpp"
+#include "obj-scan.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace OBJ {
+
+namespace __details {
+
+/***** class MappedFile member functions *****/
+
+MappedFile::MappedFile (const char *file, bool writable)
+  : _data(nullptr), _sz(0), _mapped(false)
+{
+    int fd = open(file, O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close (fd);
+        return;
+    }
+    if (st.st_size == 0) {
+      // mmap does not support empty mappings
+        close (fd);
+        this->_data = "";
+        return;
+    }
+    int prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void *p = mmap(nullptr, st.st_size, prot, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (p == MAP_FAILED) {
+        return;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise (p, st.st_size, MADV_SEQUENTIAL);
+#endif
+    this->_data = static_cast<const char *>(p);
+    this->_sz = st.st_size;
+    this->_mapped = true;
+}
+
+void MappedFile::release (const char *p) const
+{
+#ifdef MADV_DONTNEED
+    if (this->_mapped) {
+        size_t pageSz = sysconf(_SC_PAGESIZE);
+        size_t n = ((p - this->_data) / pageSz) * pageSz;
+        if (n > 0) {
+            madvise (const_cast<char *>(this->_data), n, MADV_DONTNEED);
+        }
+    }
+#endif
+}
+
+MappedFile::~MappedFile ()
+{
+    if (this->_mapped) {
+        munmap (const_cast<char *>(this->_data), this->_sz);
+    }
+}
+
+} // namespace __details
+
+} // namespace OBJ
+
+using namespace OBJ::__details;
+
+// make a copy of a string that can be freed with `delete[]`
+static char *copyString (const char *s, size_t n)
+{
+    char *cp = new char[n+1];
+    std::memcpy (cp, s, n);
+    cp[n] = '\0';
+    return cp;
+}
+
+// the size of the windows in which OBJStreamOBJ parses the file
+static const size_t kStreamWindow = 4 * 1024 * 1024;
+
+// the state of the parser
+struct Parser {
+    const char *file;                   // the file name (for error messages)
+    int lnum;                           // the current line number
+    OBJVisitor &visitor;                // receives the parsed data
+    uint32_t nVerts;                    // the number of vertices so far
+    uint32_t nNorms;                    // the number of normals so far
+    uint32_t nTxtCoords;                // the number of texture coordinates so far
+
+    Parser (const char *f, OBJVisitor &v)
+      : file(f), lnum(0), visitor(v), nVerts(0), nNorms(0), nTxtCoords(0)
+    { }
+
+    void warning (const char *msg)
+    {
+        fprintf(stderr, "OBJStreamOBJ(): %s at line %d of \"%s\"\n",
+            msg, this->lnum, this->file);
+    }
+
+  // convert an OBJ index, which may be relative, to an absolute index, where
+  // n is the number of items so far
+    static uint32_t absIndex (int32_t ix, uint32_t n)
+    {
+        return (ix < 0) ? static_cast<uint32_t>(ix + static_cast<int32_t>(n) + 1) : ix;
+    }
+
+    void parseFace (const char *p, const char *eol);
+    bool parse (const char *p, const char *e);
+
+};
+
+// parse the vertices of a face, which can have one of the forms "v", "v/t",
+// "v//n", or "v/t/n".  Polygons with more than three vertices are converted
+// to triangle fans.
+void Parser::parseFace (const char *p, const char *eol)
+{
+    OBJtriangle tri;
+    uint32_t nv = 0;
+    while ((p = skipBlanks(p, eol)) < eol) {
+        int32_t v, t, n;
+        if ((p = scanFaceVertex(p, eol, v, t, n)) == nullptr) {
+            this->warning ("invalid face");
+            return;
+        }
+        uint32_t vi = absIndex(v, this->nVerts);
+        uint32_t ti = absIndex(t, this->nTxtCoords);
+        uint32_t ni = absIndex(n, this->nNorms);
+        if (nv < 3) {
+            tri.vindices[nv] = vi;
+            tri.tindices[nv] = ti;
+            tri.nindices[nv] = ni;
+        }
+        else {
+          // start a new triangle in the fan
+            tri.vindices[1] = tri.vindices[2];
+            tri.tindices[1] = tri.tindices[2];
+            tri.nindices[1] = tri.nindices[2];
+            tri.vindices[2] = vi;
+            tri.tindices[2] = ti;
+            tri.nindices[2] = ni;
+        }
+        if (++nv >= 3) {
+            this->visitor.triangle (tri);
+        }
+    }
+    if (nv < 3) {
+        this->warning ("face has fewer than three vertices");
+    }
+
+}
+
+// parse the lines in [p, e), which must end at a line boundary
+bool Parser::parse (const char *p, const char *e)
+{
+    while (p < e) {
+        this->lnum++;
+        const char *eol = endOfLine (p, e);
+        p = skipBlanks (p, eol);
+        if ((p == eol) || (*p == '#')) {
+            p = (eol < e) ? eol + 1 : e;
+            continue;
+        }
+        const char *tok = p;
+        p = skipToken (p, eol);
+        size_t tokLen = p - tok;
+        if ((tokLen == 1) && (tok[0] == 'v')) {
+            glm::vec3 v;
+            if (((p = scanFloat(skipBlanks(p, eol), eol, v.x)) == nullptr)
+            ||  ((p = scanFloat(skipBlanks(p, eol), eol, v.y)) == nullptr)
+            ||  ((p = scanFloat(skipBlanks(p, eol), eol, v.z)) == nullptr)) {
+                this->warning ("invalid vertex");
+                return false;
+            }
+            this->nVerts++;
+            this->visitor.vertex (v);
+        }
+        else if ((tokLen == 2) && (tok[0] == 'v') && (tok[1] == 'n')) {
+            glm::vec3 n;
+            if (((p = scanFloat(skipBlanks(p, eol), eol, n.x)) == nullptr)
+            ||  ((p = scanFloat(skipBlanks(p, eol), eol, n.y)) == nullptr)
+            ||  ((p = scanFloat(skipBlanks(p, eol), eol, n.z)) == nullptr)) {
+                this->warning ("invalid normal");
+                return false;
+            }
+            this->nNorms++;
+            this->visitor.normal (n);
+        }
+        else if ((tokLen == 2) && (tok[0] == 'v') && (tok[1] == 't')) {
+            glm::vec2 t;
+            if ((p = scanFloat(skipBlanks(p, eol), eol, t.x)) == nullptr) {
+                this->warning ("invalid texture coordinate");
+                return false;
+            }
+          // the second coordinate is optional
+            if ((p = scanFloat(skipBlanks(p, eol), eol, t.y)) == nullptr) {
+                t.y = 0.0f;
+            }
+            this->nTxtCoords++;
+            this->visitor.texCoord (t);
+        }
+        else if ((tokLen == 1) && (tok[0] == 'f')) {
+            this->parseFace (p, eol);
+        }
+        else if ((tokLen == 1) && (tok[0] == 'g')) {
+          // the group name is the rest of the line
+            p = skipBlanks (p, eol);
+            const char *q = eol;
+            while ((q > p) && isBlank(q[-1])) {
+                q--;
+            }
+            this->visitor.group ((p < q) ? std::string(p, q - p) : std::string("default"));
+        }
+        else if ((tokLen == 6) && (std::strncmp(tok, "usemtl", 6) == 0)) {
+            p = skipBlanks (p, eol);
+            this->visitor.useMaterial (std::string(p, skipToken(p, eol) - p));
+        }
+        else if ((tokLen == 6) && (std::strncmp(tok, "mtllib", 6) == 0)) {
+            p = skipBlanks (p, eol);
+            this->visitor.materialLib (std::string(p, skipToken(p, eol) - p));
+        }
+        /* else ignore the line */
+        p = (eol < e) ? eol + 1 : e;
+    }
+
+    return true;
+
+}
+
+/* OBJStreamOBJ: Parses a Wavefront .OBJ file and passes its contents to a
+ * visitor.
+ */
+bool OBJStreamOBJ (const char *filename, OBJVisitor &visitor)
+{
+    MappedFile f(filename);
+    if (! f.isValid()) {
+        fprintf(stderr, "OBJStreamOBJ() failed: can't open data file \"%s\".\n",
+            filename);
+        return false;
+    }
+
+  // we parse the file in windows that end at line boundaries and release the
+  // pages of each window once it has been parsed, so that the whole file is
+  // never resident at once
+    Parser parser(filename, visitor);
+    const char *p = f.begin();
+    while (p < f.end()) {
+        const char *q = p + std::min(kStreamWindow, size_t(f.end() - p));
+        if (q < f.end()) {
+            q = endOfLine (q, f.end());
+            q = (q < f.end()) ? q + 1 : q;
+        }
+        if (! parser.parse (p, q)) {
+            return false;
+        }
+        f.release (q);
+        p = q;
+    }
+
+    return true;
+
+}
+
+// a visitor that builds an OBJmodel
+struct ModelBuilder : public OBJVisitor {
+    struct Group {
+        OBJgroup *grp;                  // the group in the model
+        GrowArray<uint32_t> tris;       // the group's triangles
+
+        explicit Group (OBJgroup *g) : grp(g), tris() { }
+    };
+
+    OBJmodel *model;                    // the model being constructed
+    GrowArray<glm::vec3> verts;         // vertices (1-based)
+    GrowArray<glm::vec3> norms;         // normals (1-based)
+    GrowArray<glm::vec2> txtCoords;     // texture coordinates (1-based)
+    GrowArray<OBJtriangle> tris;        // triangles
+    std::vector<Group> groups;          // groups in order of creation
+    std::unordered_map<std::string, int> groupMap; // map from names to groups
+    int curGrp;                         // index of current group (-1 for none)
+    std::string curMtl;                 // the current material ("" for none)
+
+    explicit ModelBuilder (OBJmodel *m)
+      : model(m), curGrp(-1)
+    {
+      // the arrays have 1-based indexing, so we allocate a dummy first element
+        *this->verts.push() = glm::vec3(0.0f);
+        *this->norms.push() = glm::vec3(0.0f);
+        *this->txtCoords.push() = glm::vec2(0.0f);
+    }
+
+  // set the current group to the named group, creating it if necessary.
+  // As in the original reader, the group takes on the current material.
+    void setGroup (std::string const &name)
+    {
+        auto it = this->groupMap.find(name);
+        if (it == this->groupMap.end()) {
+            OBJgroup *grp = new OBJgroup;
+            grp->name = copyString (name.c_str(), name.size());
+            grp->material = nullptr;
+            grp->numtriangles = 0;
+            grp->triangles = nullptr;
+          // the model's group list is in reverse order of creation
+            grp->next = this->model->groups;
+            this->model->groups = grp;
+            this->model->numgroups++;
+            this->curGrp = this->groups.size();
+            this->groups.emplace_back (grp);
+            this->groupMap.insert (std::pair<std::string, int>(name, this->curGrp));
+        }
+        else {
+            this->curGrp = it->second;
+        }
+        OBJgroup *grp = this->groups[this->curGrp].grp;
+        delete[] grp->material;
+        grp->material = this->curMtl.empty()
+            ? nullptr
+            : copyString (this->curMtl.data(), this->curMtl.size());
+    }
+
+  // make sure that there is a current group
+    Group &currentGroup ()
+    {
+        if (this->curGrp < 0) {
+            this->setGroup ("default");
+        }
+        return this->groups[this->curGrp];
+    }
+
+    void vertex (glm::vec3 const &v) override { this->verts.push (v); }
+    void normal (glm::vec3 const &n) override { this->norms.push (n); }
+    void texCoord (glm::vec2 const &t) override { this->txtCoords.push (t); }
+
+    void triangle (OBJtriangle const &tri) override
+    {
+        this->currentGroup().tris.push (this->tris.size());
+        this->tris.push (tri);
+    }
+
+    void group (std::string const &name) override { this->setGroup (name); }
+
+    void useMaterial (std::string const &name) override
+    {
+        this->curMtl = name;
+      // if there is already a material associated with this group, then we
+      // ignore this material.
+        OBJgroup *grp = this->currentGroup().grp;
+        if ((grp->material == nullptr) && !this->curMtl.empty()) {
+            grp->material = copyString (this->curMtl.data(), this->curMtl.size());
+        }
+    }
+
+    void materialLib (std::string const &name) override
+    {
+        delete[] this->model->mtllibname;
+        this->model->mtllibname = copyString (name.data(), name.size());
+    }
+
+    void finish ();
+
+};
+
+// transfer the data to the model
+void ModelBuilder::finish ()
+{
+    OBJmodel *model = this->model;
+
+    model->numvertices = this->verts.size() - 1;
+    model->vertices = this->verts.release();
+    model->numnormals = this->norms.size() - 1;
+    if (model->numnormals > 0) {
+        model->normals = this->norms.release();
+    }
+    model->numtexcoords = this->txtCoords.size() - 1;
+    if (model->numtexcoords > 0) {
+        model->texcoords = this->txtCoords.release();
+    }
+    model->numtriangles = this->tris.size();
+    model->triangles = this->tris.release();
+
+  // rebuild the model's group list (which is in reverse order of creation),
+  // dropping any groups that do not have triangles
+    model->groups = nullptr;
+    model->numgroups = 0;
+    for (auto &g : this->groups) {
+        if (g.tris.size() > 0) {
+            g.grp->numtriangles = g.tris.size();
+            g.grp->triangles = g.tris.release();
+            g.grp->next = model->groups;
+            model->groups = g.grp;
+            model->numgroups++;
+        }
+        else {
+            delete[] g.grp->name;
+            delete[] g.grp->material;
+            delete g.grp;
+        }
+    }
+
+}
+
+/* OBJReadMappedOBJ: Reads a model description from a Wavefront .OBJ file
+ * in a single pass over a memory mapping of the file.  This function uses
+ * the streaming reader to build the model.
+ */
+OBJmodel *OBJReadMappedOBJ (const char *filename)
+{
+    OBJmodel *model = new OBJmodel();
+    ModelBuilder builder(model);
+    if (! OBJStreamOBJ (filename, builder)) {
+        delete model;
+        return nullptr;
+    }
+    builder.finish ();
+
+    return model;
+
+}
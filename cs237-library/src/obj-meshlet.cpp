@@ -0,0 +1,283 @@
+/*! \file obj-meshlet.cpp
+ *
+ * Clustering of OBJ groups into meshlets (small clusters of triangles), which
+ * can be culled individually against the view frustum and by their normal
+ * cones.
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#include "obj.hpp"
+#include <algorithm>
+#include <cfloat>
+
+namespace OBJ {
+
+namespace {
+
+// the local ID of a vertex that is not in the current meshlet
+const uint8_t kNotInMeshlet = 0xff;
+
+// marks the absence of a candidate triangle
+const uint32_t kNoTriangle = ~0u;
+
+// the weight of the normal-cone term, relative to the distance term, when
+// choosing the next triangle of a meshlet
+const float kConeWeight = 0.5f;
+
+// compute the culling data for a meshlet
+MeshletBounds ComputeBounds (
+    struct Group const &grp,
+    std::vector<glm::vec3> const &triNorms,
+    std::vector<uint32_t> const &tris,
+    uint32_t const *verts,
+    uint32_t nVerts)
+{
+    MeshletBounds b;
+
+  // the bounding sphere is centered on the bounding box of the vertices
+    cs237::AABBf bbox;
+    for (uint32_t i = 0;  i < nVerts;  i++) {
+        bbox.addPt (grp.verts[verts[i]]);
+    }
+    glm::vec3 center = bbox.center();
+    float r2 = 0.0f;
+    for (uint32_t i = 0;  i < nVerts;  i++) {
+        glm::vec3 d = grp.verts[verts[i]] - center;
+        r2 = std::max(r2, glm::dot(d, d));
+    }
+    b.sphere = glm::vec4(center, std::sqrt(r2));
+
+  // the normal cone axis is the average of the triangle normals and the cutoff
+  // is determined by the normal that is furthest from the axis
+    glm::vec3 axis(0.0f);
+    for (uint32_t t : tris) {
+        axis += triNorms[t];
+    }
+    float len = glm::length(axis);
+    if (len == 0.0f) {
+        b.cone = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+        return b;
+    }
+    axis /= len;
+    float minDot = 1.0f;
+    for (uint32_t t : tris) {
+        if (triNorms[t] != glm::vec3(0.0f)) {
+            minDot = std::min(minDot, glm::dot(triNorms[t], axis));
+        }
+    }
+  // if the cone is wider than ~85 degrees, then the meshlet cannot be culled
+    if (minDot <= 0.1f) {
+        b.cone = glm::vec4(axis, 1.0f);
+    }
+    else {
+        b.cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+    }
+
+    return b;
+
+}
+
+} // anonymous namespace
+
+MeshletTable BuildMeshlets (struct Group const &grp, uint32_t maxVerts, uint32_t maxTris)
+{
+    assert ((3 <= maxVerts) && (maxVerts < kNotInMeshlet));
+    assert ((1 <= maxTris) && (maxTris <= 0xffff));
+
+    MeshletTable table;
+    uint32_t nTris = grp.nIndices / 3;
+    if (nTris == 0) {
+        return table;
+    }
+
+  // the unit normals and centroids of the triangles
+    std::vector<glm::vec3> triNorms(nTris), triCenters(nTris);
+    for (uint32_t t = 0;  t < nTris;  t++) {
+        glm::vec3 const &p0 = grp.verts[grp.indices[3*t]];
+        glm::vec3 const &p1 = grp.verts[grp.indices[3*t+1]];
+        glm::vec3 const &p2 = grp.verts[grp.indices[3*t+2]];
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        float len = glm::length(n);
+        triNorms[t] = (len > 0.0f) ? n / len : glm::vec3(0.0f);
+        triCenters[t] = (p0 + p1 + p2) / 3.0f;
+    }
+
+  // build the vertex to triangle adjacency in compressed form
+    std::vector<uint32_t> adjOffset(grp.nVerts + 1, 0);
+    for (uint32_t i = 0;  i < grp.nIndices;  i++) {
+        adjOffset[grp.indices[i] + 1]++;
+    }
+    for (uint32_t v = 0;  v < grp.nVerts;  v++) {
+        adjOffset[v + 1] += adjOffset[v];
+    }
+    std::vector<uint32_t> adj(grp.nIndices);
+    {
+        std::vector<uint32_t> pos(adjOffset.begin(), adjOffset.end() - 1);
+        for (uint32_t i = 0;  i < grp.nIndices;  i++) {
+            adj[pos[grp.indices[i]]++] = i / 3;
+        }
+    }
+
+    std::vector<bool> used(nTris, false);
+    std::vector<uint8_t> localId(grp.nVerts, kNotInMeshlet);
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> mTris;                // the triangles of the current meshlet
+    uint32_t cursor = 0;                        // the next seed triangle to consider
+    uint32_t nDone = 0;
+
+    table.indices.reserve (grp.nIndices);
+    table.triangles.reserve (grp.nIndices);
+
+    while (nDone < nTris) {
+        Meshlet m;
+        m.firstIndex = table.indices.size();
+        m.firstVert = table.vertices.size();
+        m.firstTri = table.triangles.size() / 3;
+        m.nVerts = 0;
+        m.nTris = 0;
+        mTris.clear();
+        candidates.clear();
+
+      // seed the meshlet with the first unused triangle; since the triangles
+      // are usually in a spatially coherent order (e.g., after OptimizeGroup),
+      // this is usually close to the previous meshlet.
+        while (used[cursor]) {
+            cursor++;
+        }
+        uint32_t next = cursor;
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normSum(0.0f);
+
+        while (true) {
+          // add the triangle to the meshlet
+            uint32_t const *tri = &grp.indices[3 * next];
+            for (int j = 0;  j < 3;  j++) {
+                uint32_t v = tri[j];
+                if (localId[v] == kNotInMeshlet) {
+                    localId[v] = m.nVerts++;
+                    table.vertices.push_back (v);
+                  // the triangles around the new vertex are candidates
+                    for (uint32_t k = adjOffset[v];  k < adjOffset[v + 1];  k++) {
+                        if (! used[adj[k]]) {
+                            candidates.push_back (adj[k]);
+                        }
+                    }
+                }
+                table.indices.push_back (v);
+                table.triangles.push_back (localId[v]);
+            }
+            used[next] = true;
+            nDone++;
+            mTris.push_back (next);
+            m.nTris++;
+            centroid += (triCenters[next] - centroid) / float(m.nTris);
+            normSum += triNorms[next];
+
+            if (m.nTris == maxTris) {
+                break;
+            }
+
+          // pick the next triangle from the candidates; we prefer triangles that
+          // add the fewest vertices, then triangles that keep the meshlet compact
+          // and its normal cone narrow
+            glm::vec3 axis = normSum;
+            float axisLen = glm::length(axis);
+            if (axisLen > 0.0f) {
+                axis /= axisLen;
+            }
+            float r2 = 0.0f;
+            for (uint32_t t : mTris) {
+                glm::vec3 d = triCenters[t] - centroid;
+                r2 = std::max(r2, glm::dot(d, d));
+            }
+            float invR = (r2 > 0.0f) ? 1.0f / std::sqrt(r2) : 1.0f;
+            next = kNoTriangle;
+            uint32_t bestExtra = 4;
+            float bestScore = FLT_MAX;
+            uint32_t n = 0;
+            for (uint32_t t : candidates) {
+                if (used[t]) {
+                    continue;
+                }
+                candidates[n++] = t;    // compact the candidate list
+                uint32_t extra = (localId[grp.indices[3*t]] == kNotInMeshlet)
+                    + (localId[grp.indices[3*t+1]] == kNotInMeshlet)
+                    + (localId[grp.indices[3*t+2]] == kNotInMeshlet);
+                if ((m.nVerts + extra > maxVerts) || (extra > bestExtra)) {
+                    continue;
+                }
+                float score = glm::length(triCenters[t] - centroid) * invR
+                    + kConeWeight * (1.0f - glm::dot(triNorms[t], axis));
+                if ((extra < bestExtra) || (score < bestScore)) {
+                    bestExtra = extra;
+                    bestScore = score;
+                    next = t;
+                }
+            }
+            candidates.resize (n);
+            if (next == kNoTriangle) {
+                break;
+            }
+        }
+
+      // reset the local IDs of the meshlet's vertices
+        for (uint32_t i = m.firstVert;  i < table.vertices.size();  i++) {
+            localId[table.vertices[i]] = kNotInMeshlet;
+        }
+
+        table.bounds.push_back (ComputeBounds (
+            grp, triNorms, mTris, &table.vertices[m.firstVert], m.nVerts));
+        table.meshlets.push_back (m);
+    }
+
+    return table;
+
+}
+
+void CullMeshlets (
+    MeshletTable const &table,
+    glm::mat4 const &mvp,
+    glm::vec3 const &eye,
+    std::vector<uint32_t> &visible)
+{
+  // extract the frustum planes from the matrix (Gribb and Hartmann); the planes
+  // point inwards.  Note that Vulkan clip space has 0 <= z <= w.
+    glm::vec4 r0(mvp[0][0], mvp[1][0], mvp[2][0], mvp[3][0]);
+    glm::vec4 r1(mvp[0][1], mvp[1][1], mvp[2][1], mvp[3][1]);
+    glm::vec4 r2(mvp[0][2], mvp[1][2], mvp[2][2], mvp[3][2]);
+    glm::vec4 r3(mvp[0][3], mvp[1][3], mvp[2][3], mvp[3][3]);
+    glm::vec4 planes[6] = { r3 + r0, r3 - r0, r3 + r1, r3 - r1, r2, r3 - r2 };
+    for (int i = 0;  i < 6;  i++) {
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+
+    visible.clear();
+    for (uint32_t i = 0;  i < table.bounds.size();  i++) {
+        MeshletBounds const &b = table.bounds[i];
+        glm::vec3 center(b.sphere);
+        float radius = b.sphere.w;
+      // frustum test
+        bool inside = true;
+        for (int j = 0;  inside && (j < 6);  j++) {
+            inside = (glm::dot(glm::vec3(planes[j]), center) + planes[j].w >= -radius);
+        }
+        if (! inside) {
+            continue;
+        }
+      // back-face test
+        glm::vec3 d = center - eye;
+        if (glm::dot(d, glm::vec3(b.cone)) >= b.cone.w * glm::length(d) + radius) {
+            continue;
+        }
+        visible.push_back (i);
+    }
+
+}
+
+} // namespace OBJ
@@ -0,0 +1,214 @@
+/*! \file obj-optimize.cpp
+ *
+ * Optimization of the triangle and vertex order of OBJ groups.  Triangles are
+ * reordered for the GPU's post-transform vertex cache using the "Tipsify"
+ * algorithm from
+ *
+ *      Fast Triangle Reordering for Vertex Locality and Reduced Overdraw
+ *      by Pedro V. Sander, Diego Nehab, and Joshua Barczak
+ *      ACM Transactions on Graphics (SIGGRAPH 2007)
+ *
+ * and then the vertices are renumbered in order of first use, which improves
+ * the locality of vertex fetches.
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#include "obj.hpp"
+#include <algorithm>
+
+namespace OBJ {
+
+CacheStats AnalyzeVertexCache (struct Group const &grp, uint32_t cacheSize)
+{
+    CacheStats stats = { 0.0f, 0.0f };
+    uint32_t nTris = grp.nIndices / 3;
+    if ((nTris == 0) || (grp.nVerts == 0)) {
+        return stats;
+    }
+
+  // simulate a FIFO cache; a vertex is in the cache if it was loaded
+  // within the last cacheSize misses.
+    std::vector<uint32_t> loadedAt(grp.nVerts, 0);  // miss count + 1 when loaded (0 = never)
+    uint32_t nMisses = 0;
+    for (uint32_t i = 0;  i < grp.nIndices;  i++) {
+        uint32_t v = grp.indices[i];
+        if ((loadedAt[v] == 0) || (nMisses + 1 - loadedAt[v] > cacheSize)) {
+            nMisses++;
+            loadedAt[v] = nMisses;
+        }
+    }
+
+    stats.acmr = float(nMisses) / float(nTris);
+    stats.atvr = float(nMisses) / float(grp.nVerts);
+
+    return stats;
+
+}
+
+// the Tipsify algorithm; returns the new triangle order
+static std::vector<uint32_t> Tipsify (struct Group const &grp, uint32_t cacheSize)
+{
+    uint32_t nVerts = grp.nVerts;
+    uint32_t nTris = grp.nIndices / 3;
+    const uint32_t *indices = grp.indices;
+
+  // build the vertex-triangle adjacency in compressed form
+    std::vector<uint32_t> adjOffset(nVerts + 1, 0);
+    for (uint32_t i = 0;  i < grp.nIndices;  i++) {
+        adjOffset[indices[i] + 1]++;
+    }
+    for (uint32_t v = 0;  v < nVerts;  v++) {
+        adjOffset[v + 1] += adjOffset[v];
+    }
+    std::vector<uint32_t> adj(grp.nIndices);
+    {
+        std::vector<uint32_t> pos(adjOffset.begin(), adjOffset.end() - 1);
+        for (uint32_t i = 0;  i < grp.nIndices;  i++) {
+            adj[pos[indices[i]]++] = i / 3;
+        }
+    }
+
+  // the number of unemitted triangles that use each vertex
+    std::vector<uint32_t> live(nVerts);
+    for (uint32_t v = 0;  v < nVerts;  v++) {
+        live[v] = adjOffset[v + 1] - adjOffset[v];
+    }
+
+    std::vector<uint32_t> cacheTime(nVerts, 0);    // time stamp of when the vertex entered
+                                                    // the cache
+    std::vector<bool> emitted(nTris, false);
+    std::vector<uint32_t> deadEnd;                  // stack of recently used vertices
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> order;
+    order.reserve (nTris);
+
+    int64_t fanning = 0;                            // the current fanning vertex
+    uint32_t time = cacheSize + 1;
+    uint32_t cursor = 1;                            // the next vertex to consider when we
+                                                    // hit a dead end
+    while (fanning >= 0) {
+        candidates.clear();
+      // emit the unemitted triangles adjacent to the fanning vertex
+        for (uint32_t k = adjOffset[fanning];  k < adjOffset[fanning + 1];  k++) {
+            uint32_t t = adj[k];
+            if (! emitted[t]) {
+                for (int j = 0;  j < 3;  j++) {
+                    uint32_t v = indices[3*t + j];
+                    deadEnd.push_back (v);
+                    candidates.push_back (v);
+                    live[v]--;
+                    if (time - cacheTime[v] > cacheSize) {
+                        cacheTime[v] = time;
+                        time++;
+                    }
+                }
+                emitted[t] = true;
+                order.push_back (t);
+            }
+        }
+      // pick the next fanning vertex; we prefer the candidate that will stay in
+      // the cache the longest after its remaining triangles are emitted.
+        int64_t best = -1;
+        int64_t bestPriority = -1;
+        for (uint32_t v : candidates) {
+            if (live[v] > 0) {
+                int64_t priority = 0;
+                if (time - cacheTime[v] + 2 * live[v] <= cacheSize) {
+                    priority = time - cacheTime[v];
+                }
+                if (priority > bestPriority) {
+                    bestPriority = priority;
+                    best = v;
+                }
+            }
+        }
+        if (best < 0) {
+          // dead end: first try recently used vertices and then scan forward
+            while (!deadEnd.empty() && (best < 0)) {
+                uint32_t d = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[d] > 0) {
+                    best = d;
+                }
+            }
+            while ((best < 0) && (cursor < nVerts)) {
+                if (live[cursor] > 0) {
+                    best = cursor;
+                }
+                else {
+                    cursor++;
+                }
+            }
+        }
+        fanning = best;
+    }
+
+    return order;
+
+}
+
+void OptimizeGroup (struct Group &grp, uint32_t cacheSize)
+{
+    uint32_t nTris = grp.nIndices / 3;
+    if (nTris == 0) {
+        return;
+    }
+
+  // reorder the triangles
+    std::vector<uint32_t> order = Tipsify (grp, cacheSize);
+    assert (order.size() == nTris);
+    std::vector<uint32_t> indices(grp.nIndices);
+    for (uint32_t i = 0;  i < nTris;  i++) {
+        uint32_t t = order[i];
+        indices[3*i + 0] = grp.indices[3*t + 0];
+        indices[3*i + 1] = grp.indices[3*t + 1];
+        indices[3*i + 2] = grp.indices[3*t + 2];
+    }
+
+  // renumber the vertices in order of first use
+    const uint32_t kUnused = 0xffffffff;
+    std::vector<uint32_t> remap(grp.nVerts, kUnused);
+    uint32_t nextId = 0;
+    for (uint32_t i = 0;  i < grp.nIndices;  i++) {
+        uint32_t v = indices[i];
+        if (remap[v] == kUnused) {
+            remap[v] = nextId++;
+        }
+        grp.indices[i] = remap[v];
+    }
+  // vertices that are not referenced go at the end
+    for (uint32_t v = 0;  v < grp.nVerts;  v++) {
+        if (remap[v] == kUnused) {
+            remap[v] = nextId++;
+        }
+    }
+
+  // permute the vertex attributes
+    std::vector<glm::vec3> tmp3(grp.nVerts);
+    for (uint32_t v = 0;  v < grp.nVerts;  v++) {
+        tmp3[remap[v]] = grp.verts[v];
+    }
+    std::copy (tmp3.begin(), tmp3.end(), grp.verts);
+    if (grp.norms != nullptr) {
+        for (uint32_t v = 0;  v < grp.nVerts;  v++) {
+            tmp3[remap[v]] = grp.norms[v];
+        }
+        std::copy (tmp3.begin(), tmp3.end(), grp.norms);
+    }
+    if (grp.txtCoords != nullptr) {
+        std::vector<glm::vec2> tmp2(grp.nVerts);
+        for (uint32_t v = 0;  v < grp.nVerts;  v++) {
+            tmp2[remap[v]] = grp.txtCoords[v];
+        }
+        std::copy (tmp2.begin(), tmp2.end(), grp.txtCoords);
+    }
+
+}
+
+} // namespace OBJ
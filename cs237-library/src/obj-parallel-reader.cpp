@@ -0,0 +1,474 @@
+/*! \file obj-parallel-reader.cpp
+ *
+ * A multi-threaded reader for large OBJ files.  The memory-mapped file is
+ * split at line boundaries into chunks that are parsed in parallel.  Each
+ * chunk records its data with chunk-relative indices, plus the group and
+ * material changes that it contains.  A serial pass then computes the prefix
+ * sums of the chunk sizes and replays the group/material changes, after which
+ * the chunks are copied into the model in parallel.
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#include "cs237.hpp"
+#include "obj-reader.hpp"
+#include "obj-scan.hpp"
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+using namespace OBJ::__details;
+
+// files are split into chunks of at least this many bytes
+static const size_t kMinChunkSize = 1024 * 1024;
+
+// the number of chunks per thread, which helps balance the load
+static const size_t kChunksPerThread = 4;
+
+// make a copy of a string that can be freed with `delete[]`
+static char *copyString (std::string const &s)
+{
+    char *cp = new char[s.size()+1];
+    std::memcpy (cp, s.c_str(), s.size()+1);
+    return cp;
+}
+
+// the result of parsing one chunk of the file
+struct Chunk {
+  // changes to the reader state that have to be replayed in order
+    enum EventKind { GROUP, MATERIAL, MTLLIB };
+    struct Event {
+        EventKind kind;
+        uint32_t tri;                   // the number of chunk triangles that precede
+                                        // the event
+        std::string name;               // the group, material, or library name
+
+        Event (EventKind k, uint32_t t, std::string const &n) : kind(k), tri(t), name(n) { }
+    };
+  // a triangle index that was relative; the index holds the chunk-relative index
+  // and needs to have the number of items in the preceding chunks added to it.
+    enum FixupKind { VERTEX, NORMAL, TEXCOORD };
+    struct Fixup {
+        uint32_t tri;                   // the chunk-relative triangle
+        uint8_t kind;                   // which array the index refers to
+        uint8_t j;                      // which corner of the triangle
+    };
+  // a diagnostic message
+    struct Message {
+        int lnum;                       // chunk-relative line number
+        const char *msg;
+    };
+
+    const char *begin;                  // the text of the chunk
+    const char *end;
+    int nLines;                         // the number of lines in the chunk
+    bool ok;                            // false if there was a fatal error
+    std::vector<glm::vec3> verts;
+    std::vector<glm::vec3> norms;
+    std::vector<glm::vec2> txtCoords;
+    std::vector<OBJtriangle> tris;
+    std::vector<Fixup> fixups;
+    std::vector<Event> events;
+    std::vector<Message> msgs;
+
+    Chunk (const char *b, const char *e) : begin(b), end(e), nLines(0), ok(true) { }
+
+    void warning (const char *msg) { this->msgs.push_back (Message{this->nLines, msg}); }
+
+  // convert an OBJ index to a chunk-relative index; relative (i.e., negative)
+  // indices set the `kind` bit in `rel`, since they will need fix-up.
+    static uint32_t index (int32_t ix, uint32_t n, FixupKind kind, uint8_t &rel)
+    {
+        if (ix < 0) {
+            rel |= (1 << kind);
+          // the +1 is because the model's arrays are 1-based
+            return static_cast<uint32_t>(ix + static_cast<int32_t>(n) + 1);
+        }
+        else {
+            return ix;
+        }
+    }
+
+    void parseFace (const char *p, const char *eol);
+    void parse ();
+
+};
+
+// parse a face; this function must match `Parser::parseFace` in obj-map-reader.cpp.
+void Chunk::parseFace (const char *p, const char *eol)
+{
+    OBJtriangle tri;
+    uint8_t rel[3];                     // which indices of each corner are relative
+    uint32_t nv = 0;
+    while ((p = skipBlanks(p, eol)) < eol) {
+        int32_t v, t, n;
+        if ((p = scanFaceVertex(p, eol, v, t, n)) == nullptr) {
+            this->warning ("invalid face");
+            return;
+        }
+        uint32_t j = nv;
+        if (nv >= 3) {
+          // start a new triangle in the fan
+            tri.vindices[1] = tri.vindices[2];
+            tri.tindices[1] = tri.tindices[2];
+            tri.nindices[1] = tri.nindices[2];
+            rel[1] = rel[2];
+            j = 2;
+        }
+        rel[j] = 0;
+        tri.vindices[j] = index(v, this->verts.size(), VERTEX, rel[j]);
+        tri.tindices[j] = index(t, this->txtCoords.size(), TEXCOORD, rel[j]);
+        tri.nindices[j] = index(n, this->norms.size(), NORMAL, rel[j]);
+        if (++nv >= 3) {
+            uint32_t id = this->tris.size();
+            for (uint8_t k = 0;  k < 3;  ++k) {
+                for (uint8_t kind = VERTEX;  kind <= TEXCOORD;  ++kind) {
+                    if (rel[k] & (1 << kind)) {
+                        this->fixups.push_back (Fixup{id, kind, k});
+                    }
+                }
+            }
+            this->tris.push_back (tri);
+        }
+    }
+    if (nv < 3) {
+        this->warning ("face has fewer than three vertices");
+    }
+
+}
+
+// parse the lines of the chunk; this function must match `Parser::parse` in
+// obj-map-reader.cpp.
+void Chunk::parse ()
+{
+    const char *p = this->begin;
+    const char *e = this->end;
+    while (p < e) {
+        this->nLines++;
+        const char *eol = endOfLine (p, e);
+        p = skipBlanks (p, eol);
+        if ((p == eol) || (*p == '#')) {
+            p = (eol < e) ? eol + 1 : e;
+            continue;
+        }
+        const char *tok = p;
+        p = skipToken (p, eol);
+        size_t tokLen = p - tok;
+        if ((tokLen == 1) && (tok[0] == 'v')) {
+            glm::vec3 v;
+            if (((p = scanFloat(skipBlanks(p, eol), eol, v.x)) == nullptr)
+            ||  ((p = scanFloat(skipBlanks(p, eol), eol, v.y)) == nullptr)
+            ||  ((p = scanFloat(skipBlanks(p, eol), eol, v.z)) == nullptr)) {
+                this->warning ("invalid vertex");
+                this->ok = false;
+                return;
+            }
+            this->verts.push_back (v);
+        }
+        else if ((tokLen == 2) && (tok[0] == 'v') && (tok[1] == 'n')) {
+            glm::vec3 n;
+            if (((p = scanFloat(skipBlanks(p, eol), eol, n.x)) == nullptr)
+            ||  ((p = scanFloat(skipBlanks(p, eol), eol, n.y)) == nullptr)
+            ||  ((p = scanFloat(skipBlanks(p, eol), eol, n.z)) == nullptr)) {
+                this->warning ("invalid normal");
+                this->ok = false;
+                return;
+            }
+            this->norms.push_back (n);
+        }
+        else if ((tokLen == 2) && (tok[0] == 'v') && (tok[1] == 't')) {
+            glm::vec2 t;
+            if ((p = scanFloat(skipBlanks(p, eol), eol, t.x)) == nullptr) {
+                this->warning ("invalid texture coordinate");
+                this->ok = false;
+                return;
+            }
+          // the second coordinate is optional
+            if ((p = scanFloat(skipBlanks(p, eol), eol, t.y)) == nullptr) {
+                t.y = 0.0f;
+            }
+            this->txtCoords.push_back (t);
+        }
+        else if ((tokLen == 1) && (tok[0] == 'f')) {
+            this->parseFace (p, eol);
+        }
+        else if ((tokLen == 1) && (tok[0] == 'g')) {
+            p = skipBlanks (p, eol);
+            const char *q = eol;
+            while ((q > p) && isBlank(q[-1])) {
+                q--;
+            }
+            this->events.emplace_back (GROUP, this->tris.size(),
+                (p < q) ? std::string(p, q - p) : std::string("default"));
+        }
+        else if ((tokLen == 6) && (std::strncmp(tok, "usemtl", 6) == 0)) {
+            p = skipBlanks (p, eol);
+            this->events.emplace_back (MATERIAL, this->tris.size(),
+                std::string(p, skipToken(p, eol) - p));
+        }
+        else if ((tokLen == 6) && (std::strncmp(tok, "mtllib", 6) == 0)) {
+            p = skipBlanks (p, eol);
+            this->events.emplace_back (MTLLIB, this->tris.size(),
+                std::string(p, skipToken(p, eol) - p));
+        }
+        /* else ignore the line */
+        p = (eol < e) ? eol + 1 : e;
+    }
+
+}
+
+// the group state that is computed by replaying the chunk events
+struct GroupInfo {
+    std::string name;
+    std::string material;               // "" for no material
+    uint32_t numTris;                   // total number of triangles in the group
+  // runs of consecutive triangles that belong to the group; each run is a pair
+  // of the first triangle and the number of triangles.
+    std::vector<std::pair<uint32_t,uint32_t>> runs;
+
+    explicit GroupInfo (std::string const &n) : name(n), numTris(0) { }
+};
+
+// replay the group and material changes in file order; this code must match
+// the semantics of `ModelBuilder::setGroup` and `ModelBuilder::useMaterial` in
+// obj-map-reader.cpp.
+struct Replay {
+    std::vector<GroupInfo> groups;      // groups in order of creation
+    std::unordered_map<std::string, int> groupMap;
+    int curGrp;
+    std::string curMtl;
+    std::string mtllib;
+
+    Replay () : curGrp(-1) { }
+
+    void setGroup (std::string const &name)
+    {
+        auto it = this->groupMap.find(name);
+        if (it == this->groupMap.end()) {
+            this->curGrp = this->groups.size();
+            this->groups.emplace_back (name);
+            this->groupMap.insert (std::pair<std::string, int>(name, this->curGrp));
+        }
+        else {
+            this->curGrp = it->second;
+        }
+        this->groups[this->curGrp].material = this->curMtl;
+    }
+
+    GroupInfo &group ()
+    {
+        if (this->curGrp < 0) {
+            this->setGroup ("default");
+        }
+        return this->groups[this->curGrp];
+    }
+
+  // add the triangles [first..first+n) to the current group
+    void addRun (uint32_t first, uint32_t n)
+    {
+        if (n == 0) {
+            return;
+        }
+        GroupInfo &grp = this->group();
+        if (!grp.runs.empty() && (grp.runs.back().first + grp.runs.back().second == first)) {
+            grp.runs.back().second += n;
+        } else {
+            grp.runs.push_back (std::pair<uint32_t,uint32_t>(first, n));
+        }
+        grp.numTris += n;
+    }
+
+    void event (Chunk::Event const &ev)
+    {
+        switch (ev.kind) {
+        case Chunk::GROUP:
+            this->setGroup (ev.name);
+            break;
+        case Chunk::MATERIAL: {
+                this->curMtl = ev.name;
+                GroupInfo &grp = this->group();
+                if (grp.material.empty()) {
+                    grp.material = this->curMtl;
+                }
+            } break;
+        case Chunk::MTLLIB:
+            this->mtllib = ev.name;
+            break;
+        }
+    }
+
+};
+
+/* OBJReadParallelOBJ: Reads a model description from a Wavefront .OBJ file
+ * by parsing chunks of a memory mapping of the file in parallel.
+ */
+OBJmodel *OBJReadParallelOBJ (const char *filename, cs237::ThreadPool &pool)
+{
+    size_t nChunks;
+    {
+        MappedFile f(filename);
+        if (! f.isValid()) {
+            fprintf(stderr, "OBJReadParallelOBJ() failed: can't open data file \"%s\".\n",
+                filename);
+            return nullptr;
+        }
+        nChunks = std::min(
+            f.size() / kMinChunkSize,
+            kChunksPerThread * (pool.numThreads() + 1));
+    }
+    if ((nChunks < 2) || (pool.numThreads() < 2)) {
+      // the file is too small to be worth splitting or there is no parallelism
+        return OBJReadMappedOBJ (filename);
+    }
+
+    MappedFile f(filename);
+    if (! f.isValid()) {
+        fprintf(stderr, "OBJReadParallelOBJ() failed: can't open data file \"%s\".\n",
+            filename);
+        return nullptr;
+    }
+
+  // split the file into chunks at line boundaries
+    std::vector<Chunk> chunks;
+    chunks.reserve (nChunks);
+    {
+        const char *start = f.begin();
+        for (size_t i = 1;  (i <= nChunks) && (start < f.end());  ++i) {
+            const char *stop = f.end();
+            if (i < nChunks) {
+                const char *target = f.begin() + (f.size() / nChunks) * i;
+                if (target < start) {
+                    target = start;
+                }
+                stop = endOfLine (target, f.end());
+                if (stop < f.end()) {
+                    stop++;
+                }
+            }
+            chunks.emplace_back (start, stop);
+            start = stop;
+        }
+    }
+
+  // parse the chunks in parallel
+    pool.parallelFor (chunks.size(), [&chunks](size_t i) { chunks[i].parse(); });
+
+  // report diagnostics with file line numbers; we stop at the first fatal error
+    {
+        int lnum = 0;
+        for (auto &c : chunks) {
+            for (auto &m : c.msgs) {
+                fprintf(stderr, "OBJReadParallelOBJ(): %s at line %d of \"%s\"\n",
+                    m.msg, lnum + m.lnum, filename);
+            }
+            if (! c.ok) {
+                return nullptr;
+            }
+            lnum += c.nLines;
+        }
+    }
+
+  // compute the offsets of each chunk's data in the model arrays and replay the
+  // group and material changes
+    struct Offsets { uint32_t vert, norm, txtCoord, tri; };
+    std::vector<Offsets> offsets(chunks.size());
+    Offsets total = { 0, 0, 0, 0 };
+    Replay replay;
+    for (size_t i = 0;  i < chunks.size();  ++i) {
+        Chunk &c = chunks[i];
+        offsets[i] = total;
+        uint32_t pos = 0;
+        for (auto &ev : c.events) {
+            replay.addRun (total.tri + pos, ev.tri - pos);
+            pos = ev.tri;
+            replay.event (ev);
+        }
+        replay.addRun (total.tri + pos, c.tris.size() - pos);
+        total.vert += c.verts.size();
+        total.norm += c.norms.size();
+        total.txtCoord += c.txtCoords.size();
+        total.tri += c.tris.size();
+    }
+
+  // allocate the model's arrays
+    OBJmodel *model = new OBJmodel();
+    if (! replay.mtllib.empty()) {
+        model->mtllibname = copyString (replay.mtllib);
+    }
+    model->numvertices = total.vert;
+    model->vertices = new glm::vec3[total.vert + 1];
+    model->vertices[0] = glm::vec3(0.0f);
+    model->numnormals = total.norm;
+    if (total.norm > 0) {
+        model->normals = new glm::vec3[total.norm + 1];
+        model->normals[0] = glm::vec3(0.0f);
+    }
+    model->numtexcoords = total.txtCoord;
+    if (total.txtCoord > 0) {
+        model->texcoords = new glm::vec2[total.txtCoord + 1];
+        model->texcoords[0] = glm::vec2(0.0f);
+    }
+    model->numtriangles = total.tri;
+    model->triangles = new OBJtriangle[total.tri];
+
+  // copy the chunk data into the model and fix up the relative indices
+    pool.parallelFor (chunks.size(), [&chunks, &offsets, model](size_t i) {
+        Chunk &c = chunks[i];
+        Offsets const &offs = offsets[i];
+        std::copy (c.verts.begin(), c.verts.end(), model->vertices + 1 + offs.vert);
+        std::copy (c.norms.begin(), c.norms.end(), model->normals + 1 + offs.norm);
+        std::copy (c.txtCoords.begin(), c.txtCoords.end(),
+            model->texcoords + 1 + offs.txtCoord);
+        OBJtriangle *tris = model->triangles + offs.tri;
+        std::copy (c.tris.begin(), c.tris.end(), tris);
+        for (auto &fx : c.fixups) {
+            OBJtriangle &tri = tris[fx.tri];
+            switch (fx.kind) {
+            case Chunk::VERTEX: tri.vindices[fx.j] += offs.vert; break;
+            case Chunk::NORMAL: tri.nindices[fx.j] += offs.norm; break;
+            case Chunk::TEXCOORD: tri.tindices[fx.j] += offs.txtCoord; break;
+            }
+        }
+      // free the chunk's storage now that it has been copied
+        c = Chunk(c.begin, c.end);
+    });
+
+  // create the groups; the model's group list is in reverse order of creation
+  // and groups without triangles are omitted.
+    std::vector<OBJgroup *> grps;
+    for (auto &info : replay.groups) {
+        if (info.numTris > 0) {
+            OBJgroup *grp = new OBJgroup;
+            grp->name = copyString (info.name);
+            grp->material = info.material.empty() ? nullptr : copyString (info.material);
+            grp->numtriangles = info.numTris;
+            grp->triangles = new uint32_t[info.numTris];
+            grp->next = model->groups;
+            model->groups = grp;
+            model->numgroups++;
+            grps.push_back (grp);
+        }
+        else {
+            grps.push_back (nullptr);
+        }
+    }
+    pool.parallelFor (grps.size(), [&replay, &grps](size_t i) {
+        if (grps[i] != nullptr) {
+            uint32_t *dst = grps[i]->triangles;
+            for (auto &run : replay.groups[i].runs) {
+                for (uint32_t j = 0;  j < run.second;  ++j) {
+                    *dst++ = run.first + j;
+                }
+            }
+        }
+    });
+
+    return model;
+
+}
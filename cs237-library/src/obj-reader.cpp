@@ -526,7 +526,7 @@ OBJmodel::~OBJmodel ()
         delete[] group->name;
         if (group->material) { delete[] group->material; }
         delete[] group->triangles;
-        delete[] group;
+        delete group;
     }
 
 }
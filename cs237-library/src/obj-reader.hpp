@@ -6,6 +6,7 @@
 #define _OBJ_READER_HXX_
 
 #include <glm/glm.hpp>
+#include <string>
 
 /* OBJtriangle: Structure that defines a triangle in a model.
  */
@@ -59,4 +60,61 @@ struct OBJmodel {
  */
 OBJmodel *OBJReadOBJ (const char* filename);
 
+/* OBJReadMappedOBJ: Reads a model description from a Wavefront .OBJ file
+ * in a single pass over a memory mapping of the file.  The result is the
+ * same as for OBJReadOBJ, except that groups without any triangles are
+ * omitted.  Returns nullptr if the file cannot be read.
+ *
+ * filename - name of the file containing the Wavefront .OBJ format data.
+ */
+OBJmodel *OBJReadMappedOBJ (const char* filename);
+
+/* OBJVisitor: The interface for the streaming OBJ reader.  The reader calls
+ * the visitor's methods as it parses the file, in file order, without
+ * building an OBJmodel.
+ */
+class OBJVisitor {
+  public:
+    virtual ~OBJVisitor () { }
+
+  /* a "v" line */
+    virtual void vertex (glm::vec3 const &v) = 0;
+  /* a "vn" line */
+    virtual void normal (glm::vec3 const &n) = 0;
+  /* a "vt" line */
+    virtual void texCoord (glm::vec2 const &t) = 0;
+  /* a triangle of a face (polygons are split into fans); the indices are
+   * absolute 1-based indices, with 0 for a missing normal or texture
+   * coordinate.
+   */
+    virtual void triangle (OBJtriangle const &tri) = 0;
+  /* a "g" line; the name is "default" if none is given */
+    virtual void group (std::string const &name) = 0;
+  /* a "usemtl" line */
+    virtual void useMaterial (std::string const &name) = 0;
+  /* a "mtllib" line */
+    virtual void materialLib (std::string const &name) = 0;
+};
+
+/* OBJStreamOBJ: Parses a Wavefront .OBJ file and passes its contents to a
+ * visitor.  Returns false if the file cannot be read or has a syntax error.
+ *
+ * filename - name of the file containing the Wavefront .OBJ format data.
+ * visitor  - the visitor that receives the contents of the file
+ */
+bool OBJStreamOBJ (const char* filename, OBJVisitor &visitor);
+
+namespace cs237 { class ThreadPool; }
+
+/* OBJReadParallelOBJ: Reads a model description from a Wavefront .OBJ file
+ * by splitting a memory mapping of the file into chunks that are parsed in
+ * parallel using the given thread pool.  The result is the same as for
+ * OBJReadMappedOBJ, which is used for files that are too small to split.
+ * Returns nullptr if the file cannot be read.
+ *
+ * filename - name of the file containing the Wavefront .OBJ format data.
+ * pool     - the thread pool used to parse the chunks
+ */
+OBJmodel *OBJReadParallelOBJ (const char* filename, cs237::ThreadPool &pool);
+
 #endif /*! _OBJ_READER_HXX_ */
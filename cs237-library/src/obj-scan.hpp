@@ -0,0 +1,323 @@
+/*! \file obj-scan.hpp
+ *
+ * Helper code for scanning the text of memory-mapped OBJ files.  These
+ * functions replace the stdio-based scanning (`fscanf`/`sscanf`) of the
+ * original reader with hand-written scanners that work directly on the
+ * bytes of the file.  It also holds the other internal helpers that are
+ * shared by the OBJ sources.
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#ifndef _OBJ_SCAN_HPP_
+#define _OBJ_SCAN_HPP_
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+namespace OBJ {
+
+namespace __details {
+
+//! a read-only memory mapping of a file
+class MappedFile {
+  public:
+
+  //! map the named file into memory; use `isValid` to check for success
+  //! \param file     the file to map
+  //! \param writable if true, then the pages are mapped copy-on-write, so the
+  //!                 data can be modified without changing the file.
+    explicit MappedFile (const char *file, bool writable = false);
+    ~MappedFile ();
+
+    MappedFile (MappedFile const &) = delete;
+    MappedFile &operator= (MappedFile const &) = delete;
+
+  //! did the file get mapped?
+    bool isValid () const { return this->_data != nullptr; }
+
+  //! the first byte of the file
+    const char *begin () const { return this->_data; }
+
+  //! one past the last byte of the file
+    const char *end () const { return this->_data + this->_sz; }
+
+  //! the size of the file in bytes
+    size_t size () const { return this->_sz; }
+
+  //! \brief drop the pages of a read-only mapping that lie entirely before p from
+  //!        memory; they are reread from the file if they are touched again.
+  //!        This is used to bound the memory used by a sequential pass over
+  //!        the file.
+  //! \param p  a pointer into the mapping
+    void release (const char *p) const;
+
+  private:
+    const char *_data;  //!< the mapped data (nullptr on failure)
+    size_t _sz;         //!< the size of the mapping
+    bool _mapped;       //!< true if _data needs to be unmapped
+
+};
+
+//! a growable array that is allocated using `new[]`, so that its storage
+//! can be handed off to an `OBJmodel`.
+template <typename T>
+class GrowArray {
+  public:
+    GrowArray () : _data(nullptr), _len(0), _cap(0) { }
+    GrowArray (GrowArray &&a) noexcept : _data(a._data), _len(a._len), _cap(a._cap)
+    {
+        a._data = nullptr;
+        a._len = a._cap = 0;
+    }
+    GrowArray (GrowArray const &) = delete;
+    ~GrowArray () { delete[] this->_data; }
+
+  //! the number of elements in the array
+    uint32_t size () const { return this->_len; }
+
+  //! make sure that there is space for at least n elements
+    void reserve (uint32_t n)
+    {
+        if (this->_cap < n) {
+            this->_grow (n);
+        }
+    }
+
+  //! add a new element to the end of the array and return its address
+    T *push ()
+    {
+        if (this->_len == this->_cap) {
+            this->_grow (this->_len + 1);
+        }
+        return &this->_data[this->_len++];
+    }
+
+  //! add an element to the end of the array
+    void push (T const &v) { *this->push() = v; }
+
+    T &operator[] (uint32_t i) { return this->_data[i]; }
+    T const &operator[] (uint32_t i) const { return this->_data[i]; }
+
+  //! return the underlying storage (which must be freed with `delete[]`)
+  //! and reset the array to empty.
+    T *release ()
+    {
+        T *p = this->_data;
+        this->_data = nullptr;
+        this->_len = this->_cap = 0;
+        return p;
+    }
+
+  private:
+    T *_data;
+    uint32_t _len;
+    uint32_t _cap;
+
+    void _grow (uint32_t minCap)
+    {
+        uint32_t newCap = std::max(std::max(2 * this->_cap, minCap), uint32_t(64));
+        T *newData = new T[newCap];
+        std::copy (this->_data, this->_data + this->_len, newData);
+        delete[] this->_data;
+        this->_data = newData;
+        this->_cap = newCap;
+    }
+
+};
+
+//! a hash function for vertex positions, which is used to identify vertices
+//! that have the same position.  The components are hashed by their bits, so
+//! -0.0 is mapped to 0.0 first to be consistent with `operator==`.
+struct PosHash {
+    size_t operator() (glm::vec3 const &p) const
+    {
+        uint32_t bits[3];
+        for (int i = 0;  i < 3;  i++) {
+            float x = (p[i] == 0.0f) ? 0.0f : p[i];
+            std::memcpy (&bits[i], &x, sizeof(float));
+        }
+        uint64_t h = (uint64_t(bits[0]) * 0x9e3779b97f4a7c15ull) ^ bits[1];
+        h = (h * 0xc2b2ae3d27d4eb4full) ^ bits[2];
+        return size_t(h ^ (h >> 29));
+    }
+};
+
+inline bool isDigit (char c) { return (static_cast<unsigned>(c - '0') < 10); }
+
+//! whitespace that can occur inside an OBJ line
+inline bool isBlank (char c) { return (c == ' ') || (c == '\t') || (c == '\r'); }
+
+//! skip blanks in the range [p..e)
+inline const char *skipBlanks (const char *p, const char *e)
+{
+    while ((p < e) && isBlank(*p)) {
+        p++;
+    }
+    return p;
+}
+
+//! skip a token in the range [p..e)
+inline const char *skipToken (const char *p, const char *e)
+{
+    while ((p < e) && !isBlank(*p)) {
+        p++;
+    }
+    return p;
+}
+
+//! return the end of the line that starts at p (i.e., the address of the
+//! '\n' or e)
+inline const char *endOfLine (const char *p, const char *e)
+{
+    const char *eol = static_cast<const char *>(std::memchr(p, '\n', e - p));
+    return (eol == nullptr) ? e : eol;
+}
+
+//! scan a decimal integer with an optional sign.
+//! \return the address following the number or nullptr if there was no number
+inline const char *scanInt (const char *p, const char *e, int32_t &n)
+{
+    bool neg = false;
+    if ((p < e) && ((*p == '-') || (*p == '+'))) {
+        neg = (*p == '-');
+        p++;
+    }
+    if ((p >= e) || !isDigit(*p)) {
+        return nullptr;
+    }
+    int64_t v = 0;
+    while ((p < e) && isDigit(*p)) {
+        v = 10 * v + (*p - '0');
+        if (v > INT32_MAX) {
+            return nullptr;
+        }
+        p++;
+    }
+    n = static_cast<int32_t>(neg ? -v : v);
+    return p;
+}
+
+//! scan a vertex of a face, which has one of the forms "v", "v/t", "v//n", or
+//! "v/t/n".  Missing texture-coordinate and normal indices are set to 0.
+//! \return the address following the vertex or nullptr if there was a syntax error
+inline const char *scanFaceVertex (
+    const char *p, const char *e,
+    int32_t &v, int32_t &t, int32_t &n)
+{
+    t = n = 0;
+    if ((p = scanInt(p, e, v)) == nullptr) {
+        return nullptr;
+    }
+    if ((p < e) && (*p == '/')) {
+        p++;
+        if ((p < e) && (*p != '/')) {
+            if ((p = scanInt(p, e, t)) == nullptr) {
+                return nullptr;
+            }
+        }
+        if ((p < e) && (*p == '/')) {
+            if ((p = scanInt(p+1, e, n)) == nullptr) {
+                return nullptr;
+            }
+        }
+    }
+    return p;
+}
+
+//! slow path for floats that the fast scanner does not handle (e.g., "nan" or
+//! "inf").
+inline const char *scanFloatSlow (const char *p, const char *e, float &f)
+{
+    char buf[64];
+    size_t n = std::min(static_cast<size_t>(skipToken(p, e) - p), sizeof(buf) - 1);
+    std::memcpy (buf, p, n);
+    buf[n] = '\0';
+    char *q;
+    f = std::strtof (buf, &q);
+    return (q == buf) ? nullptr : p + (q - buf);
+}
+
+//! scan a floating-point number.  We accumulate up to 19 significant digits in an
+//! integer and then scale by a power of ten, which is exact for the common case of
+//! short decimal numbers with small exponents.
+//! \return the address following the number or nullptr if there was no number
+inline const char *scanFloat (const char *p, const char *e, float &f)
+{
+    static const double kPow10[] = {
+            1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+    const char *start = p;
+    bool neg = false;
+    if ((p < e) && ((*p == '-') || (*p == '+'))) {
+        neg = (*p == '-');
+        p++;
+    }
+    uint64_t mant = 0;
+    int nDigits = 0;    // number of significant digits in mant
+    int exp10 = 0;
+    bool any = false;
+    while ((p < e) && isDigit(*p)) {
+        if (nDigits < 19) {
+            mant = 10 * mant + (*p - '0');
+            if (mant != 0) nDigits++;
+        } else {
+            exp10++;
+        }
+        any = true;
+        p++;
+    }
+    if ((p < e) && (*p == '.')) {
+        p++;
+        while ((p < e) && isDigit(*p)) {
+            if (nDigits < 19) {
+                mant = 10 * mant + (*p - '0');
+                if (mant != 0) nDigits++;
+                exp10--;
+            }
+            any = true;
+            p++;
+        }
+    }
+    if (! any) {
+        return scanFloatSlow (start, e, f);
+    }
+    if ((p < e) && ((*p == 'e') || (*p == 'E'))) {
+        const char *q = p + 1;
+        int32_t x;
+        q = scanInt (q, e, x);
+        if (q != nullptr) {
+            exp10 += std::max(std::min(x, 1000), -1000);
+            p = q;
+        }
+    }
+    double d = static_cast<double>(mant);
+    if ((mant != 0) && (exp10 != 0)) {
+        if ((-22 <= exp10) && (exp10 < 0)) {
+            d /= kPow10[-exp10];
+        } else if ((0 < exp10) && (exp10 <= 22)) {
+            d *= kPow10[exp10];
+        } else {
+            d *= std::pow(10.0, exp10);
+        }
+    }
+    f = static_cast<float>(neg ? -d : d);
+    return p;
+}
+
+} // namespace __details
+
+} // namespace OBJ
+
+#endif // !_OBJ_SCAN_HPP_
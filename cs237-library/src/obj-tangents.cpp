@@ -0,0 +1,293 @@
+/*! \file obj-tangents.cpp
+ *
+ * Generation of smooth vertex normals and tangent frames for OBJ groups.
+ *
+ * The tangents follow the conventions of MikkTSpace (http://www.mikktspace.com):
+ * each triangle contributes the normalized direction of increasing u, projected
+ * onto the tangent plane of the vertex normal and weighted by the corner angle,
+ * and the w component is the handedness of the frame, so that the bitangent is
+ * w * cross(N, T).  Unlike MikkTSpace, we do not split vertices whose triangles
+ * have inconsistent handedness, since the group's vertices are fixed.
+ *
+ * The triangles are split into chunks that are processed in parallel.  Each
+ * chunk scatters its contributions into its own accumulation buffer, so no
+ * atomics are needed, and then the buffers are summed per vertex in parallel.
+ * Within a chunk, the per-triangle terms are computed in batches using a
+ * struct-of-arrays layout, so that the arithmetic can be vectorized.
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#include "obj.hpp"
+#include "obj-scan.hpp"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace OBJ {
+
+namespace {
+
+// the number of triangles in a SoA batch
+const uint32_t kBatchSz = 64;
+
+// the minimum number of triangles per parallel chunk
+const uint32_t kMinChunkSz = 16*1024;
+
+// the number of vertices per task when summing the accumulation buffers
+const uint32_t kReduceBlockSz = 16*1024;
+
+// the triangle positions of a batch in struct-of-arrays form
+struct PosBatch {
+    float x0[kBatchSz], y0[kBatchSz], z0[kBatchSz];
+    float x1[kBatchSz], y1[kBatchSz], z1[kBatchSz];
+    float x2[kBatchSz], y2[kBatchSz], z2[kBatchSz];
+
+    void load (struct Group const &grp, uint32_t firstTri, uint32_t n)
+    {
+        for (uint32_t i = 0;  i < n;  i++) {
+            uint32_t const *tri = &grp.indices[3 * (firstTri + i)];
+            glm::vec3 const &p0 = grp.verts[tri[0]];
+            glm::vec3 const &p1 = grp.verts[tri[1]];
+            glm::vec3 const &p2 = grp.verts[tri[2]];
+            this->x0[i] = p0.x; this->y0[i] = p0.y; this->z0[i] = p0.z;
+            this->x1[i] = p1.x; this->y1[i] = p1.y; this->z1[i] = p1.z;
+            this->x2[i] = p2.x; this->y2[i] = p2.y; this->z2[i] = p2.z;
+        }
+    }
+};
+
+// the face normals (unnormalized, so their length is twice the area) and the
+// interior angles of the triangles in a batch
+struct FaceBatch {
+    float nx[kBatchSz], ny[kBatchSz], nz[kBatchSz];
+    float len[kBatchSz];
+    float a0[kBatchSz], a1[kBatchSz], a2[kBatchSz];
+
+    void compute (PosBatch const &p, uint32_t n)
+    {
+        for (uint32_t i = 0;  i < n;  i++) {
+            float e1x = p.x1[i] - p.x0[i], e1y = p.y1[i] - p.y0[i], e1z = p.z1[i] - p.z0[i];
+            float e2x = p.x2[i] - p.x0[i], e2y = p.y2[i] - p.y0[i], e2z = p.z2[i] - p.z0[i];
+            this->nx[i] = e1y * e2z - e1z * e2y;
+            this->ny[i] = e1z * e2x - e1x * e2z;
+            this->nz[i] = e1x * e2y - e1y * e2x;
+            this->len[i] = std::sqrt(
+                this->nx[i] * this->nx[i] + this->ny[i] * this->ny[i] + this->nz[i] * this->nz[i]);
+        }
+      // the corner angles; since |e1 x e2| = |e1||e2| sin(a) and e1.e2 = |e1||e2| cos(a),
+      // we can use atan2, which is robust for small angles
+        for (uint32_t i = 0;  i < n;  i++) {
+            float e1x = p.x1[i] - p.x0[i], e1y = p.y1[i] - p.y0[i], e1z = p.z1[i] - p.z0[i];
+            float e2x = p.x2[i] - p.x0[i], e2y = p.y2[i] - p.y0[i], e2z = p.z2[i] - p.z0[i];
+            float e3x = p.x2[i] - p.x1[i], e3y = p.y2[i] - p.y1[i], e3z = p.z2[i] - p.z1[i];
+            this->a0[i] = std::atan2(this->len[i], e1x * e2x + e1y * e2y + e1z * e2z);
+            this->a1[i] = std::atan2(this->len[i], -(e1x * e3x + e1y * e3y + e1z * e3z));
+            this->a2[i] = float(M_PI) - this->a0[i] - this->a1[i];
+        }
+    }
+};
+
+// run a function over the triangles of a group in parallel chunks; the function
+// is passed the chunk index and the range of triangles
+template <typename F>
+void ForEachChunk (uint32_t nTris, uint32_t nChunks, F const &fn)
+{
+    uint32_t chunkSz = (nTris + nChunks - 1) / nChunks;
+    cs237::ThreadPool::shared().parallelFor (nChunks,
+        [&fn, nTris, chunkSz] (size_t c) {
+            uint32_t first = c * chunkSz;
+            uint32_t last = std::min(nTris, first + chunkSz);
+            fn (c, first, last);
+        });
+}
+
+// the number of chunks to use for a group with nTris triangles
+uint32_t NumChunks (uint32_t nTris)
+{
+    uint32_t nThreads = cs237::ThreadPool::shared().numThreads() + 1;
+    return std::max(1u, std::min(nThreads, nTris / kMinChunkSz));
+}
+
+// sum the per-chunk buffers into the first buffer and then apply the
+// finalization function to each element
+template <typename T, typename F>
+void Reduce (std::vector<std::vector<T>> &acc, size_t n, F const &fn)
+{
+    size_t nBlocks = (n + kReduceBlockSz - 1) / kReduceBlockSz;
+    cs237::ThreadPool::shared().parallelFor (nBlocks,
+        [&acc, &fn, n] (size_t b) {
+            size_t first = b * kReduceBlockSz;
+            size_t last = std::min(n, first + kReduceBlockSz);
+            for (size_t c = 1;  c < acc.size();  c++) {
+                for (size_t i = first;  i < last;  i++) {
+                    acc[0][i] += acc[c][i];
+                }
+            }
+            for (size_t i = first;  i < last;  i++) {
+                fn (i, acc[0][i]);
+            }
+        });
+}
+
+// return a unit vector that is orthogonal to n
+glm::vec3 AnyOrthogonal (glm::vec3 const &n)
+{
+    glm::vec3 a = (std::abs(n.x) < 0.9f) ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::vec3 t = glm::cross(n, a);
+    float len = glm::length(t);
+    return (len > 0.0f) ? t / len : glm::vec3(1.0f, 0.0f, 0.0f);
+}
+
+} // anonymous namespace
+
+void ComputeNormals (struct Group const &grp, glm::vec3 *norms, NormalWeighting wt)
+{
+    uint32_t nTris = grp.nIndices / 3;
+
+  // vertices that have the same position share a normal, so that the normals are
+  // continuous across texture seams
+    std::vector<uint32_t> posId(grp.nVerts);
+    uint32_t nPos = 0;
+    {
+        std::unordered_map<glm::vec3, uint32_t, __details::PosHash> posMap(2 * grp.nVerts);
+        for (uint32_t v = 0;  v < grp.nVerts;  v++) {
+            auto res = posMap.insert (std::pair<glm::vec3, uint32_t>(grp.verts[v], nPos));
+            if (res.second) {
+                nPos++;
+            }
+            posId[v] = res.first->second;
+        }
+    }
+
+    uint32_t nChunks = NumChunks (nTris);
+    std::vector<std::vector<glm::vec3>> acc(nChunks);
+    ForEachChunk (nTris, nChunks,
+        [&grp, &posId, &acc, nPos, wt] (size_t c, uint32_t first, uint32_t last) {
+            std::vector<glm::vec3> &sum = acc[c];
+            sum.assign (nPos, glm::vec3(0.0f));
+            PosBatch pos;
+            FaceBatch face;
+            float w0[kBatchSz], w1[kBatchSz], w2[kBatchSz];
+            for (uint32_t t = first;  t < last;  t += kBatchSz) {
+                uint32_t n = std::min(kBatchSz, last - t);
+                pos.load (grp, t, n);
+                face.compute (pos, n);
+              // the weights of the face normal at the three corners
+                if (wt == AngleWeighted) {
+                    for (uint32_t i = 0;  i < n;  i++) {
+                        float s = (face.len[i] > 0.0f) ? 1.0f / face.len[i] : 0.0f;
+                        w0[i] = face.a0[i] * s;
+                        w1[i] = face.a1[i] * s;
+                        w2[i] = face.a2[i] * s;
+                    }
+                }
+                else {
+                    for (uint32_t i = 0;  i < n;  i++) {
+                        w0[i] = w1[i] = w2[i] = 1.0f;
+                    }
+                }
+              // scatter the contributions
+                for (uint32_t i = 0;  i < n;  i++) {
+                    uint32_t const *tri = &grp.indices[3 * (t + i)];
+                    glm::vec3 fn(face.nx[i], face.ny[i], face.nz[i]);
+                    sum[posId[tri[0]]] += w0[i] * fn;
+                    sum[posId[tri[1]]] += w1[i] * fn;
+                    sum[posId[tri[2]]] += w2[i] * fn;
+                }
+            }
+        });
+
+    Reduce (acc, nPos,
+        [] (size_t, glm::vec3 &n) {
+            float len = glm::length(n);
+            n = (len > 0.0f) ? n / len : glm::vec3(0.0f, 0.0f, 1.0f);
+        });
+
+    for (uint32_t v = 0;  v < grp.nVerts;  v++) {
+        norms[v] = acc[0][posId[v]];
+    }
+
+}
+
+void ComputeTangents (struct Group const &grp, glm::vec3 const *norms, glm::vec4 *tans)
+{
+    assert (grp.txtCoords != nullptr);
+
+    uint32_t nTris = grp.nIndices / 3;
+    uint32_t nChunks = NumChunks (nTris);
+
+  // the accumulated tangent direction (xyz) and handedness (w) of each vertex
+    std::vector<std::vector<glm::vec4>> acc(nChunks);
+    ForEachChunk (nTris, nChunks,
+        [&grp, norms, &acc] (size_t c, uint32_t first, uint32_t last) {
+            std::vector<glm::vec4> &sum = acc[c];
+            sum.assign (grp.nVerts, glm::vec4(0.0f));
+            PosBatch pos;
+            FaceBatch face;
+            float tx[kBatchSz], ty[kBatchSz], tz[kBatchSz], orient[kBatchSz];
+            for (uint32_t t = first;  t < last;  t += kBatchSz) {
+                uint32_t n = std::min(kBatchSz, last - t);
+                pos.load (grp, t, n);
+                face.compute (pos, n);
+              // the direction of increasing u for each triangle (eq. 18 of the
+              // MikkTSpace paper), normalized and oriented by the sign of the
+              // triangle's area in texture space
+                for (uint32_t i = 0;  i < n;  i++) {
+                    uint32_t const *tri = &grp.indices[3 * (t + i)];
+                    glm::vec2 d1 = grp.txtCoords[tri[1]] - grp.txtCoords[tri[0]];
+                    glm::vec2 d2 = grp.txtCoords[tri[2]] - grp.txtCoords[tri[0]];
+                    float area = d1.x * d2.y - d1.y * d2.x;
+                    float e1x = pos.x1[i] - pos.x0[i], e1y = pos.y1[i] - pos.y0[i];
+                    float e1z = pos.z1[i] - pos.z0[i];
+                    float e2x = pos.x2[i] - pos.x0[i], e2y = pos.y2[i] - pos.y0[i];
+                    float e2z = pos.z2[i] - pos.z0[i];
+                    float ox = d2.y * e1x - d1.y * e2x;
+                    float oy = d2.y * e1y - d1.y * e2y;
+                    float oz = d2.y * e1z - d1.y * e2z;
+                    float len = std::sqrt(ox * ox + oy * oy + oz * oz);
+                    float s = ((area != 0.0f) && (len > 0.0f))
+                        ? ((area > 0.0f) ? 1.0f : -1.0f) / len
+                        : 0.0f;
+                    tx[i] = s * ox;
+                    ty[i] = s * oy;
+                    tz[i] = s * oz;
+                    orient[i] = (area > 0.0f) ? 1.0f : ((area < 0.0f) ? -1.0f : 0.0f);
+                }
+              // scatter the contributions, projected onto the tangent plane of
+              // each vertex and weighted by the corner angle
+                for (uint32_t i = 0;  i < n;  i++) {
+                    uint32_t const *tri = &grp.indices[3 * (t + i)];
+                    glm::vec3 ft(tx[i], ty[i], tz[i]);
+                    float angle[3] = { face.a0[i], face.a1[i], face.a2[i] };
+                    for (int j = 0;  j < 3;  j++) {
+                        glm::vec3 const &nv = norms[tri[j]];
+                        glm::vec3 pt = ft - nv * glm::dot(nv, ft);
+                        float len = glm::length(pt);
+                        if (len > 0.0f) {
+                            sum[tri[j]] += glm::vec4((angle[j] / len) * pt, angle[j] * orient[i]);
+                        }
+                    }
+                }
+            }
+        });
+
+    Reduce (acc, grp.nVerts,
+        [norms, tans] (size_t v, glm::vec4 &ts) {
+            glm::vec3 n = norms[v];
+            glm::vec3 t(ts);
+          // re-orthogonalize, since the normal may not be exactly unit length
+            t = t - n * glm::dot(n, t);
+            float len = glm::length(t);
+            t = (len > 0.0f) ? t / len : AnyOrthogonal (n);
+            tans[v] = glm::vec4(t, (ts.w < 0.0f) ? -1.0f : 1.0f);
+        });
+
+}
+
+} // namespace OBJ
@@ -12,8 +12,11 @@
 
 #include "obj.hpp"
 #include "obj-reader.hpp"
-#include <unordered_map>
+#include "obj-scan.hpp"
+#include <algorithm>
 #include <cstdlib>
+#include <memory>
+#include <unordered_map>
 
 namespace OBJ {
 
@@ -23,46 +26,324 @@ bool ReadMaterial (
     std::string const &path,            // path to directory containing material files
     std::string const &m,               // material file name
     std::vector<Material> &materials);  // vector of materials
+// the name of the cache file for an OBJ file (defined in obj-cache.cpp)
+std::string CacheFileName (std::string const &path, std::string const &cacheDir);
 }
 
-struct VInfo {
-    uint32_t _v, _n, _t;
+// the welded mesh of a group, before its vertex arrays are filled in
+struct GroupMesh {
+    std::unique_ptr<cs237::VertexWelder> welder;    // maps vertex IDs to v/n/t triples
+    std::vector<uint32_t> indices;                  // the triangles
+};
+
+// the result of reading an OBJ file, before the materials have been resolved
+struct ModelData {
+    std::string mtlLibName;             // the material library ("" for none)
+    cs237::AABBf bbox;                  // the bounding box of the vertices
+    std::vector<GroupMesh> meshes;      // the welded meshes of the groups
+    std::vector<std::string> names;     // the group names
+    std::vector<const char *> mtlNames; // the group material names (nullptr for none)
+    std::vector<std::string> mtlStore;  // storage for the material names
+  // the 1-based attribute arrays that the welded triples refer to; norms and
+  // txtCoords are nullptr if the model does not have the attribute
+    glm::vec3 const *verts;
+    glm::vec3 const *norms;
+    glm::vec2 const *txtCoords;
+  // storage for the attribute arrays
+    OBJmodel *model;                    // the model (parallel reader only)
+    std::vector<glm::vec3> vertStore;
+    std::vector<glm::vec3> normStore;
+    std::vector<glm::vec2> txtStore;
+
+    ModelData () : verts(nullptr), norms(nullptr), txtCoords(nullptr), model(nullptr) { }
+    ~ModelData () { delete this->model; }
+};
 
-    VInfo (uint32_t v, uint32_t n, uint32_t t) : _v(v), _n(n), _t(t) { }
+// the alignment of the arrays in a model's geometry block
+static const size_t kArrayAlign = 16;
 
-    struct Hash {
-        std::size_t operator() (VInfo const &v) const
-        {
-            return static_cast<std::size_t>(
-                v._v +
-                (v._n << 5) * 101 +
-                (v._t << 10) * 101);
+// the size of an array in the geometry block
+static size_t ArraySize (size_t n, size_t eltSz)
+{
+    return (n * eltSz + kArrayAlign - 1) & ~(kArrayAlign - 1);
+}
+
+// copy the triangles of a group and initialize its vertex arrays from the
+// welded v/n/t triples; the group's arrays must already be allocated.
+static void FillGroupArrays (ModelData const &data, GroupMesh const &mesh, Group &g)
+{
+    std::copy (mesh.indices.begin(), mesh.indices.end(), g.indices);
+    std::vector<cs237::VertexWelder::Key> const &keys = mesh.welder->keys();
+    for (uint32_t i = 0;  i < g.nVerts;  i++) {
+        g.verts[i] = data.verts[keys[i].a];
+    }
+    if (g.norms != nullptr) {
+        for (uint32_t i = 0;  i < g.nVerts;  i++) {
+            g.norms[i] = data.norms[keys[i].b];
         }
-    };
-    struct Equal {
-        bool operator()(VInfo const &v1, VInfo const &v2) const
-        {
-            return (v1._v == v2._v) && (v1._n == v2._n) && (v1._t == v2._t);
+    }
+    if (g.txtCoords != nullptr) {
+        for (uint32_t i = 0;  i < g.nVerts;  i++) {
+            g.txtCoords[i] = data.txtCoords[keys[i].c];
         }
+    }
+
+}
+
+// build the mesh for a group.  We need to identify unique v/n/t triplets,
+// which become the vertices of the mesh.
+static void BuildGroupMesh (OBJmodel const *model, OBJgroup const *grp, GroupMesh &mesh)
+{
+    mesh.welder.reset (new cs237::VertexWelder(grp->numtriangles));
+    mesh.indices.resize (3 * grp->numtriangles);
+    uint32_t *idxp = mesh.indices.data();
+    for (uint32_t i = 0;  i < grp->numtriangles;  i++) {
+        OBJtriangle const *tri = &(model->triangles[grp->triangles[i]]);
+        for (int j = 0;  j < 3;  j++) {
+            *idxp++ = mesh.welder->weld (tri->vindices[j], tri->nindices[j], tri->tindices[j]);
+        }
+    }
+    mesh.welder->releaseTable ();
+
+}
+
+// read a model using the parallel reader and then build the groups in parallel
+static bool ReadParallel (std::string const &path, ModelData &data)
+{
+    OBJmodel *model = OBJReadParallelOBJ (path.c_str(), cs237::ThreadPool::shared());
+    if (model == nullptr) {
+        return false;
+    }
+    data.model = model;
+    data.verts = model->vertices;
+    data.norms = (model->numnormals > 0) ? model->normals : nullptr;
+    data.txtCoords = (model->numtexcoords > 0) ? model->texcoords : nullptr;
+
+    if (model->mtllibname != nullptr) {
+        data.mtlLibName = model->mtllibname;
+    }
+
+  // compute the bounding box (note that the vertex array is 1-based)
+    for (uint32_t i = 1;  i <= model->numvertices;  i++) {
+        data.bbox.addPt (model->vertices[i]);
+    }
+
+  // build mesh data structures for the groups.  The groups are independent, so
+  // we build them in parallel, starting with the largest groups to balance the load.
+  // Note that the model's group list is in reverse order of creation.
+    std::vector<OBJgroup *> grps;
+    for (OBJgroup *grp = model->groups;  grp != nullptr;  grp = grp->next) {
+        grps.push_back (grp);
+        data.names.push_back (grp->name);
+        data.mtlStore.push_back ((grp->material != nullptr) ? grp->material : "");
+    }
+    for (uint32_t k = 0;  k < grps.size();  k++) {
+        data.mtlNames.push_back (
+            (grps[k]->material != nullptr) ? data.mtlStore[k].c_str() : nullptr);
+    }
+    data.meshes.resize (grps.size());
+    std::vector<uint32_t> order(grps.size());
+    for (uint32_t i = 0;  i < order.size();  i++) {
+        order[i] = i;
+    }
+    std::stable_sort (order.begin(), order.end(),
+        [&grps] (uint32_t a, uint32_t b) {
+            return grps[a]->numtriangles > grps[b]->numtriangles;
+        });
+    cs237::ThreadPool::shared().parallelFor (order.size(),
+        [model, &grps, &order, &data] (size_t i) {
+            uint32_t k = order[i];
+            BuildGroupMesh (model, grps[k], data.meshes[k]);
+        });
+
+    return true;
+
+}
+
+// a visitor for the streaming reader that welds the vertices of each group as
+// the triangles are read.  The group and material semantics must match
+// `ModelBuilder` in obj-map-reader.cpp.
+class StreamBuilder : public OBJVisitor {
+  public:
+    StreamBuilder (ModelData &data)
+      : _data(data), _curGrp(-1), _vertMark(1)
+    {
+      // the attribute arrays are 1-based, so we add a dummy first element
+        this->_verts.push_back (glm::vec3(0.0f));
+        this->_norms.push_back (glm::vec3(0.0f));
+        this->_txtCoords.push_back (glm::vec2(0.0f));
+    }
+
+    void vertex (glm::vec3 const &v) override
+    {
+        this->_verts.push_back (v);
+        this->_data.bbox.addPt (v);
+    }
+    void normal (glm::vec3 const &n) override { this->_norms.push_back (n); }
+    void texCoord (glm::vec2 const &t) override { this->_txtCoords.push_back (t); }
+
+    void triangle (OBJtriangle const &tri) override
+    {
+        GroupMesh &mesh = this->_currentGroup().mesh;
+        if (! mesh.welder) {
+          // size the welder for the vertices that have been read since the
+          // previous group got its welder, which is the group's own vertices for
+          // files that list each group's vertices before its faces
+            uint32_t nNew = this->_verts.size() - this->_vertMark;
+            mesh.welder.reset (new cs237::VertexWelder(nNew));
+            this->_vertMark = this->_verts.size();
+        }
+        for (int j = 0;  j < 3;  j++) {
+            mesh.indices.push_back (
+                mesh.welder->weld (tri.vindices[j], tri.nindices[j], tri.tindices[j]));
+        }
+    }
+
+    void group (std::string const &name) override { this->_setGroup (name); }
+
+    void useMaterial (std::string const &name) override
+    {
+        this->_curMtl = name;
+      // if there is already a material associated with this group, then we
+      // ignore this material.
+        GroupState &grp = this->_currentGroup();
+        if (grp.material.empty()) {
+            grp.material = this->_curMtl;
+        }
+    }
+
+    void materialLib (std::string const &name) override { this->_data.mtlLibName = name; }
+
+  // move the welded meshes and the attribute arrays to the model data; as with
+  // OBJmodel, the groups are in reverse order of creation and groups without
+  // triangles are omitted.
+    void finish ()
+    {
+        for (auto it = this->_groups.rbegin();  it != this->_groups.rend();  ++it) {
+            GroupState &grp = **it;
+            if (! grp.mesh.indices.empty()) {
+                grp.mesh.welder->releaseTable ();
+                grp.mesh.indices.shrink_to_fit ();
+                this->_data.meshes.push_back (std::move(grp.mesh));
+                this->_data.names.push_back (grp.name);
+                this->_data.mtlStore.push_back (grp.material);
+            }
+            it->reset();
+        }
+        for (uint32_t k = 0;  k < this->_data.meshes.size();  k++) {
+            this->_data.mtlNames.push_back (
+                this->_data.mtlStore[k].empty() ? nullptr : this->_data.mtlStore[k].c_str());
+        }
+        this->_data.vertStore = std::move(this->_verts);
+        this->_data.verts = this->_data.vertStore.data();
+        if (this->_norms.size() > 1) {
+            this->_data.normStore = std::move(this->_norms);
+            this->_data.norms = this->_data.normStore.data();
+        }
+        if (this->_txtCoords.size() > 1) {
+            this->_data.txtStore = std::move(this->_txtCoords);
+            this->_data.txtCoords = this->_data.txtStore.data();
+        }
+    }
+
+  private:
+    struct GroupState {
+        std::string name;
+        std::string material;           // "" for no material
+        GroupMesh mesh;
+
+        explicit GroupState (std::string const &n) : name(n), material() { }
     };
 
-}; // VInfo
+    ModelData &_data;
+    std::vector<glm::vec3> _verts;
+    std::vector<glm::vec3> _norms;
+    std::vector<glm::vec2> _txtCoords;
+    std::vector<std::unique_ptr<GroupState>> _groups;   // in order of creation
+    std::unordered_map<std::string, int> _groupMap;
+    int _curGrp;
+    std::string _curMtl;
+    uint32_t _vertMark;                 // the number of vertices when the most recent
+                                        // welder was created
+
+    void _setGroup (std::string const &name)
+    {
+        auto it = this->_groupMap.find(name);
+        if (it == this->_groupMap.end()) {
+            this->_curGrp = this->_groups.size();
+            this->_groups.push_back (std::unique_ptr<GroupState>(new GroupState(name)));
+            this->_groupMap.insert (std::pair<std::string, int>(name, this->_curGrp));
+        }
+        else {
+            this->_curGrp = it->second;
+        }
+        this->_groups[this->_curGrp]->material = this->_curMtl;
+    }
+
+    GroupState &_currentGroup ()
+    {
+        if (this->_curGrp < 0) {
+            this->_setGroup ("default");
+        }
+        return *this->_groups[this->_curGrp];
+    }
+
+};
+
+// read a model using the streaming reader
+static bool ReadStreaming (std::string const &path, ModelData &data)
+{
+    StreamBuilder builder(data);
+    if (! OBJStreamOBJ (path.c_str(), builder)) {
+        return false;
+    }
+    builder.finish ();
+
+    return true;
 
-typedef std::unordered_map<VInfo,uint32_t,VInfo::Hash,VInfo::Equal> VertexMap_t;
+}
 
 Model::Model (std::string file)
-    : _path(file), _bbox()
+    : _path(file), _bbox(), _cache(nullptr), _arena(nullptr)
+{
+    this->_loadOBJ (Options());
+
+} // Model::Model
+
+Model::Model (std::string file, Options const &opts)
+    : _path(file), _bbox(), _cache(nullptr), _arena(nullptr)
+{
+    std::string cacheFile;
+    if (opts.useCache) {
+        cacheFile = __details::CacheFileName (file, opts.cacheDir);
+        if (this->_loadCache (cacheFile, opts)) {
+            return;
+        }
+    }
+
+    this->_loadOBJ (opts);
+
+    if (opts.useCache) {
+        this->_saveCache (cacheFile, opts);
+    }
+
+} // Model::Model
+
+void Model::_loadOBJ (Options const &opts)
 {
   // read the file
-    OBJmodel *model = OBJReadOBJ (file.c_str());
-    if (model == 0) {
-        std::cerr << "unable to read model \"" << file << "\"" << std::endl;
+    ModelData data;
+    bool ok = opts.parallel
+        ? ReadParallel (this->_path, data)
+        : ReadStreaming (this->_path, data);
+    if (! ok) {
+        std::cerr << "unable to read model \"" << this->_path << "\"" << std::endl;
         exit (1);
     }
 
   // load materials
-    if (model->mtllibname != nullptr) {
-        this->_mtlLibName = model->mtllibname;
+    if (! data.mtlLibName.empty()) {
+        this->_mtlLibName = data.mtlLibName;
         if (! __details::ReadMaterial (this->_path, this->_mtlLibName, this->_materials)) {
             std::cerr << "warning: error reading material library \""
                 << this->_mtlLibName << "\"" << std::endl;
@@ -72,132 +353,100 @@ Model::Model (std::string file)
     else {
         this->_materials.clear();
     }
+    this->_indexMaterials ();
+
+    this->_bbox = data.bbox;
 
-  // compute the bounding box
-    for (uint32_t i = 0;  i < model->numvertices;  i++) {
-        this->_bbox.addPt (model->vertices[i]);
+  // allocate the geometry of all of the groups as a single block
+    size_t nBytes = 0;
+    for (auto const &mesh : data.meshes) {
+        size_t nVerts = mesh.welder->numVerts();
+        nBytes += ArraySize (nVerts, sizeof(glm::vec3))
+            + ((data.norms != nullptr) ? ArraySize (nVerts, sizeof(glm::vec3)) : 0)
+            + ((data.txtCoords != nullptr) ? ArraySize (nVerts, sizeof(glm::vec2)) : 0)
+            + ArraySize (mesh.indices.size(), sizeof(uint32_t));
     }
+    this->_arena = new cs237::Arena (nBytes);
+    this->_groups.resize (data.meshes.size());
+    for (uint32_t k = 0;  k < this->_groups.size();  k++) {
+        struct Group &g = this->_groups[k];
+        g.nVerts = data.meshes[k].welder->numVerts();
+        g.nIndices = data.meshes[k].indices.size();
+        g.verts = this->_arena->alloc<glm::vec3> (g.nVerts, kArrayAlign);
+        g.norms = (data.norms != nullptr)
+            ? this->_arena->alloc<glm::vec3> (g.nVerts, kArrayAlign)
+            : nullptr;
+        g.txtCoords = (data.txtCoords != nullptr)
+            ? this->_arena->alloc<glm::vec2> (g.nVerts, kArrayAlign)
+            : nullptr;
+        g.indices = this->_arena->alloc<uint32_t> (g.nIndices, kArrayAlign);
+    }
+    assert (this->_arena->numBlocks() <= 1);
 
-  // build mesh data structures for the groups.  We need to identify unique v/n/t
-  // triplets
-    VertexMap_t map;
-    std::vector<VInfo> verts;
-    std::vector<uint32_t> indices;
-    uint32_t idx;
-    for (OBJgroup *grp = model->groups;  grp != nullptr;  grp = grp->next) {
-        for (uint32_t i = 0;  i < grp->numtriangles;  i++) {
-            for (int j = 0;  j < 3;  j++) {
-                OBJtriangle *tri = &(model->triangles[i]);
-                VInfo v(tri->vindices[j], tri->nindices[j], tri->tindices[j]);
-                VertexMap_t::const_iterator got = map.find (v);
-                if (got == map.end()) {
-                    idx = verts.size();
-                    verts.push_back (v);
-                    map.insert (std::pair<VInfo,uint32_t>(v, idx));
-                }
-                else {
-                    idx = got->second;
-                }
-                indices.push_back(idx);
-            }
-        }
-      // here we have identified the mesh vertices for the group
-        struct Group g;
-        g.name = std::string(grp->name);
-        g.material = -1;
-        if (grp->material == nullptr) {
-            for (uint32_t i = 0;  i < this->_materials.size();  i++) {
-                if (this->_materials[i].name.compare("default") == 0) {
-                    g.material = i;
-                    break;
-                }
-            }
+  // fill in the group arrays; we free the welded meshes as we go
+    cs237::ThreadPool::shared().parallelFor (this->_groups.size(),
+        [this, &data] (size_t k) {
+            FillGroupArrays (data, data.meshes[k], this->_groups[k]);
+            data.meshes[k] = GroupMesh();
+        });
+
+  // optimize the groups
+    std::vector<CacheStats> before(this->_groups.size()), after(this->_groups.size());
+    if (opts.optimize) {
+        cs237::ThreadPool::shared().parallelFor (this->_groups.size(),
+            [this, &before, &after] (size_t k) {
+                before[k] = AnalyzeVertexCache (this->_groups[k]);
+                OptimizeGroup (this->_groups[k]);
+                after[k] = AnalyzeVertexCache (this->_groups[k]);
+            });
+    }
+
+  // resolve the group names and materials; we do this sequentially so that the
+  // warnings are reported in order
+    for (uint32_t k = 0;  k < this->_groups.size();  k++) {
+        const char *mtlName = data.mtlNames[k];
+        struct Group &g = this->_groups[k];
+        g.name = data.names[k];
+        if (mtlName == nullptr) {
+            g.material = this->MaterialIndex ("default");
             if (g.material == -1) {
                 std::cerr << "warning: no default material for group \""
                     << g.name << "\"" << std::endl;
             }
         }
         else {
-            for (uint32_t i = 0;  i < this->_materials.size();  i++) {
-                if (this->_materials[i].name.compare(grp->material) == 0) {
-                    g.material = i;
-                    break;
-                }
-            }
+            g.material = this->MaterialIndex (data.mtlStore[k]);
             if (g.material == -1) {
-                std::cerr << "warning: unable to find material \"" << grp->material
+                std::cerr << "warning: unable to find material \"" << mtlName
                     << "\" for group \"" << g.name << "\"" << std::endl;
             }
         }
-      // initialize the vertex data arrays
-        g.nVerts = verts.size();
-        g.verts = new glm::vec3[g.nVerts];
-        if ((model->numnormals > 0) && (model->numtexcoords > 0)) {
-          // has all three components
-            g.norms = new glm::vec3[g.nVerts];
-            g.txtCoords = new glm::vec2[g.nVerts];
-            for (uint32_t i = 0;  i < g.nVerts;  i++) {
-                g.verts[i] = model->vertices[verts[i]._v];
-                g.norms[i] = model->normals[verts[i]._n];
-                g.txtCoords[i] = model->texcoords[verts[i]._t];
-            }
-        }
-        else if (model->numnormals > 0) {
-            g.norms = new glm::vec3[g.nVerts];
-            g.txtCoords = nullptr;
-            for (uint32_t i = 0;  i < g.nVerts;  i++) {
-                g.verts[i] = model->vertices[verts[i]._v];
-                g.norms[i] = model->normals[verts[i]._n];
-            }
-        }
-        else if (model->numtexcoords > 0) {
-            g.norms = nullptr;
-            g.txtCoords = new glm::vec2[g.nVerts];
-            for (uint32_t i = 0;  i < g.nVerts;  i++) {
-                g.verts[i] = model->vertices[verts[i]._v];
-                g.txtCoords[i] = model->texcoords[verts[i]._t];
-            }
+        if (opts.optimize && opts.verbose) {
+            std::cout << "group \"" << g.name << "\": ACMR " << before[k].acmr
+                << " -> " << after[k].acmr << ", ATVR " << before[k].atvr
+                << " -> " << after[k].atvr << std::endl;
         }
-        else {
-            g.norms = nullptr;
-            g.txtCoords = nullptr;
-            for (uint32_t i = 0;  i < g.nVerts;  i++) {
-                g.verts[i] = model->vertices[verts[i]._v];
-            }
-        }
-      // initialize the group's indices array
-        g.nIndices = indices.size();
-        g.indices = new uint32_t[g.nIndices];
-        for (uint32_t i = 0;  i < g.nIndices;  i++) {
-            g.indices[i] = indices[i];
-        }
-      // add to this model
-        this->_groups.push_back (g);
-      // cleanup
-        map.clear();
-        verts.clear();
-        indices.clear();
     }
 
-    delete model;
+} // Model::_loadOBJ
 
-} // Model::Model
+void Model::_indexMaterials ()
+{
+    this->_mtlIndex.clear();
+    this->_mtlIndex.reserve (this->_materials.size());
+  // if there are duplicate names, then the first material wins
+    for (uint32_t i = 0;  i < this->_materials.size();  i++) {
+        this->_mtlIndex.emplace (this->_materials[i].name, i);
+    }
+
+} // Model::_indexMaterials
 
 Model::~Model ()
 {
-  // free the storage for the groups
-    for (uint32_t i = 0;  i < this->_groups.size();  i++) {
-        assert (this->_groups[i].verts != nullptr);
-        delete[] this->_groups[i].verts;
-        if (this->_groups[i].norms != nullptr) {
-            delete[] this->_groups[i].norms;
-        }
-        if (this->_groups[i].txtCoords != nullptr) {
-            delete[] this->_groups[i].txtCoords;
-        }
-        assert (this->_groups[i].indices != nullptr);
-        delete[] this->_groups[i].indices;
-    }
+  // the group data is either part of the cache-file mapping or the arena
+    delete this->_cache;
+    delete this->_arena;
+
 } // Model::~Model
 
 } // namespace OBJ
@@ -16,26 +16,152 @@ namespace cs237 {
 
 namespace __detail {
 
+// the copy region for a mipmap level that starts at the given offset in the
+// staging buffer
+static VkBufferImageCopy levelRegion (
+    VkDeviceSize offset, uint32_t level,
+    uint32_t wid, uint32_t ht)
+{
+    VkBufferImageCopy region{};
+    region.bufferOffset = offset;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = level;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = { wid, ht, 1 };
+    return region;
+}
+
+// record a layout transition for a range of mipmap levels of an image
+static void imageBarrier (
+    VkCommandBuffer cmdBuf, VkImage img,
+    uint32_t baseLevel, uint32_t nLevels,
+    VkImageLayout oldLayout, VkImageLayout newLayout,
+    VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+    VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage)
+{
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = img;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = baseLevel;
+    barrier.subresourceRange.levelCount = nLevels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+
+    vkCmdPipelineBarrier(
+        cmdBuf, srcStage, dstStage,
+        0,
+        0, nullptr,
+        0, nullptr,
+        1, &barrier);
+}
+
+// the number of levels in a full mipmap chain for an image
+static uint32_t mipLevelCount (uint32_t wid, uint32_t ht)
+{
+    uint32_t n = 1;
+    for (uint32_t sz = std::max(wid, ht);  sz > 1;  sz >>= 1) {
+        n++;
+    }
+    return n;
+}
+
+// record the commands to compute levels 1..nLevels-1 of an image by repeatedly
+// downsampling with vkCmdBlitImage.  On entry, all of the levels are in the
+// transfer-destination layout and level 0 has been written; on exit, all of
+// the levels are in the shader-read layout.
+static void recordMipBlits (
+    VkCommandBuffer cmdBuf, VkImage img,
+    uint32_t wid, uint32_t ht, uint32_t nLevels)
+{
+    int32_t w = wid, h = ht;
+    for (uint32_t i = 1;  i < nLevels;  i++) {
+        // the previous level is the source of the blit
+        imageBarrier (cmdBuf, img, i-1, 1,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        int32_t dw = std::max(w / 2, 1);
+        int32_t dh = std::max(h / 2, 1);
+        VkImageBlit blit{};
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.mipLevel = i-1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount = 1;
+        blit.srcOffsets[0] = { 0, 0, 0 };
+        blit.srcOffsets[1] = { w, h, 1 };
+        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.dstSubresource.mipLevel = i;
+        blit.dstSubresource.baseArrayLayer = 0;
+        blit.dstSubresource.layerCount = 1;
+        blit.dstOffsets[0] = { 0, 0, 0 };
+        blit.dstOffsets[1] = { dw, dh, 1 };
+        vkCmdBlitImage(
+            cmdBuf,
+            img, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            img, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &blit,
+            VK_FILTER_LINEAR);
+
+        // the previous level is finished
+        imageBarrier (cmdBuf, img, i-1, 1,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+        w = dw;
+        h = dh;
+    }
+
+    // the last level was only written
+    imageBarrier (cmdBuf, img, nLevels-1, 1,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
 TextureBase::TextureBase (
     Application *app,
     uint32_t wid, uint32_t ht,
     cs237::__detail::ImageBase const *img)
-  : _app(app)
+  : _app(app), _nLevels(1)
 {
-    void *data = img->data();
-    size_t nBytes = img->nBytes();
-    VkFormat fmt = img->format();
+    this->_loadImages (wid, ht, { img });
+}
 
-    this->_img = app->_createImage (
-        wid, ht, fmt,
-        VK_IMAGE_TILING_OPTIMAL,
-        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
-    this->_mem = app->_allocImageMemory(
-        this->_img,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    this->_view = app->_createImageView(
-        this->_img, fmt,
-        VK_IMAGE_ASPECT_COLOR_BIT);
+void TextureBase::_loadImages (
+    uint32_t wid, uint32_t ht,
+    std::vector<ImageBase const *> const &levels,
+    bool genMips)
+{
+    Application *app = this->_app;
+    VkFormat fmt = levels[0]->format();
+
+    // compute the layout of the levels in the staging buffer; the offset of a
+    // level must be a multiple of both the texel size and 4, so we align the
+    // levels to four texels
+    size_t align = 4 * (levels[0]->nBytes() / (size_t(wid) * ht));
+    std::vector<VkBufferImageCopy> regions;
+    regions.reserve (levels.size());
+    size_t nBytes = 0;
+    for (uint32_t i = 0;  i < levels.size();  i++) {
+        nBytes = align * ((nBytes + align - 1) / align);
+        regions.push_back (levelRegion (
+            nBytes, i,
+            std::max(wid >> i, 1u), std::max(ht >> i, 1u)));
+        nBytes += levels[i]->nBytes();
+    }
 
     // create a staging buffer for copying the image
     VkBuffer stagingBuf = this->_createBuffer (
@@ -47,25 +173,104 @@ TextureBase::TextureBase (
     // copy the image data to the staging buffer
     void* stagingData;
     vkMapMemory(app->_device, stagingBufMem, 0, nBytes, 0, &stagingData);
-    memcpy(stagingData, data, nBytes);
+    for (uint32_t i = 0;  i < levels.size();  i++) {
+        memcpy(
+            static_cast<uint8_t *>(stagingData) + regions[i].bufferOffset,
+            levels[i]->data(), levels[i]->nBytes());
+    }
     vkUnmapMemory(app->_device, stagingBufMem);
 
-    app->_transitionImageLayout(
-        this->_img, fmt,
-        VK_IMAGE_LAYOUT_UNDEFINED,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    app->_copyBufferToImage(this->_img, stagingBuf, nBytes, wid, ht);
-    app->_transitionImageLayout(
+    uint32_t nLevels = genMips ? mipLevelCount(wid, ht) : uint32_t(levels.size());
+    this->_init (wid, ht, fmt, nLevels);
+    this->_upload (stagingBuf, stagingBufMem, regions, genMips);
+
+}
+
+void TextureBase::_init (uint32_t wid, uint32_t ht, VkFormat fmt, uint32_t nLevels)
+{
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (nLevels > 1) {
+        // the levels might be computed by blitting from the previous level
+        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+
+    this->_nLevels = nLevels;
+    this->_img = this->_app->_createImage (
+        wid, ht, fmt,
+        VK_IMAGE_TILING_OPTIMAL,
+        usage,
+        nLevels);
+    this->_mem = this->_app->_allocImageMemory(
+        this->_img,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    this->_view = this->_app->_createImageView(
         this->_img, fmt,
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        nLevels);
+}
+
+void TextureBase::_upload (
+    VkBuffer stagingBuf, VkDeviceMemory stagingMem,
+    std::vector<VkBufferImageCopy> const &regions,
+    bool genMips)
+{
+    Application *app = this->_app;
+
+    // record the layout transitions, the copies, and any blits in a single
+    // command buffer, so that there is only one submit
+    VkCommandBuffer cmdBuf = app->_newCommandBuf();
+    app->_beginCommands(cmdBuf);
+
+    imageBarrier (cmdBuf, this->_img, 0, this->_nLevels,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        0, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    vkCmdCopyBufferToImage(
+        cmdBuf, stagingBuf, this->_img,
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        uint32_t(regions.size()), regions.data());
+    if (genMips) {
+        recordMipBlits (cmdBuf, this->_img,
+            regions[0].imageExtent.width, regions[0].imageExtent.height,
+            this->_nLevels);
+    } else {
+        imageBarrier (cmdBuf, this->_img, 0, this->_nLevels,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+
+    app->_endCommands(cmdBuf);
+    app->_submitCommands(cmdBuf);
+    app->_freeCommandBuf(cmdBuf);
 
     // free up the staging buffer
-    vkFreeMemory(app->_device, stagingBufMem, nullptr);
+    vkFreeMemory(app->_device, stagingMem, nullptr);
     vkDestroyBuffer(app->_device, stagingBuf, nullptr);
 
 }
 
+bool TextureBase::_canBlitMipmaps (VkFormat fmt, MipmapMode mode)
+{
+    if (mode == MipmapMode::CPU) {
+        return false;
+    }
+    // on a software implementation, the blits run on the CPU and are slower than
+    // computing the levels with `mipmapLevels`, so we only use them on request
+    if ((mode == MipmapMode::Auto)
+    && (this->_app->_props()->deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU)) {
+        return false;
+    }
+
+    return this->_app->_findBestFormat (
+            { fmt },
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_FORMAT_FEATURE_BLIT_SRC_BIT
+            | VK_FORMAT_FEATURE_BLIT_DST_BIT
+            | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)
+        != VK_FORMAT_UNDEFINED;
+}
+
 TextureBase::~TextureBase ()
 {
     vkDestroyImageView(this->_app->_device, this->_view, nullptr);
@@ -84,11 +289,101 @@ Texture1D::Texture1D (Application *app, Image1D const *img)
 
 /******************** class Texture2D methods ********************/
 
-Texture2D::Texture2D (Application *app, Image2D const *img, bool mipmap)
-  : __detail::TextureBase(app, img->width(), img->height(), img)
+Texture2D::Texture2D (
+    Application *app, Image2D const *img,
+    bool mipmap, bool normalMap,
+    MipmapMode mode)
+  : __detail::TextureBase(app)
+{
+    if (! mipmap) {
+        this->_loadImages (img->width(), img->height(), { img });
+    }
+    else if (!normalMap && this->_canBlitMipmaps (img->format(), mode)) {
+        this->_loadImages (img->width(), img->height(), { img }, true);
+    }
+    else {
+        this->_loadMipmapped (img, normalMap);
+    }
+}
+
+Texture2D::Texture2D (
+    Application *app, std::string const &file,
+    bool data, bool mipmap,
+    MipmapMode mode)
+  : __detail::TextureBase(app)
+{
+    std::ifstream inS(file, std::ifstream::in | std::ifstream::binary);
+    if (inS.fail()) {
+        ERROR("Texture2D: unable to open \"" + file + "\"");
+    }
+
+    // decode the image directly into a mapped staging buffer, which is
+    // allocated once the size of the image is known
+    VkBuffer stagingBuf = VK_NULL_HANDLE;
+    VkDeviceMemory stagingBufMem = VK_NULL_HANDLE;
+    void *stagingData = nullptr;
+    auto dst = [&](__detail::PNGInfo const &info) -> void * {
+        stagingBuf = this->_createBuffer (
+            info.nBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+        stagingBufMem = this->_allocBufferMemory(
+            stagingBuf,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        if (vkMapMemory(app->_device, stagingBufMem, 0, info.nBytes, 0, &stagingData) != VK_SUCCESS) {
+            stagingData = nullptr;
+        }
+        return stagingData;
+    };
+    __detail::PNGInfo info;
+    bool ok = __detail::readPNG (inS, true, true, dst, info);
+    inS.close();
+
+    if (! ok) {
+        if (stagingData != nullptr) {
+            vkUnmapMemory(app->_device, stagingBufMem);
+        }
+        if (stagingBuf != VK_NULL_HANDLE) {
+            vkFreeMemory(app->_device, stagingBufMem, nullptr);
+            vkDestroyBuffer(app->_device, stagingBuf, nullptr);
+        }
+        ERROR("Texture2D: unable to load image file \"" + file + "\"");
+    }
+
+    bool sRGB = info.sRGB && !data;
+    VkFormat fmt = __detail::toVkFormat (info.chans, info.type, sRGB);
+    if (mipmap && !this->_canBlitMipmaps (fmt, mode)) {
+        // the device cannot compute the levels, so we copy the decoded image
+        // out of the staging buffer and compute them on the CPU
+        std::unique_ptr<Image2D> img(sRGB
+            ? new Image2D (info.wid, info.ht, info.chans, info.type)
+            : new DataImage2D (info.wid, info.ht, info.chans, info.type));
+        memcpy (img->data(), stagingData, info.nBytes);
+        vkUnmapMemory(app->_device, stagingBufMem);
+        vkFreeMemory(app->_device, stagingBufMem, nullptr);
+        vkDestroyBuffer(app->_device, stagingBuf, nullptr);
+        this->_loadMipmapped (img.get(), false);
+        return;
+    }
+    vkUnmapMemory(app->_device, stagingBufMem);
+
+    this->_init (info.wid, info.ht, fmt, mipmap ? __detail::mipLevelCount(info.wid, info.ht) : 1);
+    this->_upload (
+        stagingBuf, stagingBufMem,
+        { __detail::levelRegion (0, 0, info.wid, info.ht) },
+        mipmap);
+}
+
+void Texture2D::_loadMipmapped (Image2D const *img, bool normalMap)
 {
-    if (mipmap) {
-        ERROR("mipmap generation not supported yet");
+    std::vector<Image2D *> mips = mipmapLevels (img, normalMap);
+    std::vector<__detail::ImageBase const *> levels;
+    levels.reserve (mips.size() + 1);
+    levels.push_back (img);
+    levels.insert (levels.end(), mips.begin(), mips.end());
+
+    this->_loadImages (img->width(), img->height(), levels);
+
+    for (auto mip : mips) {
+        delete mip;
     }
 }
 
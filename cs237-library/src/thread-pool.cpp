@@ -0,0 +1,142 @@
+/*! \file thread-pool.cpp
+ *
+ * Support code for CMSC 23700 Autumn 2022.
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#include "cs237.hpp"
+#include <atomic>
+
+namespace cs237 {
+
+ThreadPool::ThreadPool (unsigned int nThreads)
+  : _done(false)
+{
+    if (nThreads == 0) {
+        nThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    this->_workers.reserve(nThreads);
+    for (unsigned int i = 0;  i < nThreads;  ++i) {
+        this->_workers.emplace_back (&ThreadPool::_worker, this);
+    }
+}
+
+ThreadPool::~ThreadPool ()
+{
+    {
+        std::lock_guard<std::mutex> lk(this->_mu);
+        this->_done = true;
+    }
+    this->_cv.notify_all();
+    for (auto &w : this->_workers) {
+        w.join();
+    }
+}
+
+void ThreadPool::_enqueue (std::function<void()> &&task)
+{
+    {
+        std::lock_guard<std::mutex> lk(this->_mu);
+        this->_queue.push_back (std::move(task));
+    }
+    this->_cv.notify_one();
+}
+
+void ThreadPool::_worker ()
+{
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lk(this->_mu);
+            this->_cv.wait (lk, [this]() { return this->_done || !this->_queue.empty(); });
+            if (this->_queue.empty()) {
+                return; // _done is true and there is no more work
+            }
+            task = std::move(this->_queue.front());
+            this->_queue.pop_front();
+        }
+        task();
+    }
+}
+
+// the shared state of a parallelFor loop; this is reference counted, since
+// helper tasks may not get to run until after the loop has finished.
+struct ParallelForState {
+    std::function<void(size_t)> const *fn;
+    size_t n;
+    std::atomic<size_t> next;           // the next iteration to claim
+    std::atomic<size_t> nDone;          // the number of completed iterations
+    std::mutex mu;
+    std::condition_variable cv;
+    std::exception_ptr exn;             // the first exception raised (if any)
+
+    ParallelForState (size_t n, std::function<void(size_t)> const *fn)
+      : fn(fn), n(n), next(0), nDone(0)
+    { }
+
+    // claim and run iterations until there are none left
+    void run ()
+    {
+        size_t i;
+        while ((i = this->next.fetch_add(1)) < this->n) {
+            try {
+                (*this->fn)(i);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lk(this->mu);
+                if (! this->exn) {
+                    this->exn = std::current_exception();
+                }
+            }
+            if (this->nDone.fetch_add(1) + 1 == this->n) {
+                std::lock_guard<std::mutex> lk(this->mu);
+                this->cv.notify_all();
+            }
+        }
+    }
+};
+
+void ThreadPool::parallelFor (size_t n, std::function<void(size_t)> const &fn)
+{
+    if (n == 0) {
+        return;
+    }
+    else if (n == 1) {
+        fn(0);
+        return;
+    }
+
+    auto state = std::make_shared<ParallelForState>(n, &fn);
+
+    // enlist the workers; the calling thread is the remaining participant
+    size_t nHelpers = std::min(n, this->_workers.size() + 1) - 1;
+    for (size_t i = 0;  i < nHelpers;  ++i) {
+        this->_enqueue ([state]() { state->run(); });
+    }
+    state->run();
+
+    // wait for the iterations claimed by other threads to finish
+    {
+        std::unique_lock<std::mutex> lk(state->mu);
+        state->cv.wait (lk, [&state]() { return state->nDone.load() == state->n; });
+    }
+
+    if (state->exn) {
+        std::rethrow_exception (state->exn);
+    }
+
+}
+
+ThreadPool &ThreadPool::shared ()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+} // namespace cs237
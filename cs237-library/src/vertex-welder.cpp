@@ -0,0 +1,70 @@
+/*! \file vertex-welder.cpp
+ *
+ * Support code for CMSC 23700 Autumn 2022.
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#include "cs237.hpp"
+
+namespace cs237 {
+
+// the minimum number of slots in the hash table; the table is kept at most half full
+static const uint32_t kMinSlots = 16;
+
+VertexWelder::VertexWelder (uint32_t nKeys)
+{
+    this->_alloc (nKeys);
+}
+
+void VertexWelder::reset (uint32_t nKeys)
+{
+    this->_keys.clear();
+    this->_alloc (nKeys);
+}
+
+void VertexWelder::releaseTable ()
+{
+    std::vector<Slot>().swap (this->_slots);
+    this->_keys.shrink_to_fit ();
+    this->_mask = 0;
+    this->_limit = 0;
+}
+
+void VertexWelder::_alloc (uint32_t nKeys)
+{
+    uint32_t nSlots = kMinSlots;
+    while (nSlots < 2 * uint64_t(nKeys)) {
+        nSlots *= 2;
+    }
+    this->_slots.assign (nSlots, Slot{Key{0, 0, 0}, kEmpty});
+    this->_keys.reserve (nKeys);
+    this->_mask = nSlots - 1;
+    this->_limit = nSlots / 2;
+}
+
+void VertexWelder::_grow ()
+{
+    std::vector<Slot> old = std::move(this->_slots);
+    uint32_t nSlots = 2 * old.size();
+    this->_slots.assign (nSlots, Slot{Key{0, 0, 0}, kEmpty});
+    this->_mask = nSlots - 1;
+    this->_limit = nSlots / 2;
+  // reinsert the keys
+    for (auto &s : old) {
+        if (s.id != kEmpty) {
+            uint32_t i = static_cast<uint32_t>(_hash(s.key.a, s.key.b, s.key.c)) & this->_mask;
+            while (this->_slots[i].id != kEmpty) {
+                i = (i + 1) & this->_mask;
+            }
+            this->_slots[i] = s;
+        }
+    }
+}
+
+} // namespace cs237
@@ -484,7 +484,7 @@ void Lab3Window::_recordCommandBuffer (uint32_t imageIdx)
     vkCmdBindVertexBuffers(this->_cmdBuffer, 0, 1, vertBuffers, offsets);
 
     vkCmdBindIndexBuffer(
-        this->_cmdBuffer, this->_idxBuffer->vkBuffer(), 0, VK_INDEX_TYPE_UINT16);
+        this->_cmdBuffer, this->_idxBuffer->vkBuffer(), 0, this->_idxBuffer->indexType());
 
     vkCmdBindDescriptorSets(
         this->_cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -13,82 +13,76 @@
  * All rights reserved.
  */
 
-#include "json.hpp"
+#include "json-bind.hpp"
 #include "scene.hpp"
 #include <map>
 #include <functional>
 #include <iostream>
 
-/* helper functions to make extracting values from the JSON easier */
-
-//! load a vec3f from a JSON object.
-//! \return false if okay, true if there is an error.
-static bool loadVec3 (json::Object const *jv, glm::vec3 &vec)
-{
-    const json::Number *x = jv->fieldAsNumber("x");
-    const json::Number *y = jv->fieldAsNumber("y");
-    const json::Number *z = jv->fieldAsNumber("z");
-    if ((x == nullptr) || (y == nullptr) || (z == nullptr)) {
-        return true;
-    }
-
-    vec = glm::vec3 (
-        static_cast<float>(x->realVal()),
-        static_cast<float>(y->realVal()),
-        static_cast<float>(z->realVal()));
-
-    return false;
-}
-
-//! load a color3f from a JSON object.
-//! \return false if okay, true if there is an error.
-static bool loadColor (json::Object const *jv, glm::vec3 &color)
-{
-    const json::Number *r = jv->fieldAsNumber("r");
-    const json::Number *g = jv->fieldAsNumber("g");
-    const json::Number *b = jv->fieldAsNumber("b");
-    if ((r == nullptr) || (g == nullptr) || (b == nullptr)) {
-        return true;
-    }
-
-    color = glm::vec3 (
-        static_cast<float>(r->realVal()),
-        static_cast<float>(g->realVal()),
-        static_cast<float>(b->realVal()));
-
-    return false;
-}
-
-//! load a window size from a JSON object.
-//! \return false if okay, true if there is an error.
-static bool loadSize (json::Object const *jv, int &wid, int &ht)
-{
-    const json::Integer *w = jv->fieldAsInteger ("wid");
-    const json::Integer *h = jv->fieldAsInteger ("ht");
-
-    if ((w == nullptr) || (h == nullptr)) {
-        return true;
-    }
-    else {
-        wid = static_cast<int>(w->intVal());
-        ht = static_cast<int>(h->intVal());
-        return false;
-    }
-
-}
-
-//! load a float from a JSON object.
-//! \return false if okay, true if there is an error.
-static bool loadFloat (json::Number const *jv, float &f)
-{
-    if (jv == nullptr) {
-        return true;
-    }
-    else {
-        f = static_cast<float>(jv->realVal());
-        return false;
-    }
-}
+/* the structure of a scene description and its binding to JSON */
+
+namespace {
+
+//! the camera description
+struct CameraDesc {
+    int wid, ht;                //!< the window size
+    float fov;                  //!< the horizontal field of view
+    glm::vec3 pos, at, up;      //!< the camera frame
+};
+
+//! the lighting description
+struct LightingDesc {
+    glm::vec3 direction;        //!< the direction of the light
+    glm::vec3 intensity;        //!< the directional light's intensity
+    glm::vec3 ambient;          //!< the ambient-light intensity
+};
+
+//! the description of an object in the scene
+struct ObjectDesc {
+    std::string file;           //!< the OBJ file
+    glm::vec3 pos;              //!< the position of the object in world space
+    glm::vec3 xAxis, yAxis, zAxis; //!< the object's frame
+    glm::vec3 color;            //!< the object's color
+};
+
+struct SceneDesc {
+    CameraDesc camera;
+    LightingDesc lighting;
+    std::vector<ObjectDesc> objects;
+};
+
+constexpr auto kVec3 = json::components<glm::vec3>("x", "y", "z");
+constexpr auto kColor = json::components<glm::vec3>("r", "g", "b");
+
+constexpr auto kCamera = json::object<CameraDesc>(
+    json::field("size", json::object<CameraDesc>(
+        json::field("wid", &CameraDesc::wid),
+        json::field("ht", &CameraDesc::ht))),
+    json::field("fov", &CameraDesc::fov),
+    json::field("pos", &CameraDesc::pos, kVec3),
+    json::field("look-at", &CameraDesc::at, kVec3),
+    json::field("up", &CameraDesc::up, kVec3));
+
+constexpr auto kLighting = json::object<LightingDesc>(
+    json::field("direction", &LightingDesc::direction, kVec3),
+    json::field("intensity", &LightingDesc::intensity, kColor),
+    json::field("ambient", &LightingDesc::ambient, kColor));
+
+constexpr auto kObject = json::object<ObjectDesc>(
+    json::field("file", &ObjectDesc::file),
+    json::field("pos", &ObjectDesc::pos, kVec3),
+    json::field("frame", json::object<ObjectDesc>(
+        json::field("x-axis", &ObjectDesc::xAxis, kVec3),
+        json::field("y-axis", &ObjectDesc::yAxis, kVec3),
+        json::field("z-axis", &ObjectDesc::zAxis, kVec3))),
+    json::field("color", &ObjectDesc::color, kColor));
+
+constexpr auto kScene = json::object<SceneDesc>(
+    json::field("camera", &SceneDesc::camera, kCamera),
+    json::field("lighting", &SceneDesc::lighting, kLighting),
+    json::field("objects", &SceneDesc::objects, json::arrayOf(kObject)));
+
+} // anonymous namespace
 
 /***** class Scene member functions *****/
 
@@ -102,59 +96,41 @@ bool Scene::load (std::string const &path)
 
     std::string sceneDir = path + "/";
 
-  // load the scene description file
-    json::Value *root = json::parseFile(sceneDir + "scene.json");
-
-  // check for errors
-    if (root == nullptr) {
-        std::cerr << "Unable to load scene \"" << path << "\"" << std::endl;
-        return true;
-    } else if (! root->isObject()) {
-        std::cerr << "Invalid scene description in \"" << path
-            << "\"; root is not an object" << std::endl;
-        return true;
-    }
-    const json::Object *rootObj = root->asObject();
-
-  // load the camera info
-    const json::Object *cam = rootObj->fieldAsObject ("camera");
-    if ((cam == nullptr)
-    ||  loadSize (cam->fieldAsObject ("size"), this->_wid, this->_ht)
-    ||  loadFloat (cam->fieldAsNumber ("fov"), this->_fov)
-    ||  loadVec3 (cam->fieldAsObject ("pos"), this->_camPos)
-    ||  loadVec3 (cam->fieldAsObject ("look-at"), this->_camAt)
-    ||  loadVec3 (cam->fieldAsObject ("up"), this->_camUp)) {
-        std::cerr << "Invalid scene description in \"" << path
-            << "\"; bad camera" << std::endl;
+  // decode the scene description file
+    SceneDesc desc;
+    std::string err;
+    if (! json::decodeFile (sceneDir + "scene.json", kScene, desc, err)) {
+        std::cerr << "Invalid scene description in \"" << path << "\"; "
+            << err << std::endl;
         return true;
     }
 
-  // load the lighting information
-    const json::Object *light = rootObj->fieldAsObject ("lighting");
-    if ((light == nullptr)
-    ||  loadVec3 (light->fieldAsObject ("direction"), this->_lightDir)
-    ||  loadColor (light->fieldAsObject ("intensity"), this->_lightI)
-    ||  loadColor (light->fieldAsObject ("ambient"), this->_ambI)) {
-        std::cerr << "Invalid scene description in \"" << path
-            << "\"; bad lighting" << std::endl;
-        return true;
-    }
+  // the camera info
+    this->_wid = desc.camera.wid;
+    this->_ht = desc.camera.ht;
+    this->_fov = desc.camera.fov;
+    this->_camPos = desc.camera.pos;
+    this->_camAt = desc.camera.at;
+    this->_camUp = desc.camera.up;
+
   //! make sure that the light direction is a unit vector
-    this->_lightDir = glm::normalize(this->_lightDir);
+    this->_lightDir = glm::normalize(desc.lighting.direction);
   //! make sure that color values are in 0..1 range
-    this->_lightI = glm::clamp(this->_lightI, 0.0f, 1.0f);
-    this->_ambI = glm::clamp(this->_ambI, 0.0f, 1.0f);
+    this->_lightI = glm::clamp(desc.lighting.intensity, 0.0f, 1.0f);
+    this->_ambI = glm::clamp(desc.lighting.ambient, 0.0f, 1.0f);
 
-  // get the object array from the JSON tree and check that it is non-empty
-    json::Array const *objs = rootObj->fieldAsArray("objects");
-    if ((objs == nullptr) || (objs->length() == 0)) {
+  // check that the object array is non-empty
+    if (desc.objects.empty()) {
         std::cerr << "Invalid scene description in \"" << path
             << "\"; bad objects array" << std::endl;
         return true;
     }
 
   // allocate space for the objects in the scene
-    this->_objs.resize(objs->length());
+    this->_objs.resize(desc.objects.size());
+
+  // the texture images are decoded in parallel while we load the models
+    cs237::ImageLoader loader;
 
   // we use a map to keep track of which models have already been loaded
     std::map<std::string, int> objMap;
@@ -162,27 +138,11 @@ bool Scene::load (std::string const &path)
 
   // load the objects in the scene
     int numModels = 0;
-    for (int i = 0;  i < objs->length();  i++) {
-        json::Object const *object = (*objs)[i]->asObject();
-        if (object == nullptr) {
-            std::cerr << "Expected array of JSON objects for field 'objects' in \""
-                << path << "\"" << std::endl;
-            return true;
-        }
-        json::String const *file = object->fieldAsString("file");
-        json::Object const *frame = object->fieldAsObject("frame");
-        glm::vec3 pos, xAxis, yAxis, zAxis;
-        if ((file == nullptr) || (frame == nullptr)
-        ||  loadVec3 (object->fieldAsObject("pos"), pos)
-        ||  loadVec3 (frame->fieldAsObject("x-axis"), xAxis)
-        ||  loadVec3 (frame->fieldAsObject("y-axis"), yAxis)
-        ||  loadVec3 (frame->fieldAsObject("z-axis"), zAxis)
-        ||  loadColor (object->fieldAsObject("color"), this->_objs[i].color)) {
-            std::cerr << "Invalid objects description in \"" << path << "\"" << std::endl;
-            return true;
-        }
+    for (size_t i = 0;  i < desc.objects.size();  i++) {
+        ObjectDesc const &object = desc.objects[i];
+        this->_objs[i].color = object.color;
       // have we already loaded this model?
-        it = objMap.find(file->value());
+        it = objMap.find(object.file);
         int modelId;
         if (it != objMap.end()) {
             modelId = it->second;
@@ -190,36 +150,37 @@ bool Scene::load (std::string const &path)
         else {
           // load the model from the file sytem and add it to the map
             modelId = numModels++;
-            OBJ::Model *model = new OBJ::Model (sceneDir + file->value());
+            OBJ::Options opts;
+            opts.useCache = true;
+            opts.optimize = true;
+            OBJ::Model *model = new OBJ::Model (sceneDir + object.file, opts);
             this->_models.push_back(model);
-            objMap.insert (std::pair<std::string, int> (file->value(), modelId));
+            objMap.insert (std::pair<std::string, int> (object.file, modelId));
+          // queue the texture images used by the model's materials
+            for (auto grpIt = model->beginGroups();  grpIt != model->endGroups();  grpIt++) {
+                const OBJ::Material *mat = &model->Material((*grpIt).material);
+                this->_loadTexture (loader, sceneDir, mat->diffuseMap);
+                this->_loadTexture (loader, sceneDir, mat->normalMap);  // not used in this project
+            }
         }
         this->_objs[i].model = modelId;
       // set the object-space to world-space transform
         this->_objs[i].toWorld = glm::mat4 (
-            glm::vec4 (xAxis, 0.0f),
-            glm::vec4 (yAxis, 0.0f),
-            glm::vec4 (zAxis, 0.0f),
-            glm::vec4 (pos, 1.0f));
+            glm::vec4 (object.xAxis, 0.0f),
+            glm::vec4 (object.yAxis, 0.0f),
+            glm::vec4 (object.zAxis, 0.0f),
+            glm::vec4 (object.pos, 1.0f));
     }
 
-  // load the texture images used by the materials in the models
-    for (auto modIt = this->_models.begin();  modIt != this->_models.end();  modIt++) {
-        const OBJ::Model *model = *modIt;
-        for (auto grpIt = model->beginGroups();  grpIt != model->endGroups();  grpIt++) {
-            const OBJ::Material *mat = &model->Material((*grpIt).material);
-            this->_loadTexture (sceneDir, mat->diffuseMap);
-            this->_loadTexture (sceneDir, mat->normalMap);  // not used in this project
-        }
+  // wait for the texture images
+    for (auto &tex : this->_texs) {
+        tex.second = loader.get (sceneDir + tex.first);
     }
 
-  // free up the space used by the JSON object
-    delete root;
-
     return false;
 }
 
-void Scene::_loadTexture (std::string path, std::string name)
+void Scene::_loadTexture (cs237::ImageLoader &loader, std::string path, std::string name)
 {
     if (name.empty()) {
         return;
@@ -228,10 +189,10 @@ void Scene::_loadTexture (std::string path, std::string name)
     if (this->_texs.find(name) != this->_texs.end()) {
         return;
     }
-  // load the image data;
-    cs237::Image2D *img = new cs237::Image2D(path + name);
-  // add to _texs map
-    this->_texs.insert (std::pair<std::string, cs237::Image2D *>(name, img));
+  // start loading the image data
+    loader.load (path + name);
+  // add to _texs map; the image is filled in by Scene::load
+    this->_texs.insert (std::pair<std::string, cs237::Image2D *>(name, nullptr));
 
 }
 
@@ -121,8 +121,10 @@ class Scene {
     std::vector<SceneObj> _objs;                        //!< the objects in the scene
     std::map<std::string, cs237::Image2D *> _texs;      //!< the textures keyed by name
 
-  //! helper function for loading textures into the _texs map
-    void _loadTexture (std::string path, std::string name);
+  //! helper function for loading textures into the _texs map; the texture is
+  //! added to the map with a nullptr image, which is filled in once the loader
+  //! has finished decoding it.
+    void _loadTexture (cs237::ImageLoader &loader, std::string path, std::string name);
 
 };
 
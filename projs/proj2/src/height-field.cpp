@@ -23,7 +23,18 @@ HeightField::HeightField (
 	cs237::Image2D *cmap,
 	cs237::Image2D *nmap
 )
-    : _img(new cs237::Image2D(file, false)),
+    : HeightField (new cs237::Image2D(file, false), width, height, vScale, color, cmap, nmap)
+{ }
+
+// construct a HeightField object from a loaded image
+HeightField::HeightField (
+	cs237::Image2D *img,
+	float width, float height, float vScale,
+	glm::vec3 const &color,
+	cs237::Image2D *cmap,
+	cs237::Image2D *nmap
+)
+    : _img(img),
 	_halfWid(0.5*width), _halfHt(0.5*height),
 	_minHt(0), _maxHt(0),
 	_scaleX(width / float(this->numCols() - 1)),
@@ -37,6 +37,23 @@ class HeightField {
 	cs237::Image2D *nmap
 	);
 
+    //! construct a HeightField object from an image that has already been loaded
+    //! \param img the height-field image (loaded without flipping); the height
+    //!        field takes ownership of the image
+    //! \param width the width (X dimension) covered by the ground in world-space coordinates
+    //! \param height the height (Z dimension) covered by the ground in world-space coordinates
+    //! \param vScale the vertical scaling (Y dimension) factor
+    //! \param color the color for non-texturing modes
+    //! \param cmap the color texture image
+    //! \param nmap the normal-map texture image
+    HeightField (
+	cs237::Image2D *img,
+	float width, float height, float vScale,
+	glm::vec3 const &color,
+	cs237::Image2D *cmap,
+	cs237::Image2D *nmap
+	);
+
     //! the width of the ground object in world-space
     float width () const { return 2.0f * this->_halfWid; }
 
@@ -27,6 +27,12 @@ struct Mesh {
     VkPrimitiveTopology prim;   //!< the primitive type for rendering the mesh
                                 //!  (e.g., VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
     int nIndices;               //!< the number of vertex indices
+    bool packed;                //!< true if the vertex buffer holds `PackedVertex`
+                                //!  values instead of `Vertex` values
+    glm::vec3 posScale;         //!< for packed vertices, the scaling that maps the
+                                //!  quantized positions to object space
+    glm::vec3 posBias;          //!< for packed vertices, the bias that maps the
+                                //!  quantized positions to object space
     cs237::Texture2D *cMap;     //!< the color-map texture for the object
     cs237::Texture2D *nMap;     //!< the normal-map texture for the object
 
@@ -35,7 +41,10 @@ struct Mesh {
     //! \param p    the topology of the vertices; for Project 2, it should
     //!             be VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST
     //! \param grp  a `Group` from an object that this mesh defines
-    Mesh (cs237::Application *app, VkPrimitiveTopology p, OBJ::Group const &grp);
+    //! \param pack if true, then the vertex buffer holds `PackedVertex` values
+    Mesh (
+        cs237::Application *app, VkPrimitiveTopology p, OBJ::Group const &grp,
+        bool pack = false);
 
     //! create a Mesh object for a height-field
     Mesh (cs237::Application *app, HeightField *hf);
@@ -13,104 +13,102 @@
  * All rights reserved.
  */
 
-#include "json.hpp"
+#include "json-bind.hpp"
 #include "scene.hpp"
 #include <map>
 #include <functional>
 #include <iostream>
 
-/* helper functions to make extracting values from the json easier */
-
-//! load a vec3f from a json object.
-//! \return false if okay, true if there is an error.
-static bool loadVec3 (json::Object const *jv, glm::vec3 &vec)
-{
-    const json::Number *x = jv->fieldAsNumber("x");
-    const json::Number *y = jv->fieldAsNumber("y");
-    const json::Number *z = jv->fieldAsNumber("z");
-    if ((x == nullptr) || (y == nullptr) || (z == nullptr)) {
-        return true;
-    }
-
-    vec = glm::vec3 (
-        static_cast<float>(x->realVal()),
-        static_cast<float>(y->realVal()),
-        static_cast<float>(z->realVal()));
-
-    return false;
-}
-
-//! load a color3f from a json object.
-//! \return false if okay, true if there is an error.
-static bool loadColor (json::Object const *jv, glm::vec3 &color)
-{
-    const json::Number *r = jv->fieldAsNumber("r");
-    const json::Number *g = jv->fieldAsNumber("g");
-    const json::Number *b = jv->fieldAsNumber("b");
-    if ((r == nullptr) || (g == nullptr) || (b == nullptr)) {
-        return true;
-    }
-
-    color = glm::vec3 (
-        static_cast<float>(r->realVal()),
-        static_cast<float>(g->realVal()),
-        static_cast<float>(b->realVal()));
-
-    return false;
-}
-
-//! load a window size from a json object.
-//! \return false if okay, true if there is an error.
-static bool loadSize (json::Object const *jv, int &wid, int &ht)
-{
-    const json::Integer *w = jv->fieldAsInteger ("wid");
-    const json::Integer *h = jv->fieldAsInteger ("ht");
-
-    if ((w == nullptr) || (h == nullptr)) {
-        return true;
-    }
-    else {
-        wid = static_cast<int>(w->intVal());
-        ht = static_cast<int>(h->intVal());
-        return false;
-    }
-
-}
-
-//! load a ground size from a json object.
-//! \return false if okay, true if there is an error.
-bool loadSize (json::Object const *jv, float &wid, float &ht)
-{
-    if (jv == nullptr) {
-        return true;
-    }
-
-    const json::Number *w = jv->fieldAsNumber ("wid");
-    const json::Number *h = jv->fieldAsNumber ("ht");
-
-    if ((w == nullptr) || (h == nullptr)) {
-        return true;
-    }
-    else {
-        wid = static_cast<float>(w->realVal());
-        ht = static_cast<float>(h->realVal());
-        return false;
-    }
-
-}
-
-//! load a float from a json object.
-//! \return false if okay, true if there is an error.
-static bool loadFloat (json::Value const *jv, float &f)
-{
-    if ((jv == nullptr) || (! jv->isNumber())) {
-        return true;
-    }
-    else {
-        f = static_cast<float>(jv->asNumber()->realVal());
-        return false;
-    }
-}
+/* the structure of a scene description and its binding to JSON */
+
+namespace {
+
+//! the camera description
+struct CameraDesc {
+    int wid, ht;                //!< the window size
+    float fov;                  //!< the horizontal field of view
+    glm::vec3 pos, at, up;      //!< the camera frame
+};
+
+//! the lighting description
+struct LightingDesc {
+    glm::vec3 ambient;                  //!< the ambient-light intensity
+    std::vector<PointLight> lights;     //!< the point lights
+};
+
+//! the description of an object in the scene
+struct ObjectDesc {
+    std::string file;           //!< the OBJ file
+    glm::vec3 pos;              //!< the position of the object in world space
+    glm::vec3 xAxis, yAxis, zAxis; //!< the object's frame
+    glm::vec3 color;            //!< the object's color
+};
+
+//! the description of the ground
+struct GroundDesc {
+    float wid, ht;              //!< the size of the ground in world space
+    float vScale;               //!< the vertical scale of the height field
+    std::string hf;             //!< the height-field image file
+    std::string cmap;           //!< the color-map image file
+    std::string nmap;           //!< the normal-map image file
+    glm::vec3 color;            //!< the ground's color
+};
+
+struct SceneDesc {
+    CameraDesc camera;
+    LightingDesc lighting;
+    std::vector<ObjectDesc> objects;
+    std::optional<GroundDesc> ground;
+};
+
+constexpr auto kVec3 = json::components<glm::vec3>("x", "y", "z");
+constexpr auto kColor = json::components<glm::vec3>("r", "g", "b");
+
+constexpr auto kCamera = json::object<CameraDesc>(
+    json::field("size", json::object<CameraDesc>(
+        json::field("wid", &CameraDesc::wid),
+        json::field("ht", &CameraDesc::ht))),
+    json::field("fov", &CameraDesc::fov),
+    json::field("pos", &CameraDesc::pos, kVec3),
+    json::field("look-at", &CameraDesc::at, kVec3),
+    json::field("up", &CameraDesc::up, kVec3));
+
+constexpr auto kLight = json::object<PointLight>(
+    json::field("pos", &PointLight::pos, kVec3),
+    json::field("intensity", &PointLight::intensity, kColor),
+    json::field("attenuation",
+        json::elements(&PointLight::k0, &PointLight::k1, &PointLight::k2)));
+
+constexpr auto kLighting = json::object<LightingDesc>(
+    json::field("ambient", &LightingDesc::ambient, kColor),
+    json::field("lights", &LightingDesc::lights, json::arrayOf(kLight)));
+
+constexpr auto kObject = json::object<ObjectDesc>(
+    json::field("file", &ObjectDesc::file),
+    json::field("pos", &ObjectDesc::pos, kVec3),
+    json::field("frame", json::object<ObjectDesc>(
+        json::field("x-axis", &ObjectDesc::xAxis, kVec3),
+        json::field("y-axis", &ObjectDesc::yAxis, kVec3),
+        json::field("z-axis", &ObjectDesc::zAxis, kVec3))),
+    json::field("color", &ObjectDesc::color, kColor));
+
+constexpr auto kGround = json::object<GroundDesc>(
+    json::field("size", json::object<GroundDesc>(
+        json::field("wid", &GroundDesc::wid),
+        json::field("ht", &GroundDesc::ht))),
+    json::field("v-scale", &GroundDesc::vScale),
+    json::field("height-field", &GroundDesc::hf),
+    json::field("color-map", &GroundDesc::cmap),
+    json::field("normal-map", &GroundDesc::nmap),
+    json::field("color", &GroundDesc::color, kColor));
+
+constexpr auto kScene = json::object<SceneDesc>(
+    json::field("camera", &SceneDesc::camera, kCamera),
+    json::field("lighting", &SceneDesc::lighting, kLighting),
+    json::field("objects", &SceneDesc::objects, json::arrayOf(kObject)),
+    json::field("ground", &SceneDesc::ground, kGround));
+
+} // anonymous namespace
 
 /***** class Scene member functions *****/
 
@@ -124,85 +122,54 @@ bool Scene::load (std::string const &path)
 
     std::string sceneDir = path + "/";
 
-    // load the scene description file
-    json::Value *root = json::parseFile(sceneDir + "scene.json");
-
-    // check for errors
-    if (root == nullptr) {
-        std::cerr << "Unable to load scene \"" << path << "\"\n";
-        return true;
-    } else if (! root->isObject()) {
-        std::cerr << "Invalid scene description in \"" << path
-            << "\"; root is not an object" << std::endl;
-        return true;
-    }
-    const json::Object *rootObj = root->asObject();
-
-    // load the camera info
-    const json::Object *cam = rootObj->fieldAsObject ("camera");
-    if ((cam == nullptr)
-    ||  loadSize (cam->fieldAsObject ("size"), this->_wid, this->_ht)
-    ||  loadFloat (cam->fieldAsNumber ("fov"), this->_fov)
-    ||  loadVec3 (cam->fieldAsObject ("pos"), this->_camPos)
-    ||  loadVec3 (cam->fieldAsObject ("look-at"), this->_camAt)
-    ||  loadVec3 (cam->fieldAsObject ("up"), this->_camUp)) {
-        std::cerr << "Invalid scene description in \"" << path
-            << "\"; bad camera" << std::endl;
+    // decode the scene description file
+    SceneDesc desc;
+    std::string err;
+    if (! json::decodeFile (sceneDir + "scene.json", kScene, desc, err)) {
+        std::cerr << "Invalid scene description in \"" << path << "\"; "
+            << err << std::endl;
         return true;
     }
 
-    // load the lighting information
-    const json::Object *lighting = rootObj->fieldAsObject ("lighting");
-    if ((lighting == nullptr)
-    ||  loadColor (lighting->fieldAsObject ("ambient"), this->_ambI)) {
-        std::cerr << "Invalid scene description in \"" << path
-            << "\"; bad lighting\n";
-        return true;
-    }
+    // the camera info
+    this->_wid = desc.camera.wid;
+    this->_ht = desc.camera.ht;
+    this->_fov = desc.camera.fov;
+    this->_camPos = desc.camera.pos;
+    this->_camAt = desc.camera.at;
+    this->_camUp = desc.camera.up;
+
     // make sure that the ambient-light intensity is in 0..1 range
-    this->_ambI = glm::clamp(this->_ambI, 0.0f, 1.0f);
-    // get the array of point lights; we allow at most 4 lights
-    json::Array const *lights = lighting->fieldAsArray("lights");
-    if ((lights == nullptr) || (lights->length() == 0) || (lights->length() > 4)) {
+    this->_ambI = glm::clamp(desc.lighting.ambient, 0.0f, 1.0f);
+    // we allow at most 4 lights
+    if ((desc.lighting.lights.size() == 0) || (desc.lighting.lights.size() > 4)) {
         std::cerr << "Invalid scene description in \"" << path
             << "\"; bad lights array\n";
         return true;
     }
-    // allocate space for the lights in the scene
-    this->_lights.resize(lights->length());
-    for (int i = 0;  i < lights->length();  i++) {
-        json::Object const *light = (*lights)[i]->asObject();
-        if (loadVec3 (light->fieldAsObject ("pos"), this->_lights[i].pos)
-        ||  loadColor (light->fieldAsObject ("intensity"), this->_lights[i].intensity)) {
-            std::cerr << "Invalid scene description in \"" << path
-                << "\"; bad lighting\n";
-            return true;
-        }
-        // get attenuation coefficients
-        json::Array const *aten = light->fieldAsArray("attenuation");
-        if ((aten == nullptr)
-        ||  (aten->length() != 3)
-        ||  loadFloat((*aten)[0], this->_lights[i].k0)
-        ||  loadFloat((*aten)[1], this->_lights[i].k1)
-        ||  loadFloat((*aten)[2], this->_lights[i].k2)) {
-            std::cerr << "Invalid scene description in \"" << path
-                << "\"; bad attenuation array\n";
-            return true;
-        }
+    this->_lights = std::move(desc.lighting.lights);
+    for (auto &light : this->_lights) {
         // make sure that the light intensity is in 0..1 range
-        this->_lights[i].intensity = glm::clamp(this->_lights[i].intensity, 0.0f, 1.0f);
+        light.intensity = glm::clamp(light.intensity, 0.0f, 1.0f);
     }
 
-    // get the object array from the json tree and check that it is non-empty
-    json::Array const *objs = rootObj->fieldAsArray("objects");
-    if ((objs == nullptr) || (objs->length() == 0)) {
-        std::cerr << "Invalid scene description in \"" << path
-            << "\"; bad objects array\n";
+    // a scene must have either objects or ground
+    if (desc.objects.empty() && !desc.ground) {
+        std::cerr << "Invalid empty scene description in \"" << path << "\"\n";
         return true;
     }
 
     // allocate space for the objects in the scene
-    this->_objs.resize(objs->length());
+    this->_objs.resize(desc.objects.size());
+
+    // the texture images are decoded in parallel while we load the models; we
+    // start with the ground images, since we know their names up front
+    cs237::ImageLoader loader;
+    if (desc.ground) {
+        this->_loadTexture (loader, sceneDir, desc.ground->cmap);
+        this->_loadTexture (loader, sceneDir, desc.ground->nmap, true);
+        loader.load (sceneDir + desc.ground->hf, false, false);
+    }
 
     // we use a map to keep track of which models have already been loaded
     std::map<std::string, int> objMap;
@@ -210,27 +177,11 @@ bool Scene::load (std::string const &path)
 
     // load the objects in the scene
     int numModels = 0;
-    for (int i = 0;  i < objs->length();  i++) {
-        json::Object const *object = (*objs)[i]->asObject();
-        if (object == nullptr) {
-            std::cerr << "Expected array of json objects for field 'objects' in \""
-                << path << "\"\n";
-            return true;
-        }
-        json::String const *file = object->fieldAsString("file");
-        json::Object const *frame = object->fieldAsObject("frame");
-        glm::vec3 pos, xAxis, yAxis, zAxis;
-        if ((file == nullptr) || (frame == nullptr)
-        ||  loadVec3 (object->fieldAsObject("pos"), pos)
-        ||  loadVec3 (frame->fieldAsObject("x-axis"), xAxis)
-        ||  loadVec3 (frame->fieldAsObject("y-axis"), yAxis)
-        ||  loadVec3 (frame->fieldAsObject("z-axis"), zAxis)
-        ||  loadColor (object->fieldAsObject("color"), this->_objs[i].color)) {
-            std::cerr << "Invalid objects description in \"" << path << "\"\n";
-            return true;
-        }
+    for (size_t i = 0;  i < desc.objects.size();  i++) {
+        ObjectDesc const &object = desc.objects[i];
+        this->_objs[i].color = object.color;
         // have we already loaded this model?
-        it = objMap.find(file->value());
+        it = objMap.find(object.file);
         int modelId;
         if (it != objMap.end()) {
             modelId = it->second;
@@ -238,68 +189,54 @@ bool Scene::load (std::string const &path)
         else {
             // load the model from the file sytem and add it to the map
             modelId = numModels++;
-            OBJ::Model *model = new OBJ::Model (sceneDir + file->value());
+            OBJ::Options opts;
+            opts.useCache = true;
+            opts.optimize = true;
+            OBJ::Model *model = new OBJ::Model (sceneDir + object.file, opts);
             this->_models.push_back(model);
-            objMap.insert (std::pair<std::string, int> (file->value(), modelId));
+            objMap.insert (std::pair<std::string, int> (object.file, modelId));
+            // queue the texture images used by the model's materials
+            for (auto grpIt = model->beginGroups();  grpIt != model->endGroups();  grpIt++) {
+                const OBJ::Material *mat = &model->Material((*grpIt).material);
+                this->_loadTexture (loader, sceneDir, mat->diffuseMap);
+                this->_loadTexture (loader, sceneDir, mat->normalMap, true);
+            }
         }
         this->_objs[i].model = modelId;
         // set the object-space to world-space transform
         this->_objs[i].toWorld = glm::mat4 (
-            glm::vec4 (xAxis, 0.0f),
-            glm::vec4 (yAxis, 0.0f),
-            glm::vec4 (zAxis, 0.0f),
-            glm::vec4 (pos, 1.0f));
+            glm::vec4 (object.xAxis, 0.0f),
+            glm::vec4 (object.yAxis, 0.0f),
+            glm::vec4 (object.zAxis, 0.0f),
+            glm::vec4 (object.pos, 1.0f));
     }
 
-    // load the texture images used by the materials in the models
-    for (auto modIt = this->_models.begin();  modIt != this->_models.end();  modIt++) {
-        const OBJ::Model *model = *modIt;
-        for (auto grpIt = model->beginGroups();  grpIt != model->endGroups();  grpIt++) {
-            const OBJ::Material *mat = &model->Material((*grpIt).material);
-            this->_loadTexture (sceneDir, mat->diffuseMap);
-            this->_loadTexture (sceneDir, mat->normalMap, true);
-        }
+    // wait for the texture images
+    for (auto &tex : this->_texs) {
+        tex.second = loader.get (sceneDir + tex.first);
     }
 
-    // load the ground information (if present)
-    const json::Object *ground = rootObj->fieldAsObject ("ground");
-    if (ground != nullptr) {
-        float wid, ht;
-        float vScale;
-        glm::vec3 color;
-        json::String const *hf = ground->fieldAsString("height-field");
-        json::String const *cmap = ground->fieldAsString("color-map");
-        json::String const *nmap = ground->fieldAsString("normal-map");
-        if ((hf == nullptr) || (cmap == nullptr) || (nmap == nullptr)
-        ||  loadSize (ground->fieldAsObject("size"), wid, ht)
-        ||  loadFloat (ground->fieldAsNumber ("v-scale"), vScale)
-        ||  loadColor (ground->fieldAsObject("color"), color)) {
-            std::cerr << "Invalid ground description in \"" << path << "\"\n";
-            return true;
-        }
-        // load the color-map and normal-map textures
-        this->_loadTexture (sceneDir, cmap->value());
-        cs237::Image2D *cmapImg = this->textureByName (cmap->value());
-        this->_loadTexture (sceneDir, nmap->value(), true);
-        cs237::Image2D *nmapImg = this->textureByName (nmap->value());
-        this->_hf = new HeightField (sceneDir + hf->value(), wid, ht, vScale, color, cmapImg, nmapImg);
+    // create the ground (if present)
+    if (desc.ground) {
+        GroundDesc const &ground = *desc.ground;
+        this->_hf = new HeightField (
+            loader.get (sceneDir + ground.hf),
+            ground.wid, ground.ht, ground.vScale, ground.color,
+            this->textureByName (ground.cmap),
+            this->textureByName (ground.nmap));
     }
     else {
         this->_hf = nullptr;
     }
 
-    if ((ground == nullptr) && (objs->length() == 0)) {
-        std::cerr << "Invalid empty scene description in \"" << path << "\"\n";
-        return true;
-    }
-
-    // free up the space used by the json object
-    delete root;
-
     return false;
 }
 
-void Scene::_loadTexture (std::string path, std::string name, bool nMap)
+void Scene::_loadTexture (
+    cs237::ImageLoader &loader,
+    std::string path,
+    std::string name,
+    bool nMap)
 {
     if (name.empty()) {
         return;
@@ -308,16 +245,10 @@ void Scene::_loadTexture (std::string path, std::string name, bool nMap)
     if (this->_texs.find(name) != this->_texs.end()) {
         return;
     }
-    // load the image data;
-    cs237::Image2D *img;
-    if (nMap) {
-        // normal data should not be sRGB encoded!
-        img = new cs237::DataImage2D(path + name);
-    } else {
-        img = new cs237::Image2D(path + name);
-    }
-    // add to _texs map
-    this->_texs.insert (std::pair<std::string, cs237::Image2D *>(name, img));
+    // start loading the image data; normal data should not be sRGB encoded!
+    loader.load (path + name, nMap);
+    // add to _texs map; the image is filled in by Scene::load
+    this->_texs.insert (std::pair<std::string, cs237::Image2D *>(name, nullptr));
 
 }
 
@@ -137,11 +137,18 @@ class Scene {
     HeightField *_hf;           //!< the height field that represents the ground; nullptr if
                                 //!  the scene does not have a ground Object
 
-    //! helper function for loading textures into the _texs map
+    //! helper function for loading textures into the _texs map; the texture is
+    //! added to the map with a nullptr image, which is filled in once the loader
+    //! has finished decoding it.
+    //! \param loader the image loader that decodes the texture
     //! \param path  the path to the directory containing the image file
     //! \param name  the name of the file
     //! \param nMap  optional argument specifying if the texture is a normal map (default false).
-    void _loadTexture (std::string path, std::string name, bool nMap = false);
+    void _loadTexture (
+        cs237::ImageLoader &loader,
+        std::string path,
+        std::string name,
+        bool nMap = false);
 
 };
 
@@ -77,4 +77,135 @@ struct Vertex {
     }
 };
 
+//! Compact mesh vertices (20 bytes vs. 48 bytes for `Vertex`).  Positions are
+//! quantized to 16-bit UNORM values relative to the mesh's bounding box, so the
+//! vertex shader must map them back to object space using the `posScale` and
+//! `posBias` values of the mesh (i.e., `pos = posBias + posScale * inPos.xyz`).
+//! Normals and tangents are octahedral encoded as pairs of 16-bit SNORM values,
+//! and the texture coordinates are half floats.  The sign of the bitangent
+//! (i.e., the w component of the tangent in `Vertex`) is stored in the fourth
+//! position component as 0 (-1) or 1 (+1).
+//
+struct PackedVertex {
+    uint16_t pos[4];    //! quantized position plus bitangent sign
+    int16_t norm[2];    //! octahedral-encoded normal
+    int16_t tan[2];     //! octahedral-encoded tangent vector
+    uint16_t txtCoord[2]; //! half-float texture coordinates
+
+    //! encode a vertex
+    //! \param v     the vertex to encode
+    //! \param scale the scaling factor used to dequantize the position
+    //! \param bias  the bias used to dequantize the position
+    PackedVertex (Vertex const &v, glm::vec3 const &scale, glm::vec3 const &bias)
+    {
+        for (int i = 0;  i < 3;  ++i) {
+            float p = (scale[i] > 0.0f) ? (v.pos[i] - bias[i]) / scale[i] : 0.0f;
+            this->pos[i] = static_cast<uint16_t>(
+                std::round(65535.0f * glm::clamp(p, 0.0f, 1.0f)));
+        }
+        this->pos[3] = (v.tan.w < 0.0f) ? 0 : 65535;
+        glm::vec2 n = octEncode(v.norm);
+        glm::vec2 t = octEncode(glm::vec3(v.tan));
+        for (int i = 0;  i < 2;  ++i) {
+            this->norm[i] = static_cast<int16_t>(std::round(32767.0f * n[i]));
+            this->tan[i] = static_cast<int16_t>(std::round(32767.0f * t[i]));
+        }
+        uint32_t tc = glm::packHalf2x16(v.txtCoord);
+        this->txtCoord[0] = static_cast<uint16_t>(tc & 0xffff);
+        this->txtCoord[1] = static_cast<uint16_t>(tc >> 16);
+    }
+
+    //! decode the vertex on the CPU; this function computes the same values as
+    //! the vertex-input stage plus the decoding in the vertex shader, so it can
+    //! be used to check the encoding without a pipeline
+    //! \param scale the scaling factor used to dequantize the position
+    //! \param bias  the bias used to dequantize the position
+    Vertex decode (glm::vec3 const &scale, glm::vec3 const &bias) const
+    {
+        // UNORM and SNORM conversions as specified by Vulkan
+        auto unorm = [](uint16_t x) { return float(x) / 65535.0f; };
+        auto snorm = [](int16_t x) { return std::max(float(x) / 32767.0f, -1.0f); };
+
+        Vertex v;
+        v.pos = bias + scale * glm::vec3(unorm(this->pos[0]), unorm(this->pos[1]), unorm(this->pos[2]));
+        v.norm = octDecode (glm::vec2(snorm(this->norm[0]), snorm(this->norm[1])));
+        v.tan = glm::vec4(
+            octDecode (glm::vec2(snorm(this->tan[0]), snorm(this->tan[1]))),
+            (unorm(this->pos[3]) < 0.5f) ? -1.0f : 1.0f);
+        v.txtCoord = glm::unpackHalf2x16(
+            uint32_t(this->txtCoord[0]) | (uint32_t(this->txtCoord[1]) << 16));
+        return v;
+    }
+
+    //! map a unit vector to a point in [-1,1]^2 using the octahedral encoding;
+    //! the zero vector maps to the origin
+    static glm::vec2 octEncode (glm::vec3 v)
+    {
+        float l1 = std::fabs(v.x) + std::fabs(v.y) + std::fabs(v.z);
+        if (l1 == 0.0f) {
+            return glm::vec2(0.0f);
+        }
+        v /= l1;
+        glm::vec2 p(v.x, v.y);
+        if (v.z < 0.0f) {
+            p = glm::vec2(
+                (1.0f - std::fabs(v.y)) * (v.x >= 0.0f ? 1.0f : -1.0f),
+                (1.0f - std::fabs(v.x)) * (v.y >= 0.0f ? 1.0f : -1.0f));
+        }
+        return p;
+    }
+
+    //! map a point in [-1,1]^2 back to a unit vector (the inverse of `octEncode`)
+    static glm::vec3 octDecode (glm::vec2 p)
+    {
+        glm::vec3 v(p.x, p.y, 1.0f - std::fabs(p.x) - std::fabs(p.y));
+        if (v.z < 0.0f) {
+            v.x = (1.0f - std::fabs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f);
+            v.y = (1.0f - std::fabs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f);
+        }
+        return glm::normalize(v);
+    }
+
+    static std::vector<VkVertexInputBindingDescription> getBindingDescriptions()
+    {
+        std::vector<VkVertexInputBindingDescription> bindings(1);
+        bindings[0].binding = 0;
+        bindings[0].stride = sizeof(PackedVertex);
+        bindings[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        return bindings;
+    }
+
+    static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions()
+    {
+        std::vector<VkVertexInputAttributeDescription> attrs(kNumVertexAttrs);
+
+        // pos (plus bitangent sign)
+        attrs[kCoordAttrLoc].binding = 0;
+        attrs[kCoordAttrLoc].location = kCoordAttrLoc;
+        attrs[kCoordAttrLoc].format = VK_FORMAT_R16G16B16A16_UNORM;
+        attrs[kCoordAttrLoc].offset = offsetof(PackedVertex, pos);
+
+        // norm
+        attrs[kNormAttrLoc].binding = 0;
+        attrs[kNormAttrLoc].location = kNormAttrLoc;
+        attrs[kNormAttrLoc].format = VK_FORMAT_R16G16_SNORM;
+        attrs[kNormAttrLoc].offset = offsetof(PackedVertex, norm);
+
+        // tan
+        attrs[kTanAttrLoc].binding = 0;
+        attrs[kTanAttrLoc].location = kTanAttrLoc;
+        attrs[kTanAttrLoc].format = VK_FORMAT_R16G16_SNORM;
+        attrs[kTanAttrLoc].offset = offsetof(PackedVertex, tan);
+
+        // txtCoord
+        attrs[kTexCoordAttrLoc].binding = 0;
+        attrs[kTexCoordAttrLoc].location = kTexCoordAttrLoc;
+        attrs[kTexCoordAttrLoc].format = VK_FORMAT_R16G16_SFLOAT;
+        attrs[kTexCoordAttrLoc].offset = offsetof(PackedVertex, txtCoord);
+
+        return attrs;
+    }
+};
+
 #endif // !_VERTEX_HPP_
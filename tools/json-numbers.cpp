@@ -0,0 +1,252 @@
+/*! \file json-numbers.cpp
+ *
+ * Timing and correctness driver for the number conversion of the JSON
+ * parser.  The driver writes documents of 3D positions whose coordinates
+ * are printed in different styles, parses them (into a Document and with the
+ * event-driven reader), and checks every parsed number against `strtod` (or
+ * `strtoll`) of its text.
+ *
+ * Usage:
+ *
+ *      json-numbers [ -r <runs> ] [ -n <positions> ]
+ *
+ * The default is 1M positions (300k for the wide-exponent document).
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#include "json.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+//! the styles in which the coordinates of the positions are printed
+enum Style {
+    kMixed,             //!< a mix of %.17g, %.6e (with large and small exponents), and %.6f
+    kFixed,             //!< all %.6f
+    kWideExp            //!< %.17g with exponents in [-300, 300]
+};
+
+//! a number of the document; we record its text and the value that the parser
+//! should produce
+struct Number {
+    std::string text;
+    bool isInt;         //!< true if the parser should produce an Integer
+    int64_t i;
+    double r;
+};
+
+//! integers that are at or beyond the range of int64_t; the ones that do
+//! not fit must be parsed as reals
+static const char *kInts[] = {
+    "0", "-0", "17", "-17", "123456789012345678",
+    "9223372036854775807", "-9223372036854775808",
+    "9223372036854775808", "-9223372036854775809",
+    "123456789012345678901234"
+};
+
+//! reals at and beyond the range of double: overflow must produce +/-inf and
+//! underflow a subnormal or +/-0 (the same as `strtod`)
+static const char *kReals[] = {
+    "1e400", "-1e400", "1e-400", "-1e-400", "12345678901234567890123e300",
+    "0.1e-330", "4.9e-324", "2.2250738585072011e-308", "1.7976931348623157e308",
+    "1.7976931348623159e308"
+};
+
+//! the value that the parser should produce for the text of a number: numbers
+//! without a fraction or exponent are integers, unless they do not fit in int64_t
+static Number expect (const char *text)
+{
+    if (std::strpbrk(text, ".eE") == nullptr) {
+        errno = 0;
+        int64_t v = std::strtoll(text, nullptr, 10);
+        if (errno != ERANGE) {
+            return Number{text, true, v, 0.0};
+        }
+    }
+    return Number{text, false, 0, std::strtod(text, nullptr)};
+}
+
+//! write a document of n positions in the given style to the file and return
+//! its numbers in file order
+static std::vector<Number> writeDocument (std::string const &file, Style style, int n)
+{
+    std::mt19937_64 rng(7);
+    std::uniform_real_distribution<double> coord(-1000.0, 1000.0);
+    std::uniform_int_distribution<int> exp(-300, 300);
+    std::vector<Number> nums;
+    nums.reserve(3 * size_t(n) + sizeof(kInts) / sizeof(kInts[0])
+        + sizeof(kReals) / sizeof(kReals[0]));
+
+    FILE *outS = fopen(file.c_str(), "w");
+    if (outS == nullptr) {
+        std::cerr << "json-numbers: unable to create \"" << file << "\"\n";
+        exit (1);
+    }
+    fprintf (outS, "{\"name\" : \"points\", \"positions\" : [\n");
+    char buf[64];
+    for (int i = 0;  i < n;  i++) {
+        fprintf (outS, (i == 0) ? "  [" : ",\n  [");
+        for (int j = 0;  j < 3;  j++) {
+            double x = coord(rng);
+            if ((style == kFixed) || ((style == kMixed) && (i % 4 >= 2))) {
+                snprintf (buf, sizeof(buf), "%.6f", x);
+            } else if (style == kMixed && (i % 4 == 1)) {
+                snprintf (buf, sizeof(buf), "%.6e", (j == 0) ? x * 1e-30 : (j == 1) ? x * 1e25 : x);
+            } else if (style == kMixed) {
+                snprintf (buf, sizeof(buf), "%.17g", x);
+            } else {
+                snprintf (buf, sizeof(buf), "%.17g", x * std::pow(10.0, double(exp(rng))));
+            }
+            fprintf (outS, (j == 0) ? "%s" : ", %s", buf);
+            nums.push_back (expect (buf));
+        }
+        fprintf (outS, "]");
+    }
+    fprintf (outS, "\n], \"ints\" : [");
+    for (size_t i = 0;  i < sizeof(kInts) / sizeof(kInts[0]);  i++) {
+        fprintf (outS, (i == 0) ? "%s" : ", %s", kInts[i]);
+        nums.push_back (expect (kInts[i]));
+    }
+    fprintf (outS, "], \"reals\" : [");
+    for (size_t i = 0;  i < sizeof(kReals) / sizeof(kReals[0]);  i++) {
+        fprintf (outS, (i == 0) ? "%s" : ", %s", kReals[i]);
+        nums.push_back (expect (kReals[i]));
+    }
+    fprintf (outS, "]}\n");
+    fclose (outS);
+
+    return nums;
+}
+
+//! a handler that records the numbers of a document in order
+class NumberCollector : public json::Handler {
+  public:
+    std::vector<Number> nums;
+
+    bool startObject () override { return true; }
+    bool endObject () override { return true; }
+    bool startArray () override { return true; }
+    bool endArray () override { return true; }
+    bool key (std::string_view) override { return true; }
+    bool integer (int64_t n) override
+    {
+        this->nums.push_back (Number{"", true, n, 0.0});
+        return true;
+    }
+    bool real (double r) override
+    {
+        this->nums.push_back (Number{"", false, 0, r});
+        return true;
+    }
+    bool string (std::string_view) override { return true; }
+    bool boolean (bool) override { return true; }
+    bool null () override { return true; }
+};
+
+//! return the elapsed time since t0 in ms
+static double elapsed (std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+//! parse the document and check its numbers; returns the number of mismatches
+static size_t runDocument (const char *name, Style style, int n, int nRuns)
+{
+    std::string file = "/tmp/json-numbers-" + std::to_string(getpid()) + ".json";
+    std::vector<Number> expected = writeDocument (file, style, n);
+
+  // check the numbers that the event-driven reader reports
+    NumberCollector coll;
+    if (! json::parseFile (file, coll)) {
+        std::cerr << "json-numbers: syntax error in \"" << file << "\"\n";
+        exit (1);
+    }
+    size_t nBad = 0;
+    if (coll.nums.size() != expected.size()) {
+        nBad = expected.size();
+    } else {
+        for (size_t i = 0;  i < expected.size();  i++) {
+            Number const &exp = expected[i];
+            Number const &got = coll.nums[i];
+            if ((exp.isInt != got.isInt)
+            || (exp.isInt ? (exp.i != got.i) : (exp.r != got.r))) {
+                if (nBad < 5) {
+                    fprintf (stderr, "  %s: got %.17g for \"%s\"\n", name,
+                        got.isInt ? double(got.i) : got.r, exp.text.c_str());
+                }
+                nBad++;
+            }
+        }
+    }
+
+  // time the parses
+    double tDoc = 1e30, tSAX = 1e30;
+    for (int r = 0;  r < nRuns;  r++) {
+        auto t0 = std::chrono::steady_clock::now();
+        {
+            json::Document doc;
+            if (doc.parseFile (file) == nullptr) {
+                std::cerr << "json-numbers: syntax error in \"" << file << "\"\n";
+                exit (1);
+            }
+        }
+        tDoc = std::min(tDoc, elapsed(t0));
+        NumberCollector c;
+        c.nums.reserve(expected.size());
+        t0 = std::chrono::steady_clock::now();
+        json::parseFile (file, c);
+        tSAX = std::min(tSAX, elapsed(t0));
+    }
+
+  // time the conversion with strtod, for comparison
+    auto t0 = std::chrono::steady_clock::now();
+    double sum = 0.0;
+    for (auto const &num : expected) {
+        sum += std::fabs(std::strtod(num.text.c_str(), nullptr));
+    }
+    double tStrtod = elapsed(t0);
+
+    printf ("%-10s %8zu numbers  %8zu wrong   Document %8.1f ms   events %8.1f ms"
+        "   (strtod alone %6.1f ms%s)\n",
+        name, expected.size(), nBad, tDoc, tSAX, tStrtod, std::isnan(sum) ? "!" : "");
+
+    unlink (file.c_str());
+    return nBad;
+}
+
+int main (int argc, char **argv)
+{
+    int nRuns = 5;
+    int n = 1000000;
+
+    for (int i = 1;  i < argc;  i++) {
+        if ((strcmp(argv[i], "-r") == 0) && (i + 1 < argc)) {
+            nRuns = std::max(1, atoi(argv[++i]));
+        } else if ((strcmp(argv[i], "-n") == 0) && (i + 1 < argc)) {
+            n = std::max(1, atoi(argv[++i]));
+        } else {
+            std::cerr << "usage: json-numbers [ -r <runs> ] [ -n <positions> ]\n";
+            return 1;
+        }
+    }
+
+    size_t nBad = runDocument ("mixed", kMixed, n, nRuns);
+    nBad += runDocument ("fixed", kFixed, n, nRuns);
+    nBad += runDocument ("wide-exp", kWideExp, std::max(1, 3 * n / 10), nRuns);
+
+    return (nBad == 0) ? 0 : 1;
+}
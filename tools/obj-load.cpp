@@ -0,0 +1,189 @@
+/*! \file obj-load.cpp
+ *
+ * Timing and correctness driver for loading OBJ models.  The driver loads a
+ * model from its text (streaming and parallel) and from its binary cache
+ * (cold, which parses the text and writes the cache, and warm) and checks
+ * that all of the loads produce the same groups.
+ *
+ * Usage:
+ *
+ *      obj-load [ -r <runs> ] [ -n <size> ] [ <file>.obj ]
+ *
+ * If no file is given, the driver writes a torus with 2*<size>*<size>
+ * triangles (default 600, which is 720k triangles) to a temporary file.
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#include "cs237.hpp"
+#include "obj.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <unistd.h>
+
+//! write a torus with 2*n*n triangles, with shared positions, normals, and
+//! texture coordinates, to the file; its material library is written to mtlFile,
+//! which must be in the same directory
+static void writeTorus (std::string const &file, std::string const &mtlFile, int n)
+{
+    FILE *outS = fopen(mtlFile.c_str(), "w");
+    if (outS == nullptr) {
+        ERROR("unable to create \"" + mtlFile + "\"");
+    }
+    fprintf (outS, "newmtl default\nKd 0.8 0.8 0.8\n");
+    fclose (outS);
+
+    outS = fopen(file.c_str(), "w");
+    if (outS == nullptr) {
+        ERROR("unable to create \"" + file + "\"");
+    }
+    const float kR = 2.0f, kr = 0.5f, k2Pi = 6.28318530718f;
+    fprintf (outS, "# torus with %d triangles\nmtllib %s\ng torus\n",
+        2*n*n, mtlFile.substr(mtlFile.find_last_of('/') + 1).c_str());
+    for (int i = 0;  i < n;  i++) {
+        float u = k2Pi * float(i) / float(n);
+        for (int j = 0;  j < n;  j++) {
+            float v = k2Pi * float(j) / float(n);
+            glm::vec3 norm(std::cos(u) * std::cos(v), std::sin(u) * std::cos(v), std::sin(v));
+            glm::vec3 pos = kR * glm::vec3(std::cos(u), std::sin(u), 0.0f) + kr * norm;
+            fprintf (outS, "v %f %f %f\n", pos.x, pos.y, pos.z);
+            fprintf (outS, "vn %f %f %f\n", norm.x, norm.y, norm.z);
+            fprintf (outS, "vt %f %f\n", float(i) / float(n), float(j) / float(n));
+        }
+    }
+    for (int i = 0;  i < n;  i++) {
+        for (int j = 0;  j < n;  j++) {
+          // the one-based indices of the corners of the quad
+            int a = 1 + i * n + j;
+            int b = 1 + ((i + 1) % n) * n + j;
+            int c = 1 + ((i + 1) % n) * n + (j + 1) % n;
+            int d = 1 + i * n + (j + 1) % n;
+            fprintf (outS, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, c, c, c);
+            fprintf (outS, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, c, c, c, d, d, d);
+        }
+    }
+    fclose (outS);
+}
+
+//! run a load the given number of times and return the fastest time in ms
+static double timeLoad (int nRuns, std::function<void()> const &load)
+{
+    double best = 1e30;
+    for (int i = 0;  i < nRuns;  i++) {
+        auto t0 = std::chrono::steady_clock::now();
+        load ();
+        auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(t1 - t0).count());
+    }
+    return best;
+}
+
+//! return true if two groups have the same contents
+static bool sameGroup (OBJ::Group const &a, OBJ::Group const &b)
+{
+    auto same = [](void const *p, void const *q, size_t n) {
+        return ((p == nullptr) == (q == nullptr)) && ((p == nullptr) || (memcmp(p, q, n) == 0));
+    };
+    return (a.name == b.name) && (a.material == b.material)
+        && (a.nVerts == b.nVerts) && (a.nIndices == b.nIndices)
+        && same(a.verts, b.verts, a.nVerts * sizeof(glm::vec3))
+        && same(a.norms, b.norms, a.nVerts * sizeof(glm::vec3))
+        && same(a.txtCoords, b.txtCoords, a.nVerts * sizeof(glm::vec2))
+        && same(a.indices, b.indices, a.nIndices * sizeof(uint32_t));
+}
+
+//! check that a model has the same groups as the reference model
+static bool sameModel (OBJ::Model const &ref, OBJ::Model const &m, const char *what)
+{
+    bool ok = (ref.NumGroups() == m.NumGroups());
+    for (int i = 0;  ok && (i < ref.NumGroups());  i++) {
+        ok = sameGroup (ref.Group(i), m.Group(i));
+    }
+    if (! ok) {
+        std::cerr << "obj-load: " << what << " model differs from the streamed model\n";
+    }
+    return ok;
+}
+
+int main (int argc, char **argv)
+{
+    int nRuns = 5;
+    int size = 600;
+    std::string file;
+
+    for (int i = 1;  i < argc;  i++) {
+        if ((strcmp(argv[i], "-r") == 0) && (i + 1 < argc)) {
+            nRuns = std::max(1, atoi(argv[++i]));
+        } else if ((strcmp(argv[i], "-n") == 0) && (i + 1 < argc)) {
+            size = std::max(2, atoi(argv[++i]));
+        } else if ((argv[i][0] != '-') && file.empty()) {
+            file = argv[i];
+        } else {
+            std::cerr << "usage: obj-load [ -r <runs> ] [ -n <size> ] [ <file>.obj ]\n";
+            return 1;
+        }
+    }
+    bool tmpFile = file.empty();
+    std::string tmpBase = "/tmp/obj-load-" + std::to_string(getpid());
+    if (tmpFile) {
+        file = tmpBase + ".obj";
+        writeTorus (file, tmpBase + ".mtl", size);
+    }
+
+    OBJ::Options streamOpts;
+    OBJ::Options parallelOpts;
+    parallelOpts.parallel = true;
+    OBJ::Options cacheOpts;
+    cacheOpts.useCache = true;
+    std::string cacheFile = file + ".cache";
+
+    OBJ::Model ref(file, streamOpts);
+    size_t nTris = 0, nVerts = 0;
+    for (auto it = ref.beginGroups();  it != ref.endGroups();  ++it) {
+        nTris += it->nIndices / 3;
+        nVerts += it->nVerts;
+    }
+    std::cout << file << ": " << ref.NumGroups() << " groups, " << nTris
+        << " triangles, " << nVerts << " vertices\n";
+
+    double tStream = timeLoad (nRuns, [&]() {
+        OBJ::Model m(file, streamOpts);
+    });
+    double tParallel = timeLoad (nRuns, [&]() {
+        OBJ::Model m(file, parallelOpts);
+    });
+    double tCold = timeLoad (nRuns, [&]() {
+        unlink (cacheFile.c_str());
+        OBJ::Model m(file, cacheOpts);
+    });
+    double tWarm = timeLoad (nRuns, [&]() {
+        OBJ::Model m(file, cacheOpts);
+    });
+
+  // check the results of the different loaders against the streaming loader
+    bool ok = sameModel (ref, OBJ::Model(file, parallelOpts), "parallel");
+    ok = sameModel (ref, OBJ::Model(file, cacheOpts), "cached") && ok;
+
+    printf ("  text (streaming)        %9.2f ms\n", tStream);
+    printf ("  text (parallel)         %9.2f ms\n", tParallel);
+    printf ("  cache cold (parse+save) %9.2f ms\n", tCold);
+    printf ("  cache warm              %9.2f ms\n", tWarm);
+    printf ("  (best of %d runs on %u hardware threads)\n",
+        nRuns, std::thread::hardware_concurrency());
+
+    unlink (cacheFile.c_str());
+    if (tmpFile) {
+        unlink (file.c_str());
+        unlink ((tmpBase + ".mtl").c_str());
+    }
+
+    return ok ? 0 : 1;
+}
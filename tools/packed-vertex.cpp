@@ -0,0 +1,170 @@
+/*! \file packed-vertex.cpp
+ *
+ * Round-trip check for the `PackedVertex` encoding of Project 2.  The driver
+ * encodes a set of vertices the same way that `Mesh::Mesh` does (positions
+ * quantized relative to the bounding box), decodes them on the CPU with
+ * `PackedVertex::decode`, and reports the maximum decode errors.
+ *
+ * Usage:
+ *
+ *      packed-vertex [ -n <count> ]
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#include "vertex.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+//! the angle between two unit vectors in degrees; we use the chord length,
+//! since `acos` of the dot product cannot resolve small angles in single precision
+static float angle (glm::vec3 const &a, glm::vec3 const &b)
+{
+    return glm::degrees(2.0f * std::asin(std::min(0.5f * glm::length(a - b), 1.0f)));
+}
+
+//! the maximum decode errors over a set of vertices
+struct Errors {
+    float pos = 0.0f;           //!< position error as a fraction of a quantization step
+    float norm = 0.0f;          //!< normal error in degrees
+    float tan = 0.0f;           //!< tangent error in degrees
+    float txtCoord = 0.0f;      //!< texture-coordinate error in half-float ulps
+    int signs = 0;              //!< number of bitangent signs that do not match
+};
+
+//! encode and decode the vertices and return the maximum errors
+static Errors roundTrip (std::vector<Vertex> const &verts)
+{
+    // the quantization box, as in `Mesh::Mesh`
+    cs237::AABBf bbox;
+    for (auto const &v : verts) {
+        bbox.addPt (v.pos);
+    }
+    glm::vec3 scale(1.0f), bias(0.0f);
+    if (! bbox.isEmpty()) {
+        bias = bbox.min();
+        scale = bbox.max() - bbox.min();
+    }
+
+    Errors err;
+    for (auto const &v : verts) {
+        Vertex d = PackedVertex(v, scale, bias).decode(scale, bias);
+        for (int i = 0;  i < 3;  ++i) {
+            float step = scale[i] / 65535.0f;
+            if (step > 0.0f) {
+                err.pos = std::max(err.pos, std::fabs(d.pos[i] - v.pos[i]) / step);
+            }
+        }
+        err.norm = std::max(err.norm, angle(d.norm, v.norm));
+        err.tan = std::max(err.tan, angle(glm::vec3(d.tan), glm::vec3(v.tan)));
+        if ((d.tan.w < 0.0f) != (v.tan.w < 0.0f)) {
+            err.signs++;
+        }
+        for (int i = 0;  i < 2;  ++i) {
+            // the spacing of half floats near the value (normal range)
+            float ulp = std::ldexp(1.0f, std::max(std::ilogb(std::fabs(v.txtCoord[i]) + 1e-30f), -14) - 10);
+            err.txtCoord = std::max(err.txtCoord, std::fabs(d.txtCoord[i] - v.txtCoord[i]) / ulp);
+        }
+    }
+    return err;
+}
+
+//! report the errors and check them against the precision of the encoding
+static bool report (const char *what, Errors const &err)
+{
+    // positions round to the nearest step (plus the rounding of the decoding
+    // arithmetic); 16-bit octahedral vectors are good to about 0.006 degrees;
+    // half floats round to the nearest value
+    bool ok = (err.pos <= 0.51f) && (err.norm < 0.01f) && (err.tan < 0.01f)
+        && (err.txtCoord <= 0.5f) && (err.signs == 0);
+    printf ("  %-24s pos %.3f steps, norm %.5f deg, tan %.5f deg, uv %.3f ulp, %d sign errors  %s\n",
+        what, err.pos, err.norm, err.tan, err.txtCoord, err.signs, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+int main (int argc, char **argv)
+{
+    int n = 1000000;
+
+    for (int i = 1;  i < argc;  i++) {
+        if ((strcmp(argv[i], "-n") == 0) && (i + 1 < argc)) {
+            n = std::max(1, atoi(argv[++i]));
+        } else {
+            std::cerr << "usage: packed-vertex [ -n <count> ]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::mt19937 rng(23700);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    auto randomDir = [&]() {
+        glm::vec3 v;
+        do {
+            v = glm::vec3(unit(rng), unit(rng), unit(rng));
+        } while ((glm::dot(v, v) > 1.0f) || (glm::dot(v, v) < 1e-4f));
+        return glm::normalize(v);
+    };
+    // a vertex with a random frame at the given position
+    auto makeVertex = [&](glm::vec3 const &pos, glm::vec3 const &norm, glm::vec2 const &uv) {
+        Vertex v;
+        v.pos = pos;
+        v.norm = norm;
+        glm::vec3 t = glm::normalize(glm::cross(norm, randomDir()));
+        v.tan = glm::vec4(t, (unit(rng) < 0.0f) ? -1.0f : 1.0f);
+        v.txtCoord = uv;
+        return v;
+    };
+
+    bool ok = true;
+
+    // random vertices in an off-center, non-uniform box with tiled texture coordinates
+    {
+        std::vector<Vertex> verts;
+        verts.reserve(n);
+        for (int i = 0;  i < n;  i++) {
+            glm::vec3 pos(100.0f + 50.0f * unit(rng), -3.0f + 0.25f * unit(rng), 1000.0f * unit(rng));
+            glm::vec2 uv(4.0f + 4.0f * unit(rng), 0.5f + 0.5f * unit(rng));
+            verts.push_back (makeVertex (pos, randomDir(), uv));
+        }
+        ok = report ("random", roundTrip (verts)) && ok;
+    }
+
+    // the axes, the octahedron's edges, and the diagonals, which are the edge
+    // cases of the octahedral mapping
+    {
+        std::vector<Vertex> verts;
+        for (int x = -1;  x <= 1;  x++) {
+            for (int y = -1;  y <= 1;  y++) {
+                for (int z = -1;  z <= 1;  z++) {
+                    if ((x != 0) || (y != 0) || (z != 0)) {
+                        glm::vec3 d = glm::normalize(glm::vec3(x, y, z));
+                        verts.push_back (makeVertex (d, d, glm::vec2(0.0f, 1.0f)));
+                    }
+                }
+            }
+        }
+        ok = report ("axes and diagonals", roundTrip (verts)) && ok;
+    }
+
+    // a flat group: the y extent is zero, so the scale is zero in y
+    {
+        std::vector<Vertex> verts;
+        for (int i = 0;  i < 1000;  i++) {
+            glm::vec3 pos(unit(rng), 2.0f, unit(rng));
+            verts.push_back (makeVertex (pos, glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(unit(rng), unit(rng))));
+        }
+        ok = report ("flat", roundTrip (verts)) && ok;
+    }
+
+    printf ("  (PackedVertex is %d bytes; Vertex is %d bytes)\n",
+        int(sizeof(PackedVertex)), int(sizeof(Vertex)));
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,167 @@
+/*! \file tex-load.cpp
+ *
+ * Timing driver for loading mipmapped 2D textures.  The driver compares
+ * computing the mipmap levels on the CPU (`mipmapLevels`) with computing them
+ * on the device (`vkCmdBlitImage`), for both an in-memory `Image2D` and a PNG
+ * file that is decoded directly into the staging buffer.  The device levels
+ * are requested with `MipmapMode::Device`, so the blits also run on a software
+ * implementation of Vulkan (where the default mode uses the CPU).
+ *
+ * Usage:
+ *
+ *      tex-load [ -r <runs> ] [ -debug ] [ <file>.png ]
+ *
+ * If no file is given, the driver writes a 3840x2160 RGBA image to a
+ * temporary file.  The `-debug` flag enables the validation layers.
+ *
+ * \author John Reppy
+ */
+
+/*
+ * COPYRIGHT (c) 2022 John Reppy (http://cs.uchicago.edu/~jhr)
+ * All rights reserved.
+ */
+
+#include "cs237.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <unistd.h>
+
+//! run a load the given number of times and return the fastest time in ms
+static double timeLoad (int nRuns, std::function<void()> const &load)
+{
+    double best = 1e30;
+    for (int i = 0;  i < nRuns;  i++) {
+        auto t0 = std::chrono::steady_clock::now();
+        load ();
+        auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(t1 - t0).count());
+    }
+    return best;
+}
+
+//! make a wid x ht RGBA image with smooth gradients and some noise
+static cs237::Image2D *makeImage (uint32_t wid, uint32_t ht)
+{
+    auto img = new cs237::Image2D (wid, ht, cs237::Channels::RGBA, cs237::ChannelTy::U8);
+    uint8_t *p = static_cast<uint8_t *>(img->data());
+    uint32_t seed = 12345;
+    for (uint32_t r = 0;  r < ht;  r++) {
+        for (uint32_t c = 0;  c < wid;  c++, p += 4) {
+            seed = seed * 1103515245u + 12345u;
+            uint8_t noise = (seed >> 24) & 0xf;
+            p[0] = uint8_t((255 * c) / wid) ^ noise;
+            p[1] = uint8_t((255 * r) / ht) ^ noise;
+            p[2] = uint8_t(c ^ r);
+            p[3] = 255;
+        }
+    }
+    return img;
+}
+
+class TexLoad : public cs237::Application {
+public:
+    TexLoad (std::vector<const char *> &args, std::string const &file, int nRuns)
+      : cs237::Application (args, "tex-load"), _file(file), _nRuns(nRuns)
+    { }
+
+    void run () override;
+
+private:
+    std::string _file;
+    int _nRuns;
+};
+
+void TexLoad::run ()
+{
+    std::unique_ptr<cs237::Image2D> img(new cs237::Image2D (this->_file));
+    std::cout << this->_file << ": " << img->width() << "x" << img->height()
+        << ", " << img->nBytes() << " bytes\n";
+
+    // the device falls back to the CPU if it cannot blit the image's format
+    bool canBlit = this->_findBestFormat (
+            { img->format() },
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_FORMAT_FEATURE_BLIT_SRC_BIT
+            | VK_FORMAT_FEATURE_BLIT_DST_BIT
+            | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)
+        != VK_FORMAT_UNDEFINED;
+    std::cout << "device: " << this->_props()->deviceName
+        << (canBlit ? "" : " (cannot blit the image format; all levels are computed on the CPU)")
+        << "\n";
+
+    // the levels on the CPU without an upload
+    double tLevels = timeLoad (this->_nRuns, [&]() {
+        auto mips = cs237::mipmapLevels (img.get());
+        for (auto mip : mips) {
+            delete mip;
+        }
+    });
+    double tCPU = timeLoad (this->_nRuns, [&]() {
+        cs237::Texture2D txt(this, img.get(), true, false, cs237::MipmapMode::CPU);
+    });
+    double tDevice = timeLoad (this->_nRuns, [&]() {
+        cs237::Texture2D txt(this, img.get(), true, false, cs237::MipmapMode::Device);
+    });
+    double tImageFile = timeLoad (this->_nRuns, [&]() {
+        cs237::Image2D fileImg(this->_file);
+        cs237::Texture2D txt(this, &fileImg, true, false, cs237::MipmapMode::Device);
+    });
+    double tStagingFile = timeLoad (this->_nRuns, [&]() {
+        cs237::Texture2D txt(this, this->_file, false, true, cs237::MipmapMode::Device);
+    });
+
+    printf ("  mipmapLevels only                         %9.2f ms\n", tLevels);
+    printf ("  Image2D, CPU levels                       %9.2f ms\n", tCPU);
+    printf ("  Image2D, device levels                    %9.2f ms\n", tDevice);
+    printf ("  PNG -> Image2D -> texture, device levels  %9.2f ms\n", tImageFile);
+    printf ("  PNG -> staging -> texture, device levels  %9.2f ms\n", tStagingFile);
+    printf ("  (best of %d runs)\n", this->_nRuns);
+}
+
+int main (int argc, char **argv)
+{
+    int nRuns = 5;
+    std::string file;
+    std::vector<const char *> args(argv, argv+1);
+
+    for (int i = 1;  i < argc;  i++) {
+        if ((strcmp(argv[i], "-r") == 0) && (i + 1 < argc)) {
+            nRuns = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-debug") == 0) {
+            args.push_back (argv[i]);
+        } else if ((argv[i][0] != '-') && file.empty()) {
+            file = argv[i];
+        } else {
+            std::cerr << "usage: tex-load [ -r <runs> ] [ -debug ] [ <file>.png ]\n";
+            return EXIT_FAILURE;
+        }
+    }
+    bool tmpFile = file.empty();
+    if (tmpFile) {
+        file = "/tmp/tex-load-" + std::to_string(getpid()) + ".png";
+        std::unique_ptr<cs237::Image2D> img(makeImage (3840, 2160));
+        if (! img->write (file.c_str())) {
+            std::cerr << "tex-load: unable to write \"" << file << "\"\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    int sts = EXIT_SUCCESS;
+    try {
+        TexLoad app(args, file, nRuns);
+        app.run();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        sts = EXIT_FAILURE;
+    }
+
+    if (tmpFile) {
+        unlink (file.c_str());
+    }
+
+    return sts;
+}